@@ -43,5 +43,8 @@ typedef NS_ENUM(NSInteger, VMPErrorCode) {
 	/// Property list parsing error.
 	VMPErrorCodePropertyListError = 11,
 	/// Error originating from Graphviz libraries
-	VMPErrorCodeGraphvizError = 12
+	VMPErrorCodeGraphvizError = 12,
+	/// Graph rendering did not finish in time, or too many graphs are pending. Used in
+	/// VMPGraphRenderer.
+	VMPErrorCodeGraphvizBusy = 13
 };
\ No newline at end of file
@@ -0,0 +1,63 @@
+/* vmpserverd - A virtual multimedia processor
+ * Copyright (C) 2024 Hugo Melder
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * @brief Renders DOT graphs to SVG with Graphviz, and caches the result
+ *
+ * Graphviz is not thread-safe, and the layout of a large pipeline takes
+ * hundreds of milliseconds. Graphs are thus rendered one after another on a
+ * background queue with a single Graphviz context. Rendered graphs are cached
+ * by the SHA-256 hash of the DOT data without element states, and parameters,
+ * so repeated requests for an unchanged pipeline are served from memory.
+ *
+ * Concurrent requests for the same graph share a single rendering. If too many
+ * different graphs are waiting to be rendered, new requests are rejected.
+ * The result is passed to a completion handler, so callers never block on
+ * Graphviz.
+ *
+ * All methods are MT-Safe.
+ */
+@interface VMPGraphRenderer : NSObject
+
+/**
+ * @brief Statistics of the renderer
+ *
+ * Contains the number of cache "hits", and "misses", the number of completed
+ * "renders", the "averageRenderDuration" in milliseconds, the number of
+ * "rejected" requests, and the number of "cached" graphs.
+ */
+@property (readonly) NSDictionary *statistics;
+
+/**
+ * @brief Create a renderer
+ *
+ * @param maxPending Maximum number of graphs waiting to be rendered
+ * @param cacheSize Maximum number of rendered graphs kept in memory
+ */
+- (instancetype)initWithMaxPendingRenders:(NSUInteger)maxPending cacheSize:(NSUInteger)cacheSize;
+
+/**
+ * @brief Render a DOT graph to SVG
+ *
+ * Calls the handler immediately with the cached SVG if the graph was rendered
+ * before, or with VMPErrorCodeGraphvizBusy if too many graphs are pending.
+ * Otherwise, the graph is rendered on the background queue, and the handler is
+ * called on a global dispatch queue once the rendering finished.
+ *
+ * @param dot ASCII-encoded DOT graph
+ * @param handler Receives the SVG data, or an error. VMPErrorCodeGraphvizBusy if
+ * too many graphs are pending, and VMPErrorCodeGraphvizError if Graphviz failed.
+ */
+- (void)renderSVGForDOTData:(NSData *)dot
+		  completionHandler:(void (^)(NSData *_Nullable svg, NSError *_Nullable error))handler;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,285 @@
+/* vmpserverd - A virtual multimedia processor
+ * Copyright (C) 2024 Hugo Melder
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#import <dispatch/dispatch.h>
+#import <glib.h>
+
+#import <graphviz/cgraph.h>
+#import <graphviz/gvc.h>
+
+#import "VMPErrors.h"
+#import "VMPGraphRenderer.h"
+#import "VMPJournal.h"
+
+/* Hash a DOT graph without the element states, and parameters, which change all the time.
+ * GStreamer adds them to the labels of elements, and pads as lines starting with '[', or
+ * containing '='. The first line of a label, and caps, which are split with '\l', are kept.
+ */
+static gchar *dot_checksum(const gchar *dot, gsize length) {
+	GChecksum *checksum;
+	gchar *result;
+	gboolean quoted = FALSE;
+	gsize runStart = 0;
+	gsize i = 0;
+
+	checksum = g_checksum_new(G_CHECKSUM_SHA256);
+	while (i < length) {
+		gboolean isVolatile;
+		gsize end;
+
+		if (!quoted || dot[i] != '\\' || i + 1 >= length || dot[i + 1] != 'n') {
+			if (dot[i] == '"') {
+				quoted = !quoted;
+			}
+			// An escaped character never ends a label
+			i += (dot[i] == '\\' && i + 1 < length) ? 2 : 1;
+			continue;
+		}
+
+		// A line of a label from its '\n' to the next line, or the end of the label
+		end = i + 2;
+		isVolatile = end < length && dot[end] == '[';
+		while (end < length && dot[end] != '"' &&
+			   !(dot[end] == '\\' && end + 1 < length && dot[end + 1] == 'n')) {
+			if (dot[end] == '=') {
+				isVolatile = TRUE;
+			}
+			end += (dot[end] == '\\' && end + 1 < length) ? 2 : 1;
+		}
+
+		if (isVolatile) {
+			g_checksum_update(checksum, (const guchar *) dot + runStart, i - runStart);
+			runStart = end;
+		}
+		i = end;
+	}
+	g_checksum_update(checksum, (const guchar *) dot + runStart, length - runStart);
+
+	result = g_strdup(g_checksum_get_string(checksum));
+	g_checksum_free(checksum);
+	return result;
+}
+
+// A rendering in progress. Waiting requests are notified through the group.
+@interface _VMPRenderJob : NSObject
+@property (nonatomic, readonly) dispatch_group_t group;
+@property (nonatomic, strong) NSData *svg;
+@property (nonatomic, strong) NSError *error;
+@end
+
+@implementation _VMPRenderJob
+- (instancetype)init {
+	self = [super init];
+	if (self) {
+		_group = dispatch_group_create();
+	}
+	return self;
+}
+@end
+
+@implementation VMPGraphRenderer {
+	// Only accessed on _queue
+	GVC_t *_gvc;
+	dispatch_queue_t _queue;
+
+	NSUInteger _maxPending;
+	NSUInteger _cacheSize;
+	// The following ivars are protected by @synchronized(self)
+	NSMutableDictionary<NSString *, NSData *> *_cache;
+	// Keys of the cache in insertion order for eviction
+	NSMutableArray<NSString *> *_cacheOrder;
+	NSMutableDictionary<NSString *, _VMPRenderJob *> *_pending;
+	NSUInteger _hits;
+	NSUInteger _misses;
+	NSUInteger _renders;
+	NSUInteger _rejected;
+	double _renderDurationSum;
+}
+
+- (instancetype)initWithMaxPendingRenders:(NSUInteger)maxPending cacheSize:(NSUInteger)cacheSize {
+	self = [super init];
+	if (self) {
+		_maxPending = maxPending;
+		_cacheSize = cacheSize;
+		_cache = [NSMutableDictionary dictionaryWithCapacity:cacheSize];
+		_cacheOrder = [NSMutableArray arrayWithCapacity:cacheSize];
+		_pending = [NSMutableDictionary dictionary];
+		_queue = dispatch_queue_create("com.hugomelder.vmpserverd.graphviz", DISPATCH_QUEUE_SERIAL);
+		_gvc = NULL;
+	}
+	return self;
+}
+
+- (NSDictionary *)statistics {
+	@synchronized(self) {
+		return @{
+			@"hits" : @(_hits),
+			@"misses" : @(_misses),
+			@"renders" : @(_renders),
+			@"averageRenderDuration" : @(_renders > 0 ? _renderDurationSum / _renders : 0),
+			@"rejected" : @(_rejected),
+			@"cached" : @([_cache count]),
+		};
+	}
+}
+
+// Called on _queue
+- (NSData *)_renderDOTData:(NSData *)dotData error:(NSError **)error {
+	NSData *svgData;
+	Agraph_t *g;
+	gchar *dot;
+	char *rendered;
+	unsigned int length;
+
+	// The context is created once, and reused for all graphs
+	if (_gvc == NULL) {
+		_gvc = gvContext();
+		if (!_gvc) {
+			VMP_FAST_ERROR(error, VMPErrorCodeGraphvizError,
+						   @"Failed to initialize Graphviz context");
+			return nil;
+		}
+	}
+
+	// agmemread expects a NUL-terminated string
+	dot = g_strndup([dotData bytes], [dotData length]);
+	g = agmemread(dot);
+	g_free(dot);
+	if (!g) {
+		VMP_FAST_ERROR(error, VMPErrorCodeGraphvizError, @"Failed to create graph from DOT data");
+		return nil;
+	}
+
+	if (gvLayout(_gvc, g, "dot") != 0) {
+		VMP_FAST_ERROR(error, VMPErrorCodeGraphvizError, @"Failed to layout graph");
+		agclose(g);
+		return nil;
+	}
+
+	if (gvRenderData(_gvc, g, "svg", &rendered, &length) != 0) {
+		VMP_FAST_ERROR(error, VMPErrorCodeGraphvizError, @"Failed to render graph to SVG");
+		gvFreeLayout(_gvc, g);
+		agclose(g);
+		return nil;
+	}
+
+	svgData = [NSData dataWithBytes:rendered length:length];
+
+	// Clean up
+	gvFreeRenderData(rendered);
+	gvFreeLayout(_gvc, g);
+	agclose(g);
+
+	return svgData;
+}
+
+// Called with the lock held
+- (void)_cacheSVG:(NSData *)svg forKey:(NSString *)key {
+	if (_cacheSize == 0) {
+		return;
+	}
+
+	while ([_cacheOrder count] >= _cacheSize) {
+		[_cache removeObjectForKey:_cacheOrder[0]];
+		[_cacheOrder removeObjectAtIndex:0];
+	}
+	_cache[key] = svg;
+	[_cacheOrder addObject:key];
+}
+
+// Called with the lock held
+- (_VMPRenderJob *)_startRenderingDOTData:(NSData *)dot forKey:(NSString *)key {
+	_VMPRenderJob *job = [_VMPRenderJob new];
+
+	_pending[key] = job;
+	dispatch_group_enter([job group]);
+	dispatch_async(_queue, ^{
+		NSError *renderError = nil;
+		NSData *rendered;
+		gint64 begin;
+
+		begin = g_get_monotonic_time();
+		rendered = [self _renderDOTData:dot error:&renderError];
+
+		@synchronized(self) {
+			if (rendered) {
+				_renders++;
+				_renderDurationSum += (double) (g_get_monotonic_time() - begin) / 1000.0;
+				[self _cacheSVG:rendered forKey:key];
+			}
+			[_pending removeObjectForKey:key];
+		}
+		if (!rendered) {
+			VMPError(@"Failed to render graph: %@", renderError);
+		}
+
+		[job setSvg:rendered];
+		[job setError:renderError];
+		dispatch_group_leave([job group]);
+	});
+
+	return job;
+}
+
+- (void)renderSVGForDOTData:(NSData *)dot
+		  completionHandler:(void (^)(NSData *_Nullable svg, NSError *_Nullable error))handler {
+	_VMPRenderJob *job;
+	NSString *key;
+	NSData *cached = nil;
+	NSError *error = nil;
+	dispatch_queue_t queue;
+	gchar *checksum;
+
+	checksum = dot_checksum([dot bytes], [dot length]);
+	key = [NSString stringWithUTF8String:checksum];
+	g_free(checksum);
+
+	@synchronized(self) {
+		cached = _cache[key];
+		if (cached) {
+			_hits++;
+			job = nil;
+		} else {
+			_misses++;
+			// Join a rendering of the same graph that is already in progress
+			job = _pending[key];
+		}
+
+		if (!cached && !job) {
+			if ([_pending count] >= _maxPending) {
+				_rejected++;
+				VMP_FAST_ERROR(&error, VMPErrorCodeGraphvizBusy,
+							   @"Too many graphs are waiting to be rendered");
+			} else {
+				job = [self _startRenderingDOTData:dot forKey:key];
+			}
+		}
+	}
+
+	// Cache hit, or rejected
+	if (!job) {
+		handler(cached, error);
+		return;
+	}
+
+	queue = dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0);
+	dispatch_group_notify([job group], queue, ^{
+		handler([job svg], [job error]);
+	});
+}
+
+- (void)dealloc {
+	GVC_t *gvc = _gvc;
+
+	// Free the context after all pending renderings finished
+	if (gvc != NULL) {
+		dispatch_async(_queue, ^{
+			gvFreeContext(gvc);
+		});
+	}
+}
+
+@end
@@ -0,0 +1,118 @@
+/* vmpserverd - A virtual multimedia processor
+ * Copyright (C) 2024 Hugo Melder
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * @brief Event loops observed by the loop watchdog
+ */
+typedef NS_ENUM(NSInteger, VMPLoop) {
+	/// The NSRunLoop of the main thread, scheduling restarts, and on-demand channels
+	VMPLoopMain = 0,
+	/// The GLib default main context, dispatching bus messages, and timeouts
+	VMPLoopGLib = 1,
+	/// The threads of the HTTP server, running the route handlers
+	VMPLoopHTTP = 2
+};
+
+/**
+ * @brief Detects stalls of the event loops of the daemon
+ *
+ * A dedicated thread sends a heartbeat to the main run loop, and the GLib
+ * default main context at a fixed interval, and records the time until the
+ * heartbeat is dispatched. The HTTP server has no loop we can post to, so
+ * the duration of every route handler is recorded instead. As the HTTP server
+ * can run handlers on multiple threads, its activities are tracked per thread.
+ *
+ * Code running on a loop reports what it is doing with
+ * +beginActivity:onLoop:, and +endActivityOnLoop:. If a heartbeat is
+ * late, or a handler runs longer than the threshold, a stall event with the
+ * current activity of the loop is recorded, and a warning is logged.
+ *
+ * All methods are MT-Safe.
+ */
+@interface VMPLoopWatchdog : NSObject
+
+/**
+ * @brief Create, and start a watchdog
+ *
+ * The watchdog thread retains the watchdog until it is stopped with
+ * -invalidate, so a watchdog that is never invalidated is never deallocated.
+ *
+ * @param interval Seconds between two heartbeats
+ * @param threshold Seconds after which a loop is stalled
+ */
+- (instancetype)initWithInterval:(NSTimeInterval)interval threshold:(NSTimeInterval)threshold;
+
+/**
+ * @brief Latency histograms, and recent stalls
+ *
+ * Example structure:
+ * @code
+ * {
+ *     "threshold": 500, // Milliseconds
+ *     "loops": {
+ *         "main": {
+ *             "count": 1200,
+ *             "mean": 0.2, // Milliseconds
+ *             "max": 812.4,
+ *             "buckets": [1, 5, 10, 50, 100, 500, 1000, 5000], // Upper bounds in ms
+ *             "histogram": [1180, 12, 3, 2, 1, 1, 1, 0, 0] // Last entry is +Inf
+ *         },
+ *         "glib": { ... },
+ *         "http": { ... }
+ *     },
+ *     "stalls": [
+ *         {
+ *             "loop": "main",
+ *             "activity": "-[VMPRTSPServer _restartStalledManager:] present0",
+ *             "startedAt": "2024-03-01T10:00:00Z",
+ *             "duration": 812.4, // Milliseconds, so far if ongoing
+ *             "ongoing": false
+ *         }
+ *     ]
+ * }
+ * @endcode
+ *
+ * The last 32 stalls are kept. The activity is "unknown" if the loop did not
+ * report an activity.
+ */
+@property (readonly) NSDictionary *statistics;
+
+/**
+ * @brief Whether a watchdog is running
+ *
+ * Hot paths can skip building the description of an activity, and reporting
+ * it, if no watchdog is running.
+ */
++ (BOOL)isRunning;
+
+/**
+ * @brief Report that the calling code started an activity on a loop
+ *
+ * Activities can be nested. Only the outermost activity is reported.
+ * Cheap enough to be called for every bus message, and HTTP request, as
+ * long as the description is not formatted for every call.
+ */
++ (void)beginActivity:(NSString *)activity onLoop:(VMPLoop)loop;
+
+/**
+ * @brief Report that the activity started with +beginActivity:onLoop: ended
+ */
++ (void)endActivityOnLoop:(VMPLoop)loop;
+
+/**
+ * @brief Stop the watchdog thread
+ *
+ * Releases the reference of the thread to the watchdog.
+ */
+- (void)invalidate;
+
+@end
+
+NS_ASSUME_NONNULL_END
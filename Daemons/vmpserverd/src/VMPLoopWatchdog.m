@@ -0,0 +1,371 @@
+/* vmpserverd - A virtual multimedia processor
+ * Copyright (C) 2024 Hugo Melder
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#import <glib.h>
+
+#import "VMPJournal.h"
+#import "VMPLoopWatchdog.h"
+
+#define LOOP_COUNT 3
+// Number of stall events kept
+#define STALL_HISTORY 32
+#define BUCKET_COUNT 8
+
+// Upper bounds of the latency histogram in milliseconds
+static const double bucketBounds[BUCKET_COUNT] = {1, 5, 10, 50, 100, 500, 1000, 5000};
+
+static NSString *const loopNames[LOOP_COUNT] = {@"main", @"glib", @"http"};
+
+#pragma mark - Loop state
+
+// A route handler running on a thread of the HTTP server. Only accessed while
+// holding the watchdog lock.
+@interface _VMPHandlerState : NSObject
+@property (nonatomic, copy) NSString *activity;
+@property (nonatomic) NSUInteger depth;
+// Monotonic time at which the outermost activity started
+@property (nonatomic) gint64 activitySince;
+// The ongoing stall, or nil
+@property (nonatomic, strong) NSMutableDictionary *stall;
+@end
+
+@implementation _VMPHandlerState
+@end
+
+// State of a loop. Only accessed while holding the watchdog lock.
+@interface _VMPLoopState : NSObject
+@property (nonatomic, copy) NSString *activity;
+@property (nonatomic) NSUInteger depth;
+// Monotonic time at which the outermost activity started
+@property (nonatomic) gint64 activitySince;
+// Monotonic time at which the pending heartbeat was sent, or 0
+@property (nonatomic) gint64 heartbeatSentAt;
+// The ongoing stall, or nil
+@property (nonatomic, strong) NSMutableDictionary *stall;
+// Running handlers by thread. The HTTP server may run handlers on multiple
+// threads concurrently, so the HTTP loop tracks an activity per thread.
+@property (nonatomic, readonly) NSMutableDictionary<NSValue *, _VMPHandlerState *> *handlers;
+
+- (void)recordLatency:(double)milliseconds;
+- (NSDictionary *)statistics;
+@end
+
+@implementation _VMPLoopState {
+	NSUInteger _count;
+	double _sum;
+	double _max;
+	NSUInteger _histogram[BUCKET_COUNT + 1];
+}
+
+- (instancetype)init {
+	self = [super init];
+	if (self) {
+		_handlers = [NSMutableDictionary dictionary];
+	}
+	return self;
+}
+
+- (void)recordLatency:(double)milliseconds {
+	NSUInteger bucket = 0;
+
+	while (bucket < BUCKET_COUNT && milliseconds > bucketBounds[bucket]) {
+		bucket++;
+	}
+	_histogram[bucket]++;
+	_count++;
+	_sum += milliseconds;
+	_max = MAX(_max, milliseconds);
+}
+
+- (NSDictionary *)statistics {
+	NSMutableArray *buckets = [NSMutableArray arrayWithCapacity:BUCKET_COUNT];
+	NSMutableArray *histogram = [NSMutableArray arrayWithCapacity:BUCKET_COUNT + 1];
+
+	for (NSUInteger i = 0; i < BUCKET_COUNT; i++) {
+		[buckets addObject:@(bucketBounds[i])];
+	}
+	for (NSUInteger i = 0; i <= BUCKET_COUNT; i++) {
+		[histogram addObject:@(_histogram[i])];
+	}
+
+	return @{
+		@"count" : @(_count),
+		@"mean" : @(_count > 0 ? _sum / _count : 0),
+		@"max" : @(_max),
+		@"buckets" : buckets,
+		@"histogram" : histogram,
+	};
+}
+@end
+
+#pragma mark - Shared state
+
+// Activities are reported through class methods, so the state is shared by all
+// watchdogs. A single watchdog is created by the server.
+static GMutex watchdogLock;
+static NSArray<_VMPLoopState *> *loopStates;
+static NSMutableArray<NSMutableDictionary *> *stallEvents;
+// Number of watchdogs that were not invalidated. Atomic.
+static gint runningWatchdogs;
+
+// Called with the lock held. Returns the new stall event.
+static NSMutableDictionary *begin_stall(NSString *activity, VMPLoop loop, gint64 since,
+										gint64 now) {
+	NSMutableDictionary *stall;
+	NSTimeInterval ago;
+
+	ago = (double) (now - since) / G_USEC_PER_SEC;
+	stall = [NSMutableDictionary dictionaryWithDictionary:@{
+		@"loop" : loopNames[loop],
+		@"activity" : activity ?: @"unknown",
+		@"startedAt" : [[[NSISO8601DateFormatter alloc] init]
+			stringFromDate:[NSDate dateWithTimeIntervalSinceNow:-ago]],
+		@"duration" : @(ago * 1000.0),
+		@"ongoing" : @YES,
+	}];
+
+	[stallEvents addObject:stall];
+	if ([stallEvents count] > STALL_HISTORY) {
+		[stallEvents removeObjectAtIndex:0];
+	}
+
+	VMPWarn(@"The %@ loop is stalled for %.0f ms while running: %@", loopNames[loop], ago * 1000.0,
+			stall[@"activity"]);
+
+	return stall;
+}
+
+// Called with the lock held
+static void end_stall(NSMutableDictionary *stall, VMPLoop loop, double milliseconds) {
+	if (stall == nil) {
+		return;
+	}
+
+	stall[@"duration"] = @(milliseconds);
+	stall[@"ongoing"] = @NO;
+
+	VMPInfo(@"The %@ loop recovered after %.0f ms (%@)", loopNames[loop], milliseconds,
+			stall[@"activity"]);
+}
+
+// Called on the loop that received the heartbeat
+static void heartbeat(VMPLoop loop) {
+	_VMPLoopState *state;
+	double latency;
+
+	g_mutex_lock(&watchdogLock);
+	state = loopStates[loop];
+	if ([state heartbeatSentAt] != 0) {
+		latency = (double) (g_get_monotonic_time() - [state heartbeatSentAt]) / 1000.0;
+		[state recordLatency:latency];
+		[state setHeartbeatSentAt:0];
+		end_stall([state stall], loop, latency);
+		[state setStall:nil];
+	}
+	g_mutex_unlock(&watchdogLock);
+}
+
+static gboolean glib_heartbeat_cb(gpointer user_data) {
+	@autoreleasepool {
+		heartbeat(VMPLoopGLib);
+	}
+
+	return G_SOURCE_REMOVE;
+}
+
+#pragma mark - Watchdog
+
+@implementation VMPLoopWatchdog {
+	NSTimeInterval _interval;
+	NSTimeInterval _threshold;
+	NSThread *_thread;
+	// Set once by -invalidate. Atomic.
+	gint _invalidated;
+}
+
++ (void)initialize {
+	if (self == [VMPLoopWatchdog class]) {
+		NSMutableArray *states = [NSMutableArray arrayWithCapacity:LOOP_COUNT];
+
+		for (NSUInteger i = 0; i < LOOP_COUNT; i++) {
+			[states addObject:[_VMPLoopState new]];
+		}
+		loopStates = [states copy];
+		stallEvents = [NSMutableArray arrayWithCapacity:STALL_HISTORY];
+	}
+}
+
++ (BOOL)isRunning {
+	return g_atomic_int_get(&runningWatchdogs) > 0;
+}
+
++ (void)beginActivity:(NSString *)activity onLoop:(VMPLoop)loop {
+	_VMPLoopState *state;
+
+	g_mutex_lock(&watchdogLock);
+	state = loopStates[loop];
+	if (loop == VMPLoopHTTP) {
+		NSValue *thread = [NSValue valueWithPointer:g_thread_self()];
+		_VMPHandlerState *handler = [state handlers][thread];
+
+		if (!handler) {
+			handler = [_VMPHandlerState new];
+			[handler setActivity:activity];
+			[handler setActivitySince:g_get_monotonic_time()];
+			[state handlers][thread] = handler;
+		}
+		[handler setDepth:[handler depth] + 1];
+	} else {
+		if ([state depth] == 0) {
+			[state setActivity:activity];
+			[state setActivitySince:g_get_monotonic_time()];
+		}
+		[state setDepth:[state depth] + 1];
+	}
+	g_mutex_unlock(&watchdogLock);
+}
+
++ (void)endActivityOnLoop:(VMPLoop)loop {
+	_VMPLoopState *state;
+	double duration;
+
+	g_mutex_lock(&watchdogLock);
+	state = loopStates[loop];
+	if (loop == VMPLoopHTTP) {
+		NSValue *thread = [NSValue valueWithPointer:g_thread_self()];
+		_VMPHandlerState *handler = [state handlers][thread];
+
+		if (handler) {
+			[handler setDepth:[handler depth] - 1];
+		}
+		if (handler && [handler depth] == 0) {
+			// Without heartbeats, the duration of the handlers is the latency of the loop
+			duration = (double) (g_get_monotonic_time() - [handler activitySince]) / 1000.0;
+			[state recordLatency:duration];
+			end_stall([handler stall], loop, duration);
+			[[state handlers] removeObjectForKey:thread];
+		}
+	} else {
+		if ([state depth] > 0) {
+			[state setDepth:[state depth] - 1];
+		}
+		if ([state depth] == 0) {
+			[state setActivity:nil];
+		}
+	}
+	g_mutex_unlock(&watchdogLock);
+}
+
+- (instancetype)initWithInterval:(NSTimeInterval)interval threshold:(NSTimeInterval)threshold {
+	self = [super init];
+	if (self) {
+		_interval = interval;
+		_threshold = threshold;
+		g_atomic_int_inc(&runningWatchdogs);
+		// The thread retains its target until it exits after -invalidate
+		_thread = [[NSThread alloc] initWithTarget:self selector:@selector(_run:) object:nil];
+		[_thread setName:@"loop-watchdog"];
+		[_thread start];
+	}
+	return self;
+}
+
+- (void)_heartbeatOnMainThread:(id)unused {
+	heartbeat(VMPLoopMain);
+}
+
+// Called on the watchdog thread
+- (void)_check {
+	gint64 now = g_get_monotonic_time();
+	gint64 threshold = (gint64) (_threshold * G_USEC_PER_SEC);
+	BOOL sendMain = NO;
+	BOOL sendGLib = NO;
+
+	g_mutex_lock(&watchdogLock);
+	for (VMPLoop loop = VMPLoopMain; loop < LOOP_COUNT; loop++) {
+		_VMPLoopState *state = loopStates[loop];
+		gint64 since;
+
+		if (loop == VMPLoopHTTP) {
+			// Only busy while a handler is running
+			for (_VMPHandlerState *handler in [[state handlers] objectEnumerator]) {
+				since = [handler activitySince];
+				if ([handler stall]) {
+					[handler stall][@"duration"] = @((double) (now - since) / 1000.0);
+				} else if (now - since > threshold) {
+					[handler setStall:begin_stall([handler activity], loop, since, now)];
+				}
+			}
+			continue;
+		} else if ([state heartbeatSentAt] == 0) {
+			[state setHeartbeatSentAt:now];
+			if (loop == VMPLoopMain) {
+				sendMain = YES;
+			} else {
+				sendGLib = YES;
+			}
+			continue;
+		} else {
+			since = [state heartbeatSentAt];
+		}
+
+		if ([state stall]) {
+			[state stall][@"duration"] = @((double) (now - since) / 1000.0);
+		} else if (now - since > threshold) {
+			[state setStall:begin_stall([state activity], loop, since, now)];
+		}
+	}
+	g_mutex_unlock(&watchdogLock);
+
+	if (sendMain) {
+		[self performSelectorOnMainThread:@selector(_heartbeatOnMainThread:)
+							   withObject:nil
+							waitUntilDone:NO];
+	}
+	if (sendGLib) {
+		g_idle_add_full(G_PRIORITY_DEFAULT, glib_heartbeat_cb, NULL, NULL);
+	}
+}
+
+- (void)_run:(id)unused {
+	while (![[NSThread currentThread] isCancelled]) {
+		@autoreleasepool {
+			[self _check];
+		}
+		[NSThread sleepForTimeInterval:_interval];
+	}
+}
+
+- (NSDictionary *)statistics {
+	NSMutableDictionary *loops;
+	NSMutableArray *stalls;
+
+	loops = [NSMutableDictionary dictionaryWithCapacity:LOOP_COUNT];
+	g_mutex_lock(&watchdogLock);
+	for (NSUInteger i = 0; i < LOOP_COUNT; i++) {
+		loops[loopNames[i]] = [loopStates[i] statistics];
+	}
+	stalls = [NSMutableArray arrayWithCapacity:[stallEvents count]];
+	for (NSDictionary *stall in stallEvents) {
+		[stalls addObject:[stall copy]];
+	}
+	g_mutex_unlock(&watchdogLock);
+
+	return @{
+		@"threshold" : @(_threshold * 1000.0),
+		@"loops" : loops,
+		@"stalls" : stalls,
+	};
+}
+
+- (void)invalidate {
+	if (g_atomic_int_compare_and_exchange(&_invalidated, 0, 1)) {
+		g_atomic_int_add(&runningWatchdogs, -1);
+		[_thread cancel];
+	}
+}
+
+@end
@@ -0,0 +1,61 @@
+/* vmpserverd - A virtual multimedia processor
+ * Copyright (C) 2024 Hugo Melder
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#import <Foundation/Foundation.h>
+#import <MicroHTTPKit/MicroHTTPKit.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * @brief Metrics in the Prometheus text exposition format
+ *
+ * A registry of counters, and gauges. The RTSP server, the pipeline managers,
+ * and the queue monitor update the samples when an event happens, e.g. a state
+ * change, a restart, or a bus error. Rendering the exposition only reads the
+ * registry, and the request counters of the HTTP server, so a scrape does not
+ * walk any pipelines.
+ *
+ * Samples are identified by the metric name, and their labels. All methods
+ * are MT-Safe.
+ */
+@interface VMPMetrics : NSObject
+
+/**
+ * @brief Set the value of a gauge, or counter
+ */
+- (void)setValue:(double)value
+		forMetric:(NSString *)name
+		   labels:(NSDictionary<NSString *, NSString *> *)labels;
+
+/**
+ * @brief Add a value to a gauge, or counter
+ *
+ * A missing sample starts at 0.
+ */
+- (void)addValue:(double)value
+		toMetric:(NSString *)name
+		  labels:(NSDictionary<NSString *, NSString *> *)labels;
+
+/**
+ * @brief Update the vmp_pipeline_state samples of a pipeline
+ *
+ * One sample is kept per state of VMPPipelineManager. The sample of the given
+ * state is 1, all other samples are 0.
+ */
+- (void)setPipelineState:(NSString *)state pipeline:(NSString *)pipeline;
+
+/**
+ * @brief Render all metrics
+ *
+ * @param server The HTTP server providing request statistics of its routes
+ *
+ * @returns the metrics in the text exposition format (version 0.0.4)
+ */
+- (NSString *)expositionWithHTTPServer:(HKHTTPServer *)server;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,218 @@
+/* vmpserverd - A virtual multimedia processor
+ * Copyright (C) 2024 Hugo Melder
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#import "VMPMetrics.h"
+#import "VMPPipelineManager.h"
+
+// Escape a label value as required by the exposition format
+static NSString *escapeLabelValue(NSString *value) {
+	value = [value stringByReplacingOccurrencesOfString:@"\\" withString:@"\\\\"];
+	value = [value stringByReplacingOccurrencesOfString:@"\"" withString:@"\\\""];
+	return [value stringByReplacingOccurrencesOfString:@"\n" withString:@"\\n"];
+}
+
+// Render labels as '{key="value",...}' in the order of the keys, or an empty string
+static NSString *renderLabels(NSDictionary<NSString *, NSString *> *labels) {
+	NSArray *keys;
+	NSMutableArray *pairs;
+
+	if ([labels count] == 0) {
+		return @"";
+	}
+
+	keys = [[labels allKeys] sortedArrayUsingSelector:@selector(compare:)];
+	pairs = [NSMutableArray arrayWithCapacity:[keys count]];
+	for (NSString *key in keys) {
+		[pairs addObject:[NSString stringWithFormat:@"%@=\"%@\"", key,
+													escapeLabelValue([labels[key] description])]];
+	}
+
+	return [NSString stringWithFormat:@"{%@}", [pairs componentsJoinedByString:@","]];
+}
+
+static void addFamily(NSMutableString *output, NSString *name, NSString *type, NSString *help) {
+	[output appendFormat:@"# HELP %@ %@\n# TYPE %@ %@\n", name, help, name, type];
+}
+
+static void addSample(NSMutableString *output, NSString *name,
+					  NSDictionary<NSString *, NSString *> *labels, id value) {
+	[output appendFormat:@"%@%@ %@\n", name, renderLabels(labels), value];
+}
+
+@implementation VMPMetrics {
+	// Name, type, and help of the families in the registry in the order of the exposition
+	NSArray<NSArray<NSString *> *> *_families;
+	// Values by family, and rendered labels. Protected by @synchronized(self).
+	NSMutableDictionary<NSString *, NSMutableDictionary<NSString *, NSNumber *> *> *_samples;
+}
+
+- (instancetype)init {
+	self = [super init];
+	if (self) {
+		_families = @[
+			@[
+				@"vmp_pipeline_restarts_total", @"counter", @"Number of restarts of a pipeline"
+			],
+			@[
+				@"vmp_pipeline_state", @"gauge",
+				@"State of a pipeline. The sample of the current state is 1, all others are 0."
+			],
+			@[
+				@"vmp_pipeline_frames_per_second", @"gauge",
+				@"Number of buffers per second reaching the sink of a pipeline"
+			],
+			@[
+				@"vmp_pipeline_dropped_frames_total", @"counter",
+				@"Number of frames missing in the stream reaching the sink of a pipeline"
+			],
+			@[
+				@"vmp_pipeline_stalls_total", @"counter",
+				@"Number of times no buffer reached the sink of a pipeline in time"
+			],
+			@[
+				@"vmp_queue_fill_ratio", @"gauge",
+				@"Fill level of a queue relative to its maximum size at the last sample"
+			],
+			@[
+				@"vmp_bus_messages_total", @"counter",
+				@"Number of errors, and warnings posted on the bus of a pipeline"
+			],
+			@[ @"vmp_recordings_active", @"gauge", @"Number of active recordings" ],
+			@[ @"vmp_rtsp_sessions", @"gauge", @"Number of RTSP sessions" ],
+			@[ @"vmp_rtsp_clients", @"gauge", @"Number of RTSP sessions using a mountpoint" ],
+			@[
+				@"vmp_rtsp_rejected_setup_requests_total", @"counter",
+				@"Number of SETUP requests rejected due to client limits"
+			],
+		];
+		_samples = [NSMutableDictionary dictionaryWithCapacity:[_families count]];
+		for (NSArray<NSString *> *family in _families) {
+			_samples[family[0]] = [NSMutableDictionary dictionary];
+		}
+
+		// Metrics without labels are reported from the start
+		_samples[@"vmp_recordings_active"][@""] = @0;
+		_samples[@"vmp_rtsp_sessions"][@""] = @0;
+		_samples[@"vmp_rtsp_rejected_setup_requests_total"][@""] = @0;
+	}
+	return self;
+}
+
+- (void)setValue:(double)value
+		forMetric:(NSString *)name
+		   labels:(NSDictionary<NSString *, NSString *> *)labels {
+	NSString *key = renderLabels(labels);
+
+	@synchronized(self) {
+		NSAssert(_samples[name], @"Unknown metric %@", name);
+		_samples[name][key] = @(value);
+	}
+}
+
+- (void)addValue:(double)value
+		toMetric:(NSString *)name
+		  labels:(NSDictionary<NSString *, NSString *> *)labels {
+	NSString *key = renderLabels(labels);
+
+	@synchronized(self) {
+		NSMutableDictionary<NSString *, NSNumber *> *samples = _samples[name];
+
+		NSAssert(samples, @"Unknown metric %@", name);
+		samples[key] = @([samples[key] doubleValue] + value);
+	}
+}
+
+- (void)setPipelineState:(NSString *)state pipeline:(NSString *)pipeline {
+	NSArray<NSString *> *states = @[ kVMPStateCreated, kVMPStatePlaying, kVMPStateEOS ];
+	NSMutableDictionary<NSString *, NSString *> *labels;
+	NSMutableDictionary<NSString *, NSNumber *> *values;
+
+	labels = [NSMutableDictionary dictionaryWithObject:pipeline forKey:@"pipeline"];
+	values = [NSMutableDictionary dictionaryWithCapacity:[states count]];
+	for (NSString *cur in states) {
+		labels[@"state"] = cur;
+		values[renderLabels(labels)] = @([cur isEqualToString:state] ? 1 : 0);
+	}
+
+	// All samples of the pipeline change at once
+	@synchronized(self) {
+		[_samples[@"vmp_pipeline_state"] addEntriesFromDictionary:values];
+	}
+}
+
+- (void)_addHTTPMetrics:(HKHTTPServer *)server output:(NSMutableString *)output {
+	NSArray<HKRoute *> *routes;
+	NSMutableArray<NSDictionary *> *statistics;
+
+	routes = [[server router] routes];
+	statistics = [NSMutableArray arrayWithCapacity:[routes count]];
+	for (HKRoute *route in routes) {
+		[statistics addObject:[route statistics]];
+	}
+
+	addFamily(output, @"vmp_http_requests_total", @"counter",
+			  @"Number of HTTP requests by route, and status class");
+	for (NSUInteger i = 0; i < [routes count]; i++) {
+		NSDictionary<NSString *, NSNumber *> *responses;
+
+		responses = statistics[i][HKRouteStatisticsResponsesKey];
+		for (NSString *code in responses) {
+			addSample(output, @"vmp_http_requests_total",
+					  @{@"method" : [routes[i] method], @"path" : [routes[i] path], @"code" : code},
+					  responses[code]);
+		}
+	}
+
+	addFamily(output, @"vmp_http_not_found_requests_total", @"counter",
+			  @"Number of HTTP requests without a matching route");
+	addSample(output, @"vmp_http_not_found_requests_total", @{},
+			  @([server numberOfNotFoundRequests]));
+
+	addFamily(output, @"vmp_http_request_duration_seconds", @"histogram",
+			  @"Time spent handling an HTTP request");
+	for (NSUInteger i = 0; i < [routes count]; i++) {
+		NSDictionary *labels = @{@"method" : [routes[i] method], @"path" : [routes[i] path]};
+		NSArray<NSNumber *> *buckets = statistics[i][HKRouteStatisticsDurationBucketsKey];
+		NSMutableDictionary *bucketLabels = [labels mutableCopy];
+
+		for (NSUInteger b = 0; b < [buckets count]; b++) {
+			bucketLabels[@"le"] = [NSString stringWithFormat:@"%g", HKRouteDurationBuckets[b]];
+			addSample(output, @"vmp_http_request_duration_seconds_bucket", bucketLabels,
+					  buckets[b]);
+		}
+		bucketLabels[@"le"] = @"+Inf";
+		addSample(output, @"vmp_http_request_duration_seconds_bucket", bucketLabels,
+				  statistics[i][HKRouteStatisticsRequestsKey]);
+		addSample(output, @"vmp_http_request_duration_seconds_sum", labels,
+				  statistics[i][HKRouteStatisticsDurationSumKey]);
+		addSample(output, @"vmp_http_request_duration_seconds_count", labels,
+				  statistics[i][HKRouteStatisticsRequestsKey]);
+	}
+}
+
+- (NSString *)expositionWithHTTPServer:(HKHTTPServer *)server {
+	NSMutableString *output = [NSMutableString stringWithCapacity:4096];
+
+	@synchronized(self) {
+		for (NSArray<NSString *> *family in _families) {
+			NSDictionary<NSString *, NSNumber *> *samples = _samples[family[0]];
+			NSArray<NSString *> *keys;
+
+			addFamily(output, family[0], family[1], family[2]);
+			keys = [[samples allKeys] sortedArrayUsingSelector:@selector(compare:)];
+			for (NSString *key in keys) {
+				[output appendFormat:@"%@%@ %@\n", family[0], key, samples[key]];
+			}
+		}
+	}
+
+	// The routes count their requests with atomics
+	[self _addHTTPMetrics:server output:output];
+
+	return output;
+}
+
+@end
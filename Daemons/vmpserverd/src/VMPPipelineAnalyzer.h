@@ -0,0 +1,69 @@
+/* vmpserverd - A virtual multimedia processor
+ * Copyright (C) 2024 Hugo Melder
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#import <Foundation/Foundation.h>
+#import <gst/gst.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * @brief Finds expensive conversions in a negotiated pipeline
+ *
+ * The analyzer compares the negotiated caps on the sink, and source pads of
+ * every element handling raw video. An element is reported if
+ * - it is a converter, or scaler (e.g. videoconvert, videoscale) that is not
+ *   in passthrough mode,
+ * - the memory type of its input, and output differs (e.g. VAMemory to
+ *   system memory), or
+ * - the format, or resolution of its input, and output differs.
+ *
+ * The cost of a reported element is estimated as the size of an input frame
+ * plus the size of an output frame, i.e. the bytes read, and written per frame.
+ *
+ * The pipeline must be prerolled, as caps are only available after negotiation.
+ */
+@interface VMPPipelineAnalyzer : NSObject
+
+/**
+ * @brief Analyze a pipeline
+ *
+ * Example structure:
+ * @code
+ * {
+ *     "elements": [
+ *         {
+ *             "name": "videoconvert0",
+ *             "factoryName": "videoconvert",
+ *             "issues": ["converter", "formatConversion"],
+ *             "input": {"format": "YUY2", "width": 1920, "height": 1080,
+ *                       "memory": "SystemMemory"},
+ *             "output": {"format": "NV12", "width": 1920, "height": 1080,
+ *                        "memory": "SystemMemory"},
+ *             "bytesPerFrame": 7257600,
+ *             "bytesPerSecond": 217728000 // Only if the frame rate is known
+ *         }
+ *     ],
+ *     "bytesPerFrame": 7257600, // Sum of all elements
+ *     "bytesPerSecond": 217728000
+ * }
+ * @endcode
+ *
+ * Possible issues are "converter", "memoryTransition", and "formatConversion".
+ *
+ * @param pipeline A pipeline, or bin. Nested bins are analyzed as well.
+ *
+ * @returns the analysis as a JSON-serialisable dictionary
+ */
++ (NSDictionary *)analyzePipeline:(GstElement *)pipeline;
+
+/**
+ * @brief Log every reported element of an analysis as a warning
+ */
++ (void)logAnalysis:(NSDictionary *)analysis pipelineName:(NSString *)name;
+
+@end
+
+NS_ASSUME_NONNULL_END
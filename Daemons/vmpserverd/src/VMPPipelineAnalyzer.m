@@ -0,0 +1,232 @@
+/* vmpserverd - A virtual multimedia processor
+ * Copyright (C) 2024 Hugo Melder
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#import <gst/base/gstbasetransform.h>
+#import <gst/video/video.h>
+
+#import "VMPJournal.h"
+#import "VMPPipelineAnalyzer.h"
+
+// Negotiated raw video on a pad
+struct video_side {
+	GstVideoInfo info;
+	// Memory type from the caps features, e.g. "VAMemory"
+	const gchar *memory;
+};
+
+// Transfer: Full. The first current caps of a pad in the given direction, or NULL.
+static GstCaps *element_current_caps(GstElement *element, GstPadDirection direction) {
+	GstCaps *caps = NULL;
+	GList *pads;
+
+	GST_OBJECT_LOCK(element);
+	pads = direction == GST_PAD_SINK ? element->sinkpads : element->srcpads;
+	for (GList *l = pads; l != NULL && caps == NULL; l = l->next) {
+		caps = gst_pad_get_current_caps(GST_PAD(l->data));
+	}
+	GST_OBJECT_UNLOCK(element);
+
+	return caps;
+}
+
+// Returns FALSE if the caps are not raw video
+static gboolean video_side_from_caps(GstCaps *caps, struct video_side *side) {
+	GstCapsFeatures *features;
+
+	if (caps == NULL || gst_caps_is_empty(caps) ||
+		!gst_structure_has_name(gst_caps_get_structure(caps, 0), "video/x-raw")) {
+		return FALSE;
+	}
+	if (!gst_video_info_from_caps(&side->info, caps)) {
+		return FALSE;
+	}
+
+	// Caps without features are in system memory
+	side->memory = "SystemMemory";
+	features = gst_caps_get_features(caps, 0);
+	if (features != NULL && !gst_caps_features_is_any(features)) {
+		for (guint i = 0; i < gst_caps_features_get_size(features); i++) {
+			const gchar *feature = gst_caps_features_get_nth(features, i);
+
+			if (g_str_has_prefix(feature, "memory:")) {
+				side->memory = feature + strlen("memory:");
+				break;
+			}
+		}
+	}
+
+	return TRUE;
+}
+
+static NSDictionary *video_side_dictionary(struct video_side *side) {
+	return @{
+		@"format" : @(gst_video_format_to_string(GST_VIDEO_INFO_FORMAT(&side->info))),
+		@"width" : @(GST_VIDEO_INFO_WIDTH(&side->info)),
+		@"height" : @(GST_VIDEO_INFO_HEIGHT(&side->info)),
+		@"memory" : @(side->memory),
+	};
+}
+
+static BOOL is_converter(GstElement *element) {
+	GstElementFactory *factory;
+	const gchar *klass;
+
+	// Transfer: None
+	factory = gst_element_get_factory(element);
+	if (factory == NULL) {
+		return NO;
+	}
+
+	klass = gst_element_factory_get_metadata(factory, GST_ELEMENT_METADATA_KLASS);
+	if (klass == NULL) {
+		return NO;
+	}
+
+	return strstr(klass, "Converter") != NULL || strstr(klass, "Scaler") != NULL;
+}
+
+@implementation VMPPipelineAnalyzer
+
+// Returns nil if the element does no expensive work on raw video
++ (NSDictionary *)_analyzeElement:(GstElement *)element {
+	struct video_side input, output;
+	NSMutableArray<NSString *> *issues;
+	NSMutableDictionary *result;
+	GstElementFactory *factory;
+	GstCaps *sinkCaps, *srcCaps;
+	gboolean raw;
+	guint64 bytes;
+
+	sinkCaps = element_current_caps(element, GST_PAD_SINK);
+	srcCaps = element_current_caps(element, GST_PAD_SRC);
+	raw = video_side_from_caps(sinkCaps, &input) && video_side_from_caps(srcCaps, &output);
+	if (sinkCaps) {
+		gst_caps_unref(sinkCaps);
+	}
+	if (srcCaps) {
+		gst_caps_unref(srcCaps);
+	}
+	// Sources, sinks, encoders, and decoders
+	if (!raw) {
+		return nil;
+	}
+
+	issues = [NSMutableArray array];
+	if (is_converter(element) && GST_IS_BASE_TRANSFORM(element) &&
+		!gst_base_transform_is_passthrough(GST_BASE_TRANSFORM(element))) {
+		[issues addObject:@"converter"];
+	}
+	if (g_strcmp0(input.memory, output.memory) != 0) {
+		[issues addObject:@"memoryTransition"];
+	}
+	if (GST_VIDEO_INFO_FORMAT(&input.info) != GST_VIDEO_INFO_FORMAT(&output.info) ||
+		GST_VIDEO_INFO_WIDTH(&input.info) != GST_VIDEO_INFO_WIDTH(&output.info) ||
+		GST_VIDEO_INFO_HEIGHT(&input.info) != GST_VIDEO_INFO_HEIGHT(&output.info)) {
+		[issues addObject:@"formatConversion"];
+	}
+	if ([issues count] == 0) {
+		return nil;
+	}
+
+	bytes = GST_VIDEO_INFO_SIZE(&input.info) + GST_VIDEO_INFO_SIZE(&output.info);
+	result = [NSMutableDictionary dictionaryWithDictionary:@{
+		@"name" : @(GST_OBJECT_NAME(element)),
+		@"issues" : issues,
+		@"input" : video_side_dictionary(&input),
+		@"output" : video_side_dictionary(&output),
+		@"bytesPerFrame" : @(bytes),
+	}];
+
+	factory = gst_element_get_factory(element);
+	if (factory) {
+		result[@"factoryName"] = @(GST_OBJECT_NAME(factory));
+	}
+	if (GST_VIDEO_INFO_FPS_N(&output.info) > 0 && GST_VIDEO_INFO_FPS_D(&output.info) > 0) {
+		result[@"bytesPerSecond"] =
+			@(gst_util_uint64_scale(bytes, GST_VIDEO_INFO_FPS_N(&output.info),
+									GST_VIDEO_INFO_FPS_D(&output.info)));
+	}
+
+	return result;
+}
+
++ (NSDictionary *)analyzePipeline:(GstElement *)pipeline {
+	NSMutableArray<NSDictionary *> *elements;
+	GValue item = G_VALUE_INIT;
+	GstIterator *iter;
+	gboolean done = FALSE;
+	guint64 bytesPerFrame = 0;
+	guint64 bytesPerSecond = 0;
+
+	elements = [NSMutableArray array];
+	if (!GST_IS_BIN(pipeline)) {
+		return @{@"elements" : elements, @"bytesPerFrame" : @0, @"bytesPerSecond" : @0};
+	}
+
+	iter = gst_bin_iterate_recurse(GST_BIN(pipeline));
+	while (!done) {
+		switch (gst_iterator_next(iter, &item)) {
+		case GST_ITERATOR_OK: {
+			GstElement *element = g_value_get_object(&item);
+			NSDictionary *analysis;
+
+			// The pads of bins are ghost pads of their children
+			if (!GST_IS_BIN(element)) {
+				analysis = [self _analyzeElement:element];
+				if (analysis) {
+					[elements addObject:analysis];
+					bytesPerFrame += [analysis[@"bytesPerFrame"] unsignedLongLongValue];
+					bytesPerSecond += [analysis[@"bytesPerSecond"] unsignedLongLongValue];
+				}
+			}
+			g_value_reset(&item);
+			break;
+		}
+		case GST_ITERATOR_RESYNC:
+			gst_iterator_resync(iter);
+			[elements removeAllObjects];
+			bytesPerFrame = 0;
+			bytesPerSecond = 0;
+			break;
+		default:
+			done = TRUE;
+			break;
+		}
+	}
+	g_value_unset(&item);
+	gst_iterator_free(iter);
+
+	return @{
+		@"elements" : elements,
+		@"bytesPerFrame" : @(bytesPerFrame),
+		@"bytesPerSecond" : @(bytesPerSecond),
+	};
+}
+
++ (void)logAnalysis:(NSDictionary *)analysis pipelineName:(NSString *)name {
+	NSArray<NSDictionary *> *elements = analysis[@"elements"];
+
+	if ([elements count] == 0) {
+		VMPDebug(@"No expensive conversions found in pipeline %@", name);
+		return;
+	}
+
+	for (NSDictionary *element in elements) {
+		NSDictionary *input = element[@"input"];
+		NSDictionary *output = element[@"output"];
+
+		VMPWarn(@"Element %@ in pipeline %@ (%@) converts %@ %@x%@ (%@) to %@ %@x%@ (%@), "
+				@"costing about %.1f MB per frame",
+				element[@"name"], name, [element[@"issues"] componentsJoinedByString:@", "],
+				input[@"format"], input[@"width"], input[@"height"], input[@"memory"],
+				output[@"format"], output[@"width"], output[@"height"], output[@"memory"],
+				[element[@"bytesPerFrame"] doubleValue] / 1e6);
+	}
+	VMPInfo(@"Pipeline %@ has %lu expensive conversions costing about %.1f MB per frame", name,
+			(unsigned long) [elements count], [analysis[@"bytesPerFrame"] doubleValue] / 1e6);
+}
+
+@end
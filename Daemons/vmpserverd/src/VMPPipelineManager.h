@@ -7,6 +7,12 @@
 #import <Foundation/Foundation.h>
 #import <gst/gst.h>
 
+#import "VMPElementModel.h"
+#import "VMPMetrics.h"
+#import "VMPQueueMonitor.h"
+#import "VMPStreamPublisher.h"
+#import "VMPTracer.h"
+
 NS_ASSUME_NONNULL_BEGIN
 
 /// The initial state of the pipeline after creation
@@ -18,6 +24,38 @@ extern NSString *const kVMPStateEOS;
 
 /// Key for pipeline restart count in stats dictionary. @see VMPPipelineManager
 extern NSString *const kVMPStatisticsNumberOfRestarts;
+/// Key for the duration of the last restart in milliseconds
+extern NSString *const kVMPStatisticsLastRestartDuration;
+/// Key for the average restart duration in milliseconds
+extern NSString *const kVMPStatisticsAverageRestartDuration;
+/// Key for the number of restarts that required a full pipeline rebuild
+extern NSString *const kVMPStatisticsNumberOfRebuilds;
+/// Key for the duration of the last gst_parse_launch in milliseconds
+extern NSString *const kVMPStatisticsParseDuration;
+/// Key for the duration of the last state change to PLAYING in milliseconds
+extern NSString *const kVMPStatisticsStateChangeDuration;
+/// Key for the average bus-message-to-delegate latency in microseconds
+extern NSString *const kVMPStatisticsBusLatencyAverage;
+/// Key for the maximum bus-message-to-delegate latency in microseconds
+extern NSString *const kVMPStatisticsBusLatencyMax;
+/// Key for the number of buffers per second reaching the sink in the last second
+extern NSString *const kVMPStatisticsFramesPerSecond;
+/// Key for the number of frames missing between the timestamps of consecutive buffers
+extern NSString *const kVMPStatisticsDroppedFrames;
+/// Key for the number of detected stalls
+extern NSString *const kVMPStatisticsNumberOfStalls;
+/// Key for the time in seconds since the last buffer reached the sink
+extern NSString *const kVMPStatisticsTimeSinceLastBuffer;
+
+/**
+ * @brief Strategy used by -[VMPPipelineManager restart]
+ */
+typedef NS_ENUM(NSInteger, VMPPipelineRestartStrategy) {
+	/// Cycle the existing pipeline through NULL and back to PLAYING, and rebuild on failure
+	VMPPipelineRestartStrategyInPlace = 0,
+	/// Always unreference the pipeline, and parse the launch arguments again
+	VMPPipelineRestartStrategyRebuild = 1
+};
 
 // Forward-declaration for VMPPipelineManagerDelegate
 @class VMPPipelineManager;
@@ -54,6 +92,18 @@ extern NSString *const kVMPStatisticsNumberOfRestarts;
  * forward this event if the delegate implemented this method.
  */
 - (void)onBusEvent:(GstMessage *)message manager:(VMPPipelineManager *)mgr;
+
+/**
+ * @brief Called when no buffer reached the sink of the pipeline within the stall timeout
+ *
+ * @param duration Seconds since the last buffer, or the start of the pipeline
+ *
+ * Called once per stall from the GLib dispatch thread. The watchdog is armed
+ * again when the pipeline is restarted.
+ *
+ * @see stallTimeout
+ */
+- (void)onStall:(NSTimeInterval)duration manager:(VMPPipelineManager *)mgr;
 @end
 
 /**
@@ -105,12 +155,116 @@ extern NSString *const kVMPStatisticsNumberOfRestarts;
  */
 @property (nonatomic, readonly) NSString *state;
 
+/**
+ * @brief The strategy used when restarting the pipeline
+ *
+ * Defaults to VMPPipelineRestartStrategyInPlace.
+ *
+ * @see restart
+ */
+@property (nonatomic, assign) VMPPipelineRestartStrategy restartStrategy;
+
+/**
+ * @brief Publisher for the stream of this pipeline
+ *
+ * If set, the appsink named "publisher" is attached to the publisher
+ * whenever the pipeline is created.
+ *
+ * @note Changing the publisher takes effect on the next pipeline restart.
+ */
+@property (nonatomic, strong, nullable) VMPStreamPublisher *publisher;
+
+/**
+ * @brief Streams consumed by this pipeline
+ *
+ * Maps the name of an appsrc element in the pipeline to the publisher
+ * it subscribes to. The appsrc elements are subscribed while the pipeline
+ * exists.
+ *
+ * @note Changing the subscriptions takes effect on the next pipeline restart.
+ */
+@property (nonatomic, copy, nullable) NSDictionary<NSString *, VMPStreamPublisher *> *subscriptions;
+
+/**
+ * @brief Seconds without a buffer reaching the sink after which the pipeline is stalled
+ *
+ * The appsink of the publisher is monitored, or every sink of the pipeline
+ * if there is no publisher. The pipeline is stalled when one of the sinks
+ * receives no buffer. A value of 0 disables stall detection (default). Frame
+ * rate, and dropped frames are counted regardless.
+ *
+ * @note Changing the timeout takes effect on the next pipeline restart.
+ *
+ * @see VMPPipelineManagerDelegate
+ */
+@property (nonatomic, assign) NSTimeInterval stallTimeout;
+
+/**
+ * @brief Tracer for the pipeline
+ *
+ * If set, the pipeline is traced under the channel name whenever it is created.
+ *
+ * @see VMPTracer
+ */
+@property (nonatomic, strong, nullable) VMPTracer *tracer;
+
+/**
+ * @brief Monitor for the queues in the pipeline
+ *
+ * If set, the pipeline is monitored under the channel name whenever it is created.
+ *
+ * @see VMPQueueMonitor
+ */
+@property (nonatomic, strong, nullable) VMPQueueMonitor *queueMonitor;
+
+/**
+ * @brief Metrics registry for the pipeline
+ *
+ * If set, the state, restarts, frame rate, dropped frames, and stalls of the
+ * pipeline are published under the channel name when they change. The frame
+ * rate is published by the stall check, which runs while metrics are set even
+ * without a stall timeout.
+ *
+ * @see VMPMetrics
+ */
+@property (nonatomic, strong, nullable) VMPMetrics *metrics;
+
+/**
+ * @brief Expensive conversions found in the pipeline
+ *
+ * The pipeline is analyzed, and the findings are logged once it reaches
+ * PLAYING after each start, or restart. nil until then. MT-Safe.
+ *
+ * @see VMPPipelineAnalyzer
+ */
+@property (readonly, nullable) NSDictionary *analysis;
+
 /**
  * @brief Pipeline statistics
  *
  * The following statistics are available:
  * @li @see kVMPStatisticsNumberOfRestarts - The number of times the pipeline
  * has been restarted
+ * @li @see kVMPStatisticsLastRestartDuration - Duration of the last restart in milliseconds
+ * @li @see kVMPStatisticsAverageRestartDuration - Average restart duration in milliseconds
+ * @li @see kVMPStatisticsNumberOfRebuilds - The number of restarts that fell back to
+ * rebuilding the pipeline from the launch arguments
+ * @li @see kVMPStatisticsParseDuration - Duration of the last pipeline construction
+ * from the launch arguments in milliseconds
+ * @li @see kVMPStatisticsStateChangeDuration - Duration of the last state change to
+ * PLAYING in milliseconds
+ * @li @see kVMPStatisticsBusLatencyAverage - Average time in microseconds between
+ * posting a message on the pipeline bus and delivering it to the delegate
+ * @li @see kVMPStatisticsBusLatencyMax - Maximum bus delivery latency in microseconds
+ * @li @see kVMPStatisticsFramesPerSecond - Buffers per second reaching the sink
+ * @li @see kVMPStatisticsDroppedFrames - Frames missing in the stream reaching the sink,
+ * derived from gaps between the timestamps of buffers
+ * @li @see kVMPStatisticsNumberOfStalls - Number of times no buffer reached the sink
+ * within the stall timeout
+ * @li @see kVMPStatisticsTimeSinceLastBuffer - Seconds since the last buffer reached the sink
+ *
+ * The statistics are updated from the GLib dispatch thread, and the streaming
+ * thread of the sink. This property returns a snapshot.
  */
 @property (nonatomic, readonly) NSDictionary *statistics;
 
@@ -162,7 +316,7 @@ extern NSString *const kVMPStatisticsNumberOfRestarts;
  *
  * GStreamer offers a way to view at the current pipeline configuration by
  * generated a dot graph of the pipeline, including elements, negotiated
- * capabilities, and the state of the pipeline.
+ * capabilities, and the state of the pipeline. MT-Safe.
  *
  * This functionality is exposed via this method.
  *
@@ -170,13 +324,41 @@ extern NSString *const kVMPStatisticsNumberOfRestarts;
  */
 - (nullable NSData *)pipelineDotGraph;
 
+/**
+ * @brief Snapshot of the elements, pads, negotiated caps, and links of the pipeline
+ *
+ * Walking the pipeline is much cheaper than generating a dot graph, and
+ * the property list of the returned model can be serialised to JSON. MT-Safe.
+ *
+ * @returns the model of the top-level pipeline, or nil if no pipeline was created
+ */
+- (nullable VMPElementModel *)pipelineTopology;
+
 /**
  * @brief Starts the pipeline manager
  *
+ * Pipeline managers do not share state, so different managers can be started
+ * concurrently.
+ *
  * @returns YES if the pipeline manager was started successfully, NO otherwise
  */
 - (BOOL)start;
 
+/**
+ * @brief Restarts the pipeline
+ *
+ * With VMPPipelineRestartStrategyInPlace, the existing pipeline is set
+ * to NULL, and back to PLAYING. This releases, and reopens all devices without
+ * the cost of tearing down the pipeline and parsing the launch arguments again.
+ * If the in-place restart fails, or no pipeline exists, the pipeline is rebuilt
+ * with stop and start.
+ *
+ * The duration of the restart is recorded in the statistics.
+ *
+ * @returns YES if the pipeline is playing again, NO otherwise
+ */
+- (BOOL)restart;
+
 /**
  * @brief Send EOS event to underlying pipeline
  */
@@ -184,6 +366,9 @@ extern NSString *const kVMPStatisticsNumberOfRestarts;
 
 /**
  * @brief Stops the pipeline manager
+ *
+ * The bus watch of a running pipeline holds a reference to the manager, so a
+ * started manager must be stopped before it is deallocated.
  */
 - (void)stop;
 
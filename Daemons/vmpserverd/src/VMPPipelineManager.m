@@ -8,6 +8,8 @@
 
 #import "VMPErrors.h"
 #import "VMPJournal.h"
+#import "VMPLoopWatchdog.h"
+#import "VMPPipelineAnalyzer.h"
 #import "VMPPipelineManager.h"
 
 NSString *const kVMPStateCreated = @"created";
@@ -15,23 +17,182 @@ NSString *const kVMPStatePlaying = @"playing";
 NSString *const kVMPStateEOS = @"eos";
 
 NSString *const kVMPStatisticsNumberOfRestarts = @"numberOfRestarts";
+NSString *const kVMPStatisticsLastRestartDuration = @"lastRestartDuration";
+NSString *const kVMPStatisticsAverageRestartDuration = @"averageRestartDuration";
+NSString *const kVMPStatisticsNumberOfRebuilds = @"numberOfRebuilds";
+NSString *const kVMPStatisticsParseDuration = @"parseDuration";
+NSString *const kVMPStatisticsStateChangeDuration = @"stateChangeDuration";
+NSString *const kVMPStatisticsBusLatencyAverage = @"busLatencyAverage";
+NSString *const kVMPStatisticsBusLatencyMax = @"busLatencyMax";
+NSString *const kVMPStatisticsFramesPerSecond = @"framesPerSecond";
+NSString *const kVMPStatisticsDroppedFrames = @"droppedFrames";
+NSString *const kVMPStatisticsNumberOfStalls = @"numberOfStalls";
+NSString *const kVMPStatisticsTimeSinceLastBuffer = @"timeSinceLastBuffer";
+
+// Interval of the stall check in milliseconds
+#define WATCHDOG_INTERVAL 500
+
+struct watchdog;
+
+// Buffers reaching one sink pad. Protected by the lock of the watchdog.
+struct watchdog_sink {
+	struct watchdog *watchdog;
+	// Monotonic time of the last buffer, or of the (re)start of the pipeline
+	gint64 lastBuffer;
+	GstClockTime lastPts;
+	// Buffers counted since windowStart for computing the frame rate
+	gint64 windowStart;
+	guint64 windowFrames;
+	double framesPerSecond;
+};
+
+/* Buffers reaching the sinks of the pipeline. Updated from the streaming
+ * threads of the sinks, and read from the GLib dispatch thread.
+ */
+struct watchdog {
+	GMutex lock;
+	// Monitored sink pads (struct watchdog_sink). Replaced when the pipeline is created.
+	GPtrArray *sinks;
+	guint64 dropped;
+	guint64 stalls;
+	// Whether a stall is reported
+	BOOL armed;
+};
+
+/* Highest frame rate, and the oldest last buffer of all sinks. A sink without a
+ * buffer for two seconds has a frame rate of 0. Call with the lock held.
+ */
+static void watchdog_summary(struct watchdog *watchdog, gint64 now, double *framesPerSecond,
+							 gint64 *lastBuffer) {
+	*framesPerSecond = 0;
+	*lastBuffer = 0;
+
+	for (guint i = 0; i < watchdog->sinks->len; i++) {
+		struct watchdog_sink *sink = g_ptr_array_index(watchdog->sinks, i);
+
+		// The frame rate is only updated when buffers arrive
+		if (now - sink->lastBuffer <= 2 * G_USEC_PER_SEC) {
+			*framesPerSecond = MAX(*framesPerSecond, sink->framesPerSecond);
+		}
+		if (*lastBuffer == 0 || sink->lastBuffer < *lastBuffer) {
+			*lastBuffer = sink->lastBuffer;
+		}
+	}
+}
+
+// Quark for attaching the monotonic post time to a bus message
+static GQuark postedAtQuark;
+
+// A category for (re)defining properties and declaring classes for private use
+@interface VMPPipelineManager ()
+
+@property (nonatomic, readwrite) NSString *state;
+@property (nonatomic, readwrite) NSString *channel;
+@property (nonatomic) GstElement *pipeline;
+// Activity reported to the loop watchdog while a bus message is handled
+@property (nonatomic, readonly) NSString *busActivity;
+
+// Pipeline management
+- (GstElement *)_referencePipeline;
+- (BOOL)_createPipelineWithError:(NSError **)error;
+- (BOOL)_resumePipelineWithError:(NSError **)error;
+- (BOOL)_restartPipelineInPlaceWithError:(NSError **)error;
+
+// Stream publisher and subscriptions
+- (void)_connectStreams;
+- (void)_disconnectStreams;
+
+// Statistics
+- (void)_countStart;
+- (void)_recordBusLatency:(gint64)latency;
+
+// Called on the first state change of the pipeline to PLAYING
+- (void)_analyzePipeline:(GstElement *)pipeline;
+
+// Stall detection
+- (void)_installWatchdog;
+- (void)_resetWatchdog;
+- (void)_armWatchdog;
+- (void)_checkForStall;
+
+// Metrics
+- (void)_publishWatchdogMetrics;
+
+@end
+
+/* Record the time at which a message was posted on the bus.
+ *
+ * The sync handler is called from the thread posting the message (usually a
+ * streaming thread), before the message is queued for the asynchronous bus
+ * watch. We attach the monotonic time to the message, and compute the dispatch
+ * latency once the message reaches the delegate.
+ */
+static GstBusSyncReply gstreamer_bus_sync_cb(GstBus *bus, GstMessage *message, gpointer data) {
+	gint64 *postedAt;
+
+	postedAt = g_new(gint64, 1);
+	*postedAt = g_get_monotonic_time();
+	gst_mini_object_set_qdata(GST_MINI_OBJECT_CAST(message), postedAtQuark, postedAt, g_free);
+
+	return GST_BUS_PASS;
+}
+
+/* Balance the reference of the manager taken when adding a bus watch, or timeout.
+ *
+ * Called when the source is destroyed. GLib keeps the source alive while it is
+ * dispatched, so the manager outlives a callback that is still running on the
+ * GLib dispatch thread when the source is removed from another thread.
+ */
+static void release_manager(gpointer data) {
+	(void) (__bridge_transfer id) data;
+}
 
 /* We bridge the GStreamer bus callback mechanism with our VMPPipelineManagerDelegate.
  *
  * In order to do this, we need to annotate the cast from a void pointer to an
  * Objective-C object. This is mandatory, as we compile with ARC support.
  *
- * The object is bridged without retaining it, as the lifetime of the pipeline manager
- * is at least as long as the lifetime of the GStreamer pipeline.
+ * The bus watch holds a reference to the manager, which is released by
+ * release_manager once the watch is removed in -stop.
  */
 static gboolean gstreamer_bus_cb(GstBus *bus, GstMessage *message, void *mgr) {
-	// Cast back to an Objective-C object without retaining it
-	__unsafe_unretained VMPPipelineManager *localManager = (__bridge id) mgr;
+	@autoreleasepool {
+		// Cast back to an Objective-C object. The reference is owned by the bus watch.
+		__unsafe_unretained VMPPipelineManager *localManager = (__bridge id) mgr;
+		gint64 *postedAt;
+		BOOL watched;
+
+		if (localManager != nil) {
+			// The label is built once per manager, as this runs for every message
+			watched = [VMPLoopWatchdog isRunning];
+			if (watched) {
+				[VMPLoopWatchdog beginActivity:[localManager busActivity] onLoop:VMPLoopGLib];
+			}
+
+			postedAt = gst_mini_object_get_qdata(GST_MINI_OBJECT_CAST(message), postedAtQuark);
+			if (postedAt != NULL) {
+				[localManager _recordBusLatency:g_get_monotonic_time() - *postedAt];
+			}
+
+			// The message holds a reference to its source
+			if (GST_MESSAGE_TYPE(message) == GST_MESSAGE_STATE_CHANGED &&
+				GST_IS_PIPELINE(GST_MESSAGE_SRC(message))) {
+				GstState newState;
+
+				gst_message_parse_state_changed(message, NULL, &newState, NULL);
+				if (newState == GST_STATE_PLAYING) {
+					[localManager _analyzePipeline:GST_ELEMENT(GST_MESSAGE_SRC(message))];
+				}
+			}
+
+			// If the delegate responds to the onBusEvent:manager: selector, call it
+			if ([[localManager delegate] respondsToSelector:@selector(onBusEvent:manager:)]) {
+				[[localManager delegate] onBusEvent:message manager:localManager];
+			}
 
-	if (localManager != nil) {
-		// If the delegate responds to the onBusEvent:manager: selector, call it
-		if ([[localManager delegate] respondsToSelector:@selector(onBusEvent:manager:)]) {
-			[[localManager delegate] onBusEvent:message manager:localManager];
+			if (watched) {
+				[VMPLoopWatchdog endActivityOnLoop:VMPLoopGLib];
+			}
 		}
 	}
 
@@ -39,19 +200,87 @@ static gboolean gstreamer_bus_cb(GstBus *bus, GstMessage *message, void *mgr) {
 	return TRUE;
 }
 
-// A category for (re)defining properties and declaring classes for private use
-@interface VMPPipelineManager ()
+/* Called from the streaming thread of the sink for every buffer.
+ *
+ * A gap of more than one and a half frame durations between the timestamps of
+ * consecutive buffers means that frames were lost upstream, e.g. by a capture
+ * device, or a leaky queue.
+ */
+static GstPadProbeReturn watchdog_probe_cb(GstPad *pad, GstPadProbeInfo *info,
+										   gpointer user_data) {
+	struct watchdog_sink *sink = user_data;
+	struct watchdog *watchdog = sink->watchdog;
+	GstBuffer *buffer;
+	GstClockTime pts;
+	GstClockTime duration;
+	gint64 now;
+
+	buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+	pts = GST_BUFFER_PTS(buffer);
+	duration = GST_BUFFER_DURATION(buffer);
+	now = g_get_monotonic_time();
+
+	g_mutex_lock(&watchdog->lock);
+	if (GST_CLOCK_TIME_IS_VALID(pts) && GST_CLOCK_TIME_IS_VALID(sink->lastPts) &&
+		GST_CLOCK_TIME_IS_VALID(duration) && duration > 0 &&
+		pts > sink->lastPts + duration * 3 / 2) {
+		watchdog->dropped += (pts - sink->lastPts + duration / 2) / duration - 1;
+	}
+	sink->lastPts = pts;
+	sink->lastBuffer = now;
+
+	sink->windowFrames++;
+	if (now - sink->windowStart >= G_USEC_PER_SEC) {
+		sink->framesPerSecond = (double) sink->windowFrames * G_USEC_PER_SEC /
+								(double) (now - sink->windowStart);
+		sink->windowStart = now;
+		sink->windowFrames = 0;
+	}
+	g_mutex_unlock(&watchdog->lock);
 
-@property (nonatomic, readwrite) NSString *state;
-@property (nonatomic, readwrite) NSString *channel;
-@property (nonatomic) GstElement *pipeline;
-@property (nonatomic, readwrite) NSMutableDictionary *statistics;
+	return GST_PAD_PROBE_OK;
+}
 
-// Pipeline management
-- (BOOL)_createPipelineWithError:(NSError **)error;
-- (BOOL)_resumePipelineWithError:(NSError **)error;
+/* Add a record for the pad to the sinks of the watchdog, and probe it.
+ *
+ * The records are freed when the pipeline is created again, or the manager is
+ * deallocated. The previous pipeline is stopped by then, so no probe is running.
+ */
+static gboolean watchdog_add_probe(GstElement *element, GstPad *pad, gpointer user_data) {
+	struct watchdog *watchdog = user_data;
+	struct watchdog_sink *sink;
 
-@end
+	sink = g_new0(struct watchdog_sink, 1);
+	sink->watchdog = watchdog;
+	sink->lastPts = GST_CLOCK_TIME_NONE;
+
+	g_mutex_lock(&watchdog->lock);
+	g_ptr_array_add(watchdog->sinks, sink);
+	g_mutex_unlock(&watchdog->lock);
+
+	gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER, watchdog_probe_cb, sink, NULL);
+	return TRUE;
+}
+
+static void watchdog_probe_sink(const GValue *item, gpointer user_data) {
+	gst_element_foreach_sink_pad(g_value_get_object(item), watchdog_add_probe, user_data);
+}
+
+/* Called periodically from the GLib dispatch thread.
+ *
+ * The timeout holds a reference to the manager, which is released by
+ * release_manager once the timeout is removed in -stop.
+ */
+static gboolean watchdog_timeout_cb(gpointer user_data) {
+	@autoreleasepool {
+		// The reference is owned by the timeout
+		__unsafe_unretained VMPPipelineManager *mgr = (__bridge id) user_data;
+
+		[mgr _checkForStall];
+	}
+
+	return G_SOURCE_CONTINUE;
+}
 
 @implementation VMPPipelineManager {
   @protected
@@ -59,6 +288,26 @@ static gboolean gstreamer_bus_cb(GstBus *bus, GstMessage *message, void *mgr) {
   @private
 	NSString *_description;
 	NSInteger _numberOfStarts;
+	NSMutableDictionary *_statistics;
+	// Restart duration accumulators in milliseconds
+	double _restartDurationSum;
+	NSInteger _numberOfTimedRestarts;
+	NSInteger _numberOfRebuilds;
+	// Bus latency accumulators in microseconds
+	gint64 _busLatencySum;
+	gint64 _busLatencyMax;
+	guint64 _busMessageCount;
+	// Buffers reaching the sink, and stall detection
+	struct watchdog _watchdog;
+	guint _watchdogSourceId;
+	// Protected by @synchronized(self)
+	NSDictionary *_analysis;
+}
+
++ (void)initialize {
+	if (self == [VMPPipelineManager class]) {
+		postedAtQuark = g_quark_from_static_string("vmp-bus-posted-at");
+	}
 }
 
 + (instancetype)managerWithLaunchArgs:(NSString *)args
@@ -76,7 +325,16 @@ static gboolean gstreamer_bus_cb(GstBus *bus, GstMessage *message, void *mgr) {
 	NSAssert(channel, @"Channel cannot be nil");
 	NSAssert(delegate, @"Delegate cannot be nil");
 
-	initialStatistics = @{kVMPStatisticsNumberOfRestarts : @0};
+	initialStatistics = @{
+		kVMPStatisticsNumberOfRestarts : @0,
+		kVMPStatisticsLastRestartDuration : @0,
+		kVMPStatisticsAverageRestartDuration : @0,
+		kVMPStatisticsNumberOfRebuilds : @0,
+		kVMPStatisticsParseDuration : @0,
+		kVMPStatisticsStateChangeDuration : @0,
+		kVMPStatisticsBusLatencyAverage : @0,
+		kVMPStatisticsBusLatencyMax : @0
+	};
 
 	self = [super init];
 	if (self) {
@@ -86,7 +344,12 @@ static gboolean gstreamer_bus_cb(GstBus *bus, GstMessage *message, void *mgr) {
 		_state = kVMPStateCreated;
 		_pipeline = NULL;
 		_pipelineCreated = NO;
+		_restartStrategy = VMPPipelineRestartStrategyInPlace;
+		_stallTimeout = 0;
+		g_mutex_init(&_watchdog.lock);
+		_watchdog.sinks = g_ptr_array_new_with_free_func(g_free);
 		_statistics = [NSMutableDictionary dictionaryWithDictionary:initialStatistics];
+		_busActivity = [NSString stringWithFormat:@"Message on the bus of channel %@", _channel];
 		_description = [NSString stringWithFormat:@"<%@: %p> channel: %@, launch args: %@",
 												  NSStringFromClass([self class]), self, _channel,
 												  _launchArgs];
@@ -94,17 +357,226 @@ static gboolean gstreamer_bus_cb(GstBus *bus, GstMessage *message, void *mgr) {
 	return self;
 }
 
+- (NSDictionary *)statistics {
+	NSMutableDictionary *statistics;
+	gint64 sinceLastBuffer = 0;
+	gint64 lastBuffer;
+	double framesPerSecond;
+	gint64 now;
+
+	@synchronized(self) {
+		statistics = [_statistics mutableCopy];
+	}
+
+	now = g_get_monotonic_time();
+	g_mutex_lock(&_watchdog.lock);
+	watchdog_summary(&_watchdog, now, &framesPerSecond, &lastBuffer);
+	if (lastBuffer != 0) {
+		sinceLastBuffer = now - lastBuffer;
+	}
+
+	statistics[kVMPStatisticsFramesPerSecond] = @(framesPerSecond);
+	statistics[kVMPStatisticsDroppedFrames] = @(_watchdog.dropped);
+	statistics[kVMPStatisticsNumberOfStalls] = @(_watchdog.stalls);
+	statistics[kVMPStatisticsTimeSinceLastBuffer] = @((double) sinceLastBuffer / G_USEC_PER_SEC);
+	g_mutex_unlock(&_watchdog.lock);
+
+	return statistics;
+}
+
+- (void)setState:(NSString *)state {
+	_state = state;
+	[_metrics setPipelineState:state pipeline:_channel];
+}
+
+- (void)setMetrics:(VMPMetrics *)metrics {
+	NSInteger restarts;
+
+	_metrics = metrics;
+
+	@synchronized(self) {
+		restarts = [_statistics[kVMPStatisticsNumberOfRestarts] integerValue];
+	}
+	[_metrics setPipelineState:_state pipeline:_channel];
+	[_metrics setValue:restarts
+			 forMetric:@"vmp_pipeline_restarts_total"
+				labels:@{@"pipeline" : _channel}];
+	[self _publishWatchdogMetrics];
+}
+
+- (void)_countStart {
+	NSInteger restarts;
+
+	@synchronized(self) {
+		restarts = _numberOfStarts;
+		_statistics[kVMPStatisticsNumberOfRestarts] = [NSNumber numberWithInteger:restarts];
+		_numberOfStarts++;
+	}
+
+	[_metrics setValue:restarts
+			 forMetric:@"vmp_pipeline_restarts_total"
+				labels:@{@"pipeline" : _channel}];
+}
+
+- (void)_recordBusLatency:(gint64)latency {
+	@synchronized(self) {
+		_busMessageCount++;
+		_busLatencySum += latency;
+		if (latency > _busLatencyMax) {
+			_busLatencyMax = latency;
+		}
+
+		_statistics[kVMPStatisticsBusLatencyAverage] =
+			@(_busLatencySum / (gint64) _busMessageCount);
+		_statistics[kVMPStatisticsBusLatencyMax] = @(_busLatencyMax);
+	}
+}
+
+/* Monitor the sink pads of the appsink of the publisher, or of every sink in the
+ * pipeline. The order of the sinks in a bin is arbitrary, so one of several
+ * sinks cannot be picked.
+ */
+- (void)_installWatchdog {
+	GstIterator *iter;
+	GstElement *publisher;
+
+	if (!GST_IS_BIN(_pipeline)) {
+		return;
+	}
+
+	g_mutex_lock(&_watchdog.lock);
+	g_ptr_array_set_size(_watchdog.sinks, 0);
+	g_mutex_unlock(&_watchdog.lock);
+
+	// Transfer: Full
+	publisher = gst_bin_get_by_name(GST_BIN(_pipeline), "publisher");
+	if (publisher != NULL) {
+		gst_element_foreach_sink_pad(publisher, watchdog_add_probe, &_watchdog);
+		gst_object_unref(publisher);
+	} else {
+		// The pipeline is not playing yet, so the iteration is not resynced
+		iter = gst_bin_iterate_sinks(GST_BIN(_pipeline));
+		gst_iterator_foreach(iter, watchdog_probe_sink, &_watchdog);
+		gst_iterator_free(iter);
+	}
+
+	g_mutex_lock(&_watchdog.lock);
+	if (_watchdog.sinks->len == 0) {
+		VMPWarn(@"Pipeline for channel %@ has no sink to monitor", _channel);
+	}
+	g_mutex_unlock(&_watchdog.lock);
+
+	// The check also publishes the frame rate to the metrics. The timeout retains the manager.
+	if ((_stallTimeout > 0 || _metrics) && _watchdogSourceId == 0) {
+		_watchdogSourceId =
+			g_timeout_add_full(G_PRIORITY_DEFAULT, WATCHDOG_INTERVAL, watchdog_timeout_cb,
+							   (__bridge_retained void *) self, release_manager);
+	}
+}
+
+/* Called before the pipeline is (re)started. The watchdog stays disarmed until the
+ * pipeline is playing, and the time until the first buffer then counts as a stall.
+ */
+- (void)_resetWatchdog {
+	gint64 now = g_get_monotonic_time();
+
+	g_mutex_lock(&_watchdog.lock);
+	for (guint i = 0; i < _watchdog.sinks->len; i++) {
+		struct watchdog_sink *sink = g_ptr_array_index(_watchdog.sinks, i);
+
+		sink->lastBuffer = now;
+		sink->lastPts = GST_CLOCK_TIME_NONE;
+		sink->windowStart = now;
+		sink->windowFrames = 0;
+		sink->framesPerSecond = 0;
+	}
+	_watchdog.armed = NO;
+	g_mutex_unlock(&_watchdog.lock);
+}
+
+// Called once the state change to playing succeeded
+- (void)_armWatchdog {
+	gint64 now = g_get_monotonic_time();
+
+	g_mutex_lock(&_watchdog.lock);
+	for (guint i = 0; i < _watchdog.sinks->len; i++) {
+		struct watchdog_sink *sink = g_ptr_array_index(_watchdog.sinks, i);
+
+		sink->lastBuffer = now;
+	}
+	_watchdog.armed = YES;
+	g_mutex_unlock(&_watchdog.lock);
+}
+
+- (void)_checkForStall {
+	double framesPerSecond;
+	gint64 lastBuffer;
+	gint64 elapsed;
+	gint64 now;
+	BOOL stalled = NO;
+
+	now = g_get_monotonic_time();
+	g_mutex_lock(&_watchdog.lock);
+	// A stall of any sink counts
+	watchdog_summary(&_watchdog, now, &framesPerSecond, &lastBuffer);
+	elapsed = now - lastBuffer;
+	if (_stallTimeout > 0 && _watchdog.armed && lastBuffer != 0 &&
+		elapsed > (gint64) (_stallTimeout * G_USEC_PER_SEC)) {
+		_watchdog.armed = NO;
+		_watchdog.stalls++;
+		stalled = YES;
+	}
+	g_mutex_unlock(&_watchdog.lock);
+
+	if (stalled) {
+		VMPWarn(@"No buffer reached the sink of channel %@ for %.1f seconds", _channel,
+				(double) elapsed / G_USEC_PER_SEC);
+
+		if ([_delegate respondsToSelector:@selector(onStall:manager:)]) {
+			[_delegate onStall:(double) elapsed / G_USEC_PER_SEC manager:self];
+		}
+	}
+
+	[self _publishWatchdogMetrics];
+}
+
+- (void)_publishWatchdogMetrics {
+	NSDictionary *labels;
+	double framesPerSecond;
+	gint64 lastBuffer;
+	guint64 dropped;
+	guint64 stalls;
+
+	if (!_metrics) {
+		return;
+	}
+
+	g_mutex_lock(&_watchdog.lock);
+	watchdog_summary(&_watchdog, g_get_monotonic_time(), &framesPerSecond, &lastBuffer);
+	dropped = _watchdog.dropped;
+	stalls = _watchdog.stalls;
+	g_mutex_unlock(&_watchdog.lock);
+
+	labels = @{@"pipeline" : _channel};
+	[_metrics setValue:framesPerSecond forMetric:@"vmp_pipeline_frames_per_second" labels:labels];
+	[_metrics setValue:dropped forMetric:@"vmp_pipeline_dropped_frames_total" labels:labels];
+	[_metrics setValue:stalls forMetric:@"vmp_pipeline_stalls_total" labels:labels];
+}
+
 - (NSData *)pipelineDotGraph {
+	GstElement *pipeline;
 	NSData *data;
-	GstBin *bin;
-	gchar *dot;
+	gchar *dot = NULL;
 
-	if (_pipeline == NULL || !GST_IS_BIN(_pipeline)) {
+	pipeline = [self _referencePipeline];
+	if (pipeline == NULL) {
 		return nil;
 	}
 
-	bin = GST_BIN(_pipeline);
-	dot = gst_debug_bin_to_dot_data(bin, GST_DEBUG_GRAPH_SHOW_ALL);
+	if (GST_IS_BIN(pipeline)) {
+		dot = gst_debug_bin_to_dot_data(GST_BIN(pipeline), GST_DEBUG_GRAPH_SHOW_ALL);
+	}
+	gst_object_unref(pipeline);
 	if (dot == NULL) {
 		return nil;
 	}
@@ -115,6 +587,30 @@ static gboolean gstreamer_bus_cb(GstBus *bus, GstMessage *message, void *mgr) {
 	return data;
 }
 
+/* Transfer: Full. For reading the pipeline from other threads, as -stop releases
+ * it on the main thread. NULL if there is no pipeline.
+ */
+- (GstElement *)_referencePipeline {
+	@synchronized(self) {
+		return _pipeline != NULL ? gst_object_ref(_pipeline) : NULL;
+	}
+}
+
+- (VMPElementModel *)pipelineTopology {
+	VMPElementModel *model;
+	GstElement *pipeline;
+
+	pipeline = [self _referencePipeline];
+	if (pipeline == NULL) {
+		return nil;
+	}
+
+	model = [VMPElementModel modelWithGstElement:pipeline];
+	gst_object_unref(pipeline);
+
+	return model;
+}
+
 - (BOOL)start {
 	NSError *error = nil;
 
@@ -125,8 +621,7 @@ static gboolean gstreamer_bus_cb(GstBus *bus, GstMessage *message, void *mgr) {
 	}
 
 	// Update restart statistics
-	_statistics[kVMPStatisticsNumberOfRestarts] = [NSNumber numberWithInteger:_numberOfStarts];
-	_numberOfStarts++;
+	[self _countStart];
 
 	// Start pipeline immediately
 	if (![self _createPipelineWithError:&error]) {
@@ -134,6 +629,9 @@ static gboolean gstreamer_bus_cb(GstBus *bus, GstMessage *message, void *mgr) {
 			VMPError(@"%@", error);
 		}
 
+		// Remove the bus watch, and the watchdog of the partially started pipeline
+		[self stop];
+
 		if (error != nil && [error code] == VMPErrorCodeGStreamerParseError) {
 			[self setState:kVMPStateEOS];
 			[[self delegate] onStateChanged:kVMPStateEOS manager:self];
@@ -149,17 +647,26 @@ static gboolean gstreamer_bus_cb(GstBus *bus, GstMessage *message, void *mgr) {
  * Subsequent calls will return YES.
  */
 - (BOOL)_createPipelineWithError:(NSError **)error {
+	GstElement *pipeline;
 	GstBus *bus;
 	GstStateChangeReturn ret;
 	GError *gerror = NULL;
+	gint64 begin;
 
 	if (_pipelineCreated) {
 		return YES;
 	}
 	_pipelineCreated = YES;
 
-	// Transfer: Full. Deallocation (decreasing reference count) in dealloc:
-	_pipeline = gst_parse_launch([_launchArgs UTF8String], &gerror);
+	begin = g_get_monotonic_time();
+	// Transfer: Full. Deallocation (decreasing reference count) in stop, or dealloc:
+	pipeline = gst_parse_launch([_launchArgs UTF8String], &gerror);
+	@synchronized(self) {
+		_pipeline = pipeline;
+		_analysis = nil;
+		_statistics[kVMPStatisticsParseDuration] =
+			@((double) (g_get_monotonic_time() - begin) / 1000.0);
+	}
 	if (_pipeline == NULL) {
 		VMPError(@"gst_parse_launch returned NULL while parsing launch args: %@", _launchArgs);
 
@@ -183,13 +690,27 @@ static gboolean gstreamer_bus_cb(GstBus *bus, GstMessage *message, void *mgr) {
 	// Transfer: Full
 	bus = gst_element_get_bus(_pipeline);
 	if (bus != NULL) {
-		// Bridge object pointer without touching reference count
-		gst_bus_add_watch(bus, (GstBusFunc) gstreamer_bus_cb, (__bridge void *) self);
+		// Timestamp messages in the posting thread for latency statistics
+		gst_bus_set_sync_handler(bus, gstreamer_bus_sync_cb, NULL, NULL);
+		// The watch retains the manager until it is removed
+		gst_bus_add_watch_full(bus, G_PRIORITY_DEFAULT, (GstBusFunc) gstreamer_bus_cb,
+							   (__bridge_retained void *) self, release_manager);
 		gst_object_unref(bus);
 	}
 
+	[self _connectStreams];
+	[_tracer tracePipeline:_pipeline channel:_channel];
+	[_queueMonitor monitorPipeline:_pipeline channel:_channel];
+	[self _installWatchdog];
+	[self _resetWatchdog];
+
 	// Set pipeline state to playing
+	begin = g_get_monotonic_time();
 	ret = gst_element_set_state(_pipeline, GST_STATE_PLAYING);
+	@synchronized(self) {
+		_statistics[kVMPStatisticsStateChangeDuration] =
+			@((double) (g_get_monotonic_time() - begin) / 1000.0);
+	}
 	if (ret == GST_STATE_CHANGE_FAILURE) {
 		NSString *msg;
 
@@ -205,6 +726,7 @@ static gboolean gstreamer_bus_cb(GstBus *bus, GstMessage *message, void *mgr) {
 		}
 		return NO;
 	}
+	[self _armWatchdog];
 
 	return YES;
 }
@@ -228,10 +750,172 @@ static gboolean gstreamer_bus_cb(GstBus *bus, GstMessage *message, void *mgr) {
 		}
 		return NO;
 	}
+	[self _armWatchdog];
 
 	return YES;
 }
 
+- (BOOL)_restartPipelineInPlaceWithError:(NSError **)error {
+	GstStateChangeReturn ret;
+
+	if ([self pipeline] == NULL) {
+		VMP_FAST_ERROR(error, VMPErrorCodeGStreamerStateChangeError,
+					   @"No pipeline to restart for channel '%@'", _channel);
+		return NO;
+	}
+
+	/* Going through READY to NULL closes all devices, and resets elements that
+	 * received EOS. The pipeline flushes its bus when reaching NULL, so stale
+	 * messages from the previous run are not delivered after the restart.
+	 *
+	 * The running time starts from zero again, so streams are reconnected.
+	 */
+	[self _disconnectStreams];
+	ret = gst_element_set_state([self pipeline], GST_STATE_NULL);
+	if (ret == GST_STATE_CHANGE_FAILURE) {
+		VMP_FAST_ERROR(error, VMPErrorCodeGStreamerStateChangeError,
+					   @"Failed to change pipeline state to null for channel '%@'", _channel);
+		return NO;
+	}
+	[self _connectStreams];
+	@synchronized(self) {
+		_analysis = nil;
+	}
+	[self _resetWatchdog];
+
+	return [self _resumePipelineWithError:error];
+}
+
+- (NSDictionary *)analysis {
+	@synchronized(self) {
+		return _analysis;
+	}
+}
+
+/* Called from the GLib dispatch thread with the source of the state change.
+ *
+ * The pipeline may be replaced on the main thread meanwhile. The analysis is
+ * only published if the pipeline is still the current one.
+ */
+- (void)_analyzePipeline:(GstElement *)pipeline {
+	NSDictionary *analysis;
+
+	@synchronized(self) {
+		if (_pipeline != pipeline || _analysis != nil) {
+			return;
+		}
+	}
+
+	analysis = [VMPPipelineAnalyzer analyzePipeline:pipeline];
+
+	@synchronized(self) {
+		if (_pipeline != pipeline) {
+			return;
+		}
+		_analysis = analysis;
+	}
+	[VMPPipelineAnalyzer logAnalysis:analysis pipelineName:_channel];
+}
+
+- (void)_connectStreams {
+	GstElement *element;
+	GstBin *bin;
+
+	if (!GST_IS_BIN(_pipeline)) {
+		return;
+	}
+	bin = GST_BIN(_pipeline);
+
+	if (_publisher) {
+		// Transfer: Full
+		element = gst_bin_get_by_name(bin, "publisher");
+		if (element != NULL) {
+			[_publisher attachToSink:element];
+			gst_object_unref(element);
+		} else {
+			VMPWarn(@"Pipeline for channel %@ has a publisher, but no appsink named 'publisher'",
+					_channel);
+		}
+	}
+
+	for (NSString *name in _subscriptions) {
+		element = gst_bin_get_by_name(bin, [name UTF8String]);
+		if (element != NULL) {
+			[_subscriptions[name] addSubscriber:element];
+			gst_object_unref(element);
+		} else {
+			VMPWarn(@"Pipeline for channel %@ has no appsrc named '%@'", _channel, name);
+		}
+	}
+}
+
+- (void)_disconnectStreams {
+	GstElement *element;
+	GstBin *bin;
+
+	if (!GST_IS_BIN(_pipeline)) {
+		return;
+	}
+	bin = GST_BIN(_pipeline);
+
+	[_publisher detach];
+
+	for (NSString *name in _subscriptions) {
+		element = gst_bin_get_by_name(bin, [name UTF8String]);
+		if (element != NULL) {
+			[_subscriptions[name] removeSubscriber:element];
+			gst_object_unref(element);
+		}
+	}
+}
+
+- (BOOL)restart {
+	NSError *error = nil;
+	gint64 begin;
+	double duration;
+	BOOL status = NO;
+	BOOL rebuilt = NO;
+
+	begin = g_get_monotonic_time();
+
+	if (_restartStrategy == VMPPipelineRestartStrategyInPlace && [self pipeline] != NULL) {
+		status = [self _restartPipelineInPlaceWithError:&error];
+		if (status) {
+			[self _countStart];
+			[self setState:kVMPStatePlaying];
+		} else {
+			VMPWarn(@"In-place restart of channel %@ failed: %@. Rebuilding pipeline...", _channel,
+					[error localizedDescription]);
+		}
+	}
+
+	if (!status) {
+		rebuilt = YES;
+		[self stop];
+		status = [self start];
+	}
+
+	duration = (double) (g_get_monotonic_time() - begin) / 1000.0;
+
+	@synchronized(self) {
+		_numberOfTimedRestarts++;
+		_restartDurationSum += duration;
+		if (rebuilt) {
+			_numberOfRebuilds++;
+		}
+
+		_statistics[kVMPStatisticsLastRestartDuration] = @(duration);
+		_statistics[kVMPStatisticsAverageRestartDuration] =
+			@(_restartDurationSum / (double) _numberOfTimedRestarts);
+		_statistics[kVMPStatisticsNumberOfRebuilds] = @(_numberOfRebuilds);
+	}
+
+	VMPInfo(@"Restart of channel %@ took %.2f ms (%@)", _channel, duration,
+			rebuilt ? @"rebuilt" : @"in-place");
+
+	return status;
+}
+
 - (void)sendEOSEvent {
 	if ([self pipeline] == NULL) {
 		return;
@@ -243,14 +927,48 @@ static gboolean gstreamer_bus_cb(GstBus *bus, GstMessage *message, void *mgr) {
 
 - (void)stop {
 	if ([self pipeline] != NULL) {
+		GstElement *pipeline;
+		GstBus *bus;
+
 		gst_element_set_state([self pipeline], GST_STATE_NULL);
-		gst_object_unref(_pipeline);
+		[self _disconnectStreams];
+
+		/* Remove the bus watch, as the GSource holds a reference to the bus, and to
+		 * the manager. A callback that is already running on the GLib dispatch
+		 * thread keeps the manager alive until it returns.
+		 */
+		bus = gst_element_get_bus(_pipeline);
+		if (bus != NULL) {
+			gst_bus_remove_watch(bus);
+			gst_object_unref(bus);
+		}
 
-		_pipeline = NULL;
-		_pipelineCreated = NO;
+		// Readers on other threads hold their own reference
+		@synchronized(self) {
+			pipeline = _pipeline;
+			_pipeline = NULL;
+		}
+		gst_object_unref(pipeline);
 
 		[self setState:kVMPStateCreated];
 	}
+
+	// Releases the reference of the timeout once a running check returns
+	if (_watchdogSourceId != 0) {
+		g_source_remove(_watchdogSourceId);
+		_watchdogSourceId = 0;
+	}
+	g_mutex_lock(&_watchdog.lock);
+	_watchdog.armed = NO;
+	g_mutex_unlock(&_watchdog.lock);
+
+	// The stall check no longer updates the frame rate
+	[_metrics setValue:0
+			 forMetric:@"vmp_pipeline_frames_per_second"
+				labels:@{@"pipeline" : _channel}];
+
+	// Reset even if parsing failed and no pipeline was created
+	_pipelineCreated = NO;
 }
 
 - (NSString *)description {
@@ -263,6 +981,9 @@ static gboolean gstreamer_bus_cb(GstBus *bus, GstMessage *message, void *mgr) {
 	if (_pipeline != NULL) {
 		gst_object_unref(_pipeline);
 	}
+	// The timeout retains the manager, so it was removed by -stop
+	g_ptr_array_unref(_watchdog.sinks);
+	g_mutex_clear(&_watchdog.lock);
 	VMPDebug(@"Deallocating pipeline manager for channel %@", _channel);
 }
 
@@ -0,0 +1,102 @@
+/* vmpserverd - A virtual multimedia processor
+ * Copyright (C) 2024 Hugo Melder
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#import <Foundation/Foundation.h>
+#import <gst/gst.h>
+
+#import "VMPMetrics.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * @brief Periodic sampling of the fill level of queues in pipelines
+ *
+ * Every queue, and queue2 element in a monitored pipeline is sampled at a fixed
+ * interval on the GLib main context. The current level in buffers, bytes, and
+ * time, and the fill ratio (the highest level relative to the configured maximum
+ * of the queue) are kept for the last 60 samples.
+ *
+ * A warning is logged when the fill ratio of a queue stays above 90% for longer
+ * than the saturation timeout. This is usually a sign that the element after
+ * the queue, e.g. an encoder, cannot keep up.
+ *
+ * All methods are MT-Safe.
+ */
+@interface VMPQueueMonitor : NSObject
+
+/**
+ * @brief Create a queue monitor
+ *
+ * @param interval Seconds between two samples
+ * @param timeout Seconds a queue must be saturated before a warning is logged
+ */
+- (instancetype)initWithInterval:(NSTimeInterval)interval saturationTimeout:(NSTimeInterval)timeout;
+
+/**
+ * @brief Monitor the queues in the pipeline of a channel
+ *
+ * The top-level pipeline of the given element is monitored until it is
+ * finalised. Samples of a previously monitored pipeline of the channel are
+ * discarded.
+ */
+- (void)monitorPipeline:(GstElement *)element channel:(NSString *)channel;
+
+/**
+ * @brief Monitor the queues in the pipeline of an RTSP media
+ *
+ * @see monitorPipeline:channel:
+ */
+- (void)monitorPipeline:(GstElement *)element mountpointName:(NSString *)name;
+
+/**
+ * @brief Metrics registry for the fill ratio of the queues
+ *
+ * If set, vmp_queue_fill_ratio is updated with every sample.
+ *
+ * @see VMPMetrics
+ */
+@property (strong, nullable) VMPMetrics *metrics;
+
+/**
+ * @brief Fill levels of all monitored queues
+ *
+ * Example structure:
+ * @code
+ * {
+ *     "channels": {
+ *         "present0": {
+ *             "queue0": {
+ *                 "buffers": {"min": 0, "avg": 1.4, "max": 5},
+ *                 "bytes": {"min": 0, "avg": 4354560, "max": 15552000},
+ *                 "time": {"min": 0, "avg": 46.6, "max": 166.7}, // Milliseconds
+ *                 "fill": {"min": 0, "avg": 0.02, "max": 0.08}, // Ratio of the maximum
+ *                 "limits": {"buffers": 200, "bytes": 10485760, "time": 1000},
+ *                 "saturated": false // Fill ratio above 90% for the saturation timeout
+ *             }
+ *         }
+ *     },
+ *     "mountpoints": {
+ *         "Combined": { ... }
+ *     }
+ * }
+ * @endcode
+ *
+ * Queues are identified by their path in the pipeline, without the name of the
+ * pipeline. A limit of 0 is disabled.
+ */
+@property (readonly) NSDictionary *statistics;
+
+/**
+ * @brief Stop sampling
+ *
+ * The sampling timeout retains the monitor, so the monitor must be
+ * invalidated before it can be deallocated.
+ */
+- (void)invalidate;
+
+@end
+
+NS_ASSUME_NONNULL_END
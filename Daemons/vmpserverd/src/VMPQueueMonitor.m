@@ -0,0 +1,382 @@
+/* vmpserverd - A virtual multimedia processor
+ * Copyright (C) 2024 Hugo Melder
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#import <glib.h>
+#import <string.h>
+
+#import "VMPJournal.h"
+#import "VMPLoopWatchdog.h"
+#import "VMPQueueMonitor.h"
+
+// Number of samples kept per queue
+#define QUEUE_WINDOW 60
+// Fill ratio above which a queue is saturated
+#define SATURATION_THRESHOLD 0.9
+
+struct queue_sample {
+	guint buffers;
+	guint bytes;
+	guint64 time;
+	double fill;
+};
+
+#pragma mark - Queue
+
+// Samples of a single queue. Only accessed while holding the lock of the monitor.
+@interface _VMPMonitoredQueue : NSObject
+@property (nonatomic) guint maxBuffers;
+@property (nonatomic) guint maxBytes;
+@property (nonatomic) guint64 maxTime;
+// Monotonic time since when the queue is saturated, or 0
+@property (nonatomic) gint64 saturatedSince;
+// Whether a warning was logged for the current saturation
+@property (nonatomic) BOOL warned;
+
+- (void)addSample:(struct queue_sample)sample;
+- (NSDictionary *)statistics;
+@end
+
+@implementation _VMPMonitoredQueue {
+	struct queue_sample _samples[QUEUE_WINDOW];
+	NSUInteger _count;
+}
+
+- (void)addSample:(struct queue_sample)sample {
+	_samples[_count % QUEUE_WINDOW] = sample;
+	_count++;
+}
+
+- (NSDictionary *)statistics {
+	struct queue_sample min = {G_MAXUINT, G_MAXUINT, G_MAXUINT64, G_MAXDOUBLE};
+	struct queue_sample max = {0};
+	double buffers = 0, bytes = 0, time = 0, fill = 0;
+	NSUInteger n = MIN(_count, QUEUE_WINDOW);
+
+	if (n == 0) {
+		return @{};
+	}
+
+	for (NSUInteger i = 0; i < n; i++) {
+		struct queue_sample *cur = &_samples[i];
+
+		min.buffers = MIN(min.buffers, cur->buffers);
+		min.bytes = MIN(min.bytes, cur->bytes);
+		min.time = MIN(min.time, cur->time);
+		min.fill = MIN(min.fill, cur->fill);
+		max.buffers = MAX(max.buffers, cur->buffers);
+		max.bytes = MAX(max.bytes, cur->bytes);
+		max.time = MAX(max.time, cur->time);
+		max.fill = MAX(max.fill, cur->fill);
+		buffers += cur->buffers;
+		bytes += cur->bytes;
+		time += cur->time;
+		fill += cur->fill;
+	}
+
+	return @{
+		@"buffers" : @{@"min" : @(min.buffers), @"avg" : @(buffers / n), @"max" : @(max.buffers)},
+		@"bytes" : @{@"min" : @(min.bytes), @"avg" : @(bytes / n), @"max" : @(max.bytes)},
+		@"time" : @{
+			@"min" : @((double) min.time / GST_MSECOND),
+			@"avg" : @(time / n / GST_MSECOND),
+			@"max" : @((double) max.time / GST_MSECOND)
+		},
+		@"fill" : @{@"min" : @(min.fill), @"avg" : @(fill / n), @"max" : @(max.fill)},
+		@"limits" : @{
+			@"buffers" : @(_maxBuffers),
+			@"bytes" : @(_maxBytes),
+			@"time" : @((double) _maxTime / GST_MSECOND)
+		},
+		@"saturated" : @(_saturatedSince != 0),
+	};
+}
+@end
+
+#pragma mark - Pipeline
+
+// A monitored pipeline, and its queues by name
+@interface _VMPMonitoredPipeline : NSObject
+@property (nonatomic, readonly) NSString *name;
+@property (nonatomic, readonly) NSMutableDictionary<NSString *, _VMPMonitoredQueue *> *queues;
+
+- (instancetype)initWithPipeline:(GstElement *)pipeline name:(NSString *)name;
+// Transfer: Full. NULL if the pipeline was finalised.
+- (GstElement *)pipeline;
+@end
+
+@implementation _VMPMonitoredPipeline {
+	GWeakRef _pipeline;
+}
+
+- (instancetype)initWithPipeline:(GstElement *)pipeline name:(NSString *)name {
+	self = [super init];
+	if (self) {
+		g_weak_ref_init(&_pipeline, pipeline);
+		_name = name;
+		_queues = [NSMutableDictionary dictionary];
+	}
+	return self;
+}
+
+- (GstElement *)pipeline {
+	return g_weak_ref_get(&_pipeline);
+}
+
+- (void)dealloc {
+	g_weak_ref_clear(&_pipeline);
+}
+@end
+
+#pragma mark - Monitor
+
+// Path of the element in its pipeline, e.g. "bin0/queue0"
+static NSString *queue_name(GstElement *element) {
+	NSString *name;
+	gchar *path;
+	gchar *start;
+
+	path = gst_object_get_path_string(GST_OBJECT(element));
+	start = strchr(path + 1, '/');
+	name = [NSString stringWithUTF8String:start ? start + 1 : path];
+	g_free(path);
+
+	return name;
+}
+
+static gboolean is_queue(GstElement *element) {
+	return g_str_has_prefix(G_OBJECT_TYPE_NAME(element), "GstQueue");
+}
+
+@interface VMPQueueMonitor ()
+- (void)_sample;
+@end
+
+/* Balance the reference of the monitor taken when adding the timeout.
+ *
+ * Called when the source is destroyed, so a sample that is still running on the
+ * GLib dispatch thread when the monitor is invalidated keeps the monitor alive.
+ */
+static void release_monitor(gpointer data) {
+	(void) (__bridge_transfer id) data;
+}
+
+/* Called periodically from the GLib dispatch thread.
+ *
+ * The timeout holds a reference to the monitor, which is released by
+ * release_monitor once the timeout is removed in -invalidate.
+ */
+static gboolean sample_timeout_cb(gpointer user_data) {
+	@autoreleasepool {
+		// The reference is owned by the timeout
+		__unsafe_unretained VMPQueueMonitor *monitor = (__bridge id) user_data;
+
+		[VMPLoopWatchdog beginActivity:@"Sampling of queues" onLoop:VMPLoopGLib];
+		[monitor _sample];
+		[VMPLoopWatchdog endActivityOnLoop:VMPLoopGLib];
+	}
+
+	return G_SOURCE_CONTINUE;
+}
+
+@implementation VMPQueueMonitor {
+	NSTimeInterval _saturationTimeout;
+	guint _sourceId;
+	NSMutableDictionary<NSString *, _VMPMonitoredPipeline *> *_channels;
+	NSMutableDictionary<NSString *, _VMPMonitoredPipeline *> *_mountpoints;
+}
+
+- (instancetype)initWithInterval:(NSTimeInterval)interval
+			   saturationTimeout:(NSTimeInterval)timeout {
+	self = [super init];
+	if (self) {
+		_saturationTimeout = timeout;
+		_channels = [NSMutableDictionary dictionary];
+		_mountpoints = [NSMutableDictionary dictionary];
+		_sourceId = g_timeout_add_full(G_PRIORITY_DEFAULT, (guint) (interval * 1000),
+									   sample_timeout_cb, (__bridge_retained void *) self,
+									   release_monitor);
+	}
+	return self;
+}
+
+- (_VMPMonitoredPipeline *)_monitoredPipelineForElement:(GstElement *)element
+												   name:(NSString *)name {
+	_VMPMonitoredPipeline *monitored;
+	GstObject *pipeline;
+	GstObject *parent;
+
+	pipeline = gst_object_ref(GST_OBJECT(element));
+	while ((parent = gst_object_get_parent(pipeline)) != NULL) {
+		gst_object_unref(pipeline);
+		pipeline = parent;
+	}
+
+	monitored = [[_VMPMonitoredPipeline alloc] initWithPipeline:GST_ELEMENT(pipeline) name:name];
+	gst_object_unref(pipeline);
+
+	return monitored;
+}
+
+- (void)monitorPipeline:(GstElement *)element channel:(NSString *)channel {
+	_VMPMonitoredPipeline *monitored = [self _monitoredPipelineForElement:element name:channel];
+
+	@synchronized(self) {
+		_channels[channel] = monitored;
+	}
+}
+
+- (void)monitorPipeline:(GstElement *)element mountpointName:(NSString *)name {
+	_VMPMonitoredPipeline *monitored = [self _monitoredPipelineForElement:element name:name];
+
+	@synchronized(self) {
+		_mountpoints[name] = monitored;
+	}
+}
+
+- (void)_sampleQueue:(GstElement *)element pipeline:(_VMPMonitoredPipeline *)monitored {
+	struct queue_sample sample = {0};
+	_VMPMonitoredQueue *queue;
+	guint maxBuffers, maxBytes;
+	guint64 maxTime;
+	NSString *name;
+	gint64 now;
+
+	g_object_get(element, "current-level-buffers", &sample.buffers, "current-level-bytes",
+				 &sample.bytes, "current-level-time", &sample.time, "max-size-buffers",
+				 &maxBuffers, "max-size-bytes", &maxBytes, "max-size-time", &maxTime, NULL);
+
+	// The queue is full as soon as one of the limits is reached
+	if (maxBuffers > 0) {
+		sample.fill = MAX(sample.fill, (double) sample.buffers / maxBuffers);
+	}
+	if (maxBytes > 0) {
+		sample.fill = MAX(sample.fill, (double) sample.bytes / maxBytes);
+	}
+	if (maxTime > 0) {
+		sample.fill = MAX(sample.fill, (double) sample.time / maxTime);
+	}
+
+	name = queue_name(element);
+	queue = [monitored queues][name];
+	if (!queue) {
+		queue = [_VMPMonitoredQueue new];
+		[monitored queues][name] = queue;
+	}
+	[queue setMaxBuffers:maxBuffers];
+	[queue setMaxBytes:maxBytes];
+	[queue setMaxTime:maxTime];
+	[queue addSample:sample];
+	[[self metrics] setValue:sample.fill
+				   forMetric:@"vmp_queue_fill_ratio"
+					  labels:@{@"pipeline" : [monitored name], @"queue" : name}];
+
+	now = g_get_monotonic_time();
+	if (sample.fill < SATURATION_THRESHOLD) {
+		if ([queue warned]) {
+			VMPInfo(@"Queue %@ in pipeline %@ is no longer saturated", name, [monitored name]);
+		}
+		[queue setSaturatedSince:0];
+		[queue setWarned:NO];
+	} else if ([queue saturatedSince] == 0) {
+		[queue setSaturatedSince:now];
+	} else if (![queue warned] &&
+			   now - [queue saturatedSince] >= (gint64) (_saturationTimeout * G_USEC_PER_SEC)) {
+		VMPWarn(@"Queue %@ in pipeline %@ is saturated for %.0f seconds (%u buffers, %u "
+				@"bytes, %.1f ms). The elements after the queue cannot keep up.",
+				name, [monitored name], (double) (now - [queue saturatedSince]) / G_USEC_PER_SEC,
+				sample.buffers, sample.bytes, (double) sample.time / GST_MSECOND);
+		[queue setWarned:YES];
+	}
+}
+
+- (void)_samplePipeline:(_VMPMonitoredPipeline *)monitored {
+	GValue item = G_VALUE_INIT;
+	GstIterator *iter;
+	GstElement *pipeline;
+	gboolean done = FALSE;
+
+	// Transfer: Full
+	pipeline = [monitored pipeline];
+	if (pipeline == NULL) {
+		return;
+	}
+	if (!GST_IS_BIN(pipeline)) {
+		gst_object_unref(pipeline);
+		return;
+	}
+
+	iter = gst_bin_iterate_recurse(GST_BIN(pipeline));
+	while (!done) {
+		switch (gst_iterator_next(iter, &item)) {
+		case GST_ITERATOR_OK: {
+			GstElement *element = g_value_get_object(&item);
+
+			if (is_queue(element)) {
+				[self _sampleQueue:element pipeline:monitored];
+			}
+			g_value_reset(&item);
+			break;
+		}
+		case GST_ITERATOR_RESYNC:
+			gst_iterator_resync(iter);
+			break;
+		default:
+			done = TRUE;
+			break;
+		}
+	}
+	g_value_unset(&item);
+	gst_iterator_free(iter);
+	gst_object_unref(pipeline);
+}
+
+- (void)_sample {
+	@synchronized(self) {
+		for (NSString *name in _channels) {
+			[self _samplePipeline:_channels[name]];
+		}
+		for (NSString *name in _mountpoints) {
+			[self _samplePipeline:_mountpoints[name]];
+		}
+	}
+}
+
+- (NSDictionary *)_statisticsForPipelines:(NSDictionary *)pipelines {
+	NSMutableDictionary *result;
+
+	result = [NSMutableDictionary dictionaryWithCapacity:[pipelines count]];
+	for (NSString *name in pipelines) {
+		NSDictionary<NSString *, _VMPMonitoredQueue *> *queues = [pipelines[name] queues];
+		NSMutableDictionary *perQueue = [NSMutableDictionary dictionaryWithCapacity:[queues count]];
+
+		for (NSString *queue in queues) {
+			perQueue[queue] = [queues[queue] statistics];
+		}
+		result[name] = perQueue;
+	}
+
+	return result;
+}
+
+- (NSDictionary *)statistics {
+	@synchronized(self) {
+		return @{
+			@"channels" : [self _statisticsForPipelines:_channels],
+			@"mountpoints" : [self _statisticsForPipelines:_mountpoints],
+		};
+	}
+}
+
+- (void)invalidate {
+	@synchronized(self) {
+		if (_sourceId != 0) {
+			g_source_remove(_sourceId);
+			_sourceId = 0;
+		}
+	}
+}
+
+@end
@@ -37,6 +37,27 @@ NS_ASSUME_NONNULL_BEGIN
  */
 @property (nonatomic, readonly) VMPProfileModel *currentProfile;
 
+/**
+ * @brief Tracer of channel, and mountpoint pipelines
+ *
+ * nil unless tracing is enabled in the configuration.
+ */
+@property (nonatomic, readonly, nullable) VMPTracer *tracer;
+
+/**
+ * @brief Fill level monitor of the queues in channel, and mountpoint pipelines
+ *
+ * nil if queue sampling is disabled in the configuration.
+ */
+@property (nonatomic, readonly, nullable) VMPQueueMonitor *queueMonitor;
+
+/**
+ * @brief Metrics of channel, encoder, and HLS pipelines, recordings, and RTSP clients
+ *
+ * The samples are updated when the pipelines, or RTSP sessions change.
+ */
+@property (nonatomic, readonly) VMPMetrics *metrics;
+
 /**
  * @brief Provides global statistics for all managed pipelines and the RTSP server.
  *
@@ -50,10 +71,87 @@ NS_ASSUME_NONNULL_BEGIN
  *             "name": "pipeline0", // The unique name of the pipeline
  *             "type": "v4l2", // The type of pipeline, e.g., 'v4l2' for video4linux2
  *             "state": "playing", // Current state of the pipeline, e.g., 'playing', 'paused'
- *             "numberOfRestarts": 2 // The number of times the pipeline has been restarted
+ *             "numberOfRestarts": 2, // The number of times the pipeline has been restarted
+ *             "consumers": 1, // Number of RTSP media, and recordings using an on-demand channel
+ *             "busLatencyAverage": 85, // Average bus dispatch latency in microseconds
+ *             "busLatencyMax": 412, // Maximum bus dispatch latency in microseconds
+ *             "framesPerSecond": 29.97, // Buffers per second reaching the sink
+ *             "droppedFrames": 12, // Frames missing between the timestamps of buffers
+ *             "numberOfStalls": 0, // Number of times the channel stopped producing buffers
+ *             "timeSinceLastBuffer": 0.03, // Seconds since the last buffer reached the sink
+ *             "channelBus": { // Only present with the native channel bus, or shared audio
+ *                 "subscribers": 1,
+ *                 "buffersPublished": 1500,
+ *                 "buffersDropped": 3,
+ *                 "subscriberStatistics": [
+ *                     {
+ *                         "name": "/GstPipeline:pipeline3/GstAppSrc:channel0",
+ *                         "buffersPushed": 1497,
+ *                         "buffersDropped": 3,
+ *                         "queued": 1
+ *                     }
+ *                 ]
+ *             }
  *         }
  *         // Additional pipeline dictionaries...
- *     ]
+ *     ],
+ *     "shared_encoders": {
+ *         "encoders": [
+ *             {
+ *                 "name": "_encoder_present0_1920x1080_2500", // Channel, resolution, bitrate
+ *                 "channel": "present0", // The encoded video channel
+ *                 "state": "playing",
+ *                 "consumers": 2, // Mountpoint media, and recordings using the encoder
+ *                 "subscribers": 2, // Pipelines receiving the encoded stream
+ *                 "buffersPublished": 1500,
+ *                 "buffersDropped": 0
+ *             }
+ *         ],
+ *         "encodersPerChannel": {
+ *             "present0": 1 // Number of running encoders for the channel
+ *         }
+ *     },
+ *     "hls": [ // HLS egress pipelines, empty if HLS is disabled
+ *         {
+ *             "name": "_hls_Combined",
+ *             "state": "playing",
+ *             "playlist": "/hls/comb/index.m3u8", // Served by the HTTP server
+ *             "numberOfRestarts": 0
+ *         }
+ *     ],
+ *     "rtsp": {
+ *         "sessions": 3, // Current number of RTSP sessions
+ *         "clients": { // Sessions per mountpoint
+ *             "Combined": 2,
+ *             "Presentation": 1
+ *         },
+ *         "maxSessions": 0, // Configured limits, 0 for unlimited
+ *         "maxClientsPerMountpoint": 0,
+ *         "threadPoolSize": 4,
+ *         "sessionTimeout": 60,
+ *         "rejectedSetupRequests": 0 // SETUP requests rejected due to client limits
+ *     },
+ *     "bus_messages": { // Errors, and warnings posted on the bus of a pipeline by element
+ *         "present0": {
+ *             "errors": {
+ *                 "v4l2src0": 1
+ *             },
+ *             "warnings": {
+ *                 "queue0": 4
+ *             }
+ *         }
+ *     },
+ *     "queues": { // Only present if queue sampling is enabled (@see VMPQueueMonitor)
+ *         "channels": {
+ *             "present0": {
+ *                 "queue0": {
+ *                     "fill": {"min": 0, "avg": 0.02, "max": 0.08},
+ *                     ...
+ *                 }
+ *             }
+ *         },
+ *         "mountpoints": {}
+ *     }
  * }
  * @endcode
  *
@@ -64,6 +162,30 @@ NS_ASSUME_NONNULL_BEGIN
  */
 @property (nonatomic, readonly) NSDictionary *globalStatistics;
 
+/**
+ * @brief Timing breakdown of the channel pipeline startup
+ *
+ * Durations are in milliseconds. Channel pipelines are started
+ * concurrently, so the total is not the sum of the channel timings.
+ *
+ * Example structure of the returned dictionary:
+ * @code
+ * {
+ *     "channels": {
+ *         "present0": {
+ *             "substitution": 0.12, // Pipeline template substitution
+ *             "parse": 14.3, // gst_parse_launch
+ *             "stateChange": 102.5 // State change to PLAYING
+ *         }
+ *     },
+ *     "total": 105.1
+ * }
+ * @endcode
+ *
+ * nil until startWithError: was called.
+ */
+@property (nonatomic, readonly, nullable) NSDictionary *startupTimings;
+
 /**
  * @brief RTSP server convenience initialiser
  *
@@ -103,15 +225,74 @@ NS_ASSUME_NONNULL_BEGIN
  * not by pipeline managers (@see VMPPipelineManager), information may
  * be unavailable or outdated under certain circumstances.
  *
- * Information is extracted in a construction callback, and thus only available
- * if at least one client is connected to the mountpoint. The last pipeline
- * graph is cached.
+ * The graph is generated on request from the media of the last connected
+ * client, and cached until the state of the media changes. After the last
+ * client disconnected, the last generated graph is returned.
  *
  * @returns an ASCII-encoded dot graph, or nil if no mountpoint could be found,
  * or an error occurred during generation.
  */
 - (nullable NSData *)dotGraphForMountPointName:(NSString *)name;
 
+/**
+ * @brief Elements, pads, negotiated caps, and links of the media of a mountpoint
+ *
+ * The media is only alive while at least one client is connected to the
+ * mountpoint. Unlike the dot graph, the topology is not cached, and
+ * reflects the current state of the media.
+ *
+ * @returns the model of the media element, or nil if the mountpoint was not
+ * found, or no media is alive.
+ */
+- (nullable VMPElementModel *)topologyForMountpointName:(NSString *)name;
+
+/**
+ * @brief Expensive conversions in the last prepared media of a mountpoint
+ *
+ * The media is analyzed once it was prepared for the first client.
+ *
+ * @see VMPPipelineAnalyzer
+ *
+ * @returns the analysis, or nil if the mountpoint was not found, or no media
+ * was prepared yet.
+ */
+- (nullable NSDictionary *)analysisForMountpointName:(NSString *)name;
+
+/**
+ * @brief Statistics of the RTSP sessions of all clients
+ *
+ * Example structure of an element in the returned array:
+ * @code
+ * {
+ *     "session": "gC5HQ3lGYt1Ud5pb", // RTSP session identifier
+ *     "mountpoint": "Combined",
+ *     "address": "10.0.0.5", // Address of the client
+ *     "age": 312.4, // Seconds since the session was created
+ *     "timeout": 60, // Session timeout in seconds
+ *     "streams": [
+ *         {
+ *             "index": 0, // Index of the stream in the media (e.g. 0 for video)
+ *             "transport": "udp", // "udp", "udp-multicast", or "tcp" (interleaved)
+ *             "bytesSent": 98324112, // Unicast UDP only
+ *             "packetsSent": 71342, // Unicast UDP only
+ *             "jitter": 1.2, // Interarrival jitter in milliseconds reported via RTCP
+ *             "packetsLost": 12, // Cumulative number of lost packets reported via RTCP
+ *             "fractionLost": 0.0 // Fraction of packets lost since the last report
+ *         }
+ *     ]
+ * }
+ * @endcode
+ *
+ * RTCP statistics are only present after the client sent a receiver report, and
+ * are attributed to clients by the address of the report. They are thus not
+ * available for clients using TCP interleaved transport.
+ *
+ * @param name Name of a mountpoint, or nil for all mountpoints
+ *
+ * @returns an array of session statistics, or nil if the mountpoint does not exist
+ */
+- (nullable NSArray<NSDictionary *> *)clientStatisticsForMountpointName:(nullable NSString *)name;
+
 /**
  * @brief Information about all active channels
  *
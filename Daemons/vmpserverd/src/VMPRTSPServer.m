@@ -18,6 +18,8 @@
 
 #import "VMPErrors.h"
 #import "VMPJournal.h"
+#import "VMPLoopWatchdog.h"
+#import "VMPPipelineAnalyzer.h"
 #import "VMPRTSPServer.h"
 
 // Generated project configuration
@@ -32,6 +34,22 @@
 								 userInfo:userInfo];                                               \
 	}
 
+// Redeclare properties as readwrite
+@interface VMPRTSPServer ()
+@property (readwrite) VMPProfileModel *currentProfile;
+
+// Reference counting of on-demand channels. MT-Safe.
+- (void)_acquireChannels:(NSArray<NSString *> *)channels;
+- (void)_acquireChannels:(NSArray<NSString *> *)channels waitUntilDone:(BOOL)wait;
+- (void)_releaseChannels:(NSArray<NSString *> *)channels;
+
+// RTSP client handling. Called from the threads of the RTSP thread pool.
+- (GstRTSPStatusCode)_statusForSetupRequest:(GstRTSPContext *)ctx;
+- (void)_configureSession:(GstRTSPSession *)session;
+- (void)_removeSession:(GstRTSPSession *)session;
+- (void)_trackSetupRequest:(GstRTSPContext *)ctx;
+@end
+
 #pragma mark - RTSP pipeline state
 
 // We have the problem that we cannot identify a mountpoint in the media-constructed callback.
@@ -42,73 +60,236 @@
 @interface _VMPRTSPPipelineState : NSObject
 
 @property (nonatomic) NSString *mountpointName;
-@property (nonatomic) NSData *lastDotGraph;
+// Analysis of the last prepared media. MT-Safe.
+@property (atomic) NSDictionary *analysis;
 @property (nonatomic) NSString *state;
 
+// Names of the video channels, and shared encoders consumed by the mountpoint
+@property (nonatomic) NSArray<NSString *> *channels;
+
+// Maps appsrc element names in the media to the publisher they subscribe to
+@property (nonatomic) NSDictionary<NSString *, VMPStreamPublisher *> *subscriptions;
+
 // Pointer to the RTSP server instance
 // Avoid a retain cycle by using a weak reference
 @property (nonatomic, weak) VMPRTSPServer *server;
 
+// Number of RTSP sessions using the mountpoint. MT-Safe.
+@property (readonly) NSUInteger clients;
+
 - (instancetype)initWithServer:(VMPRTSPServer *)server mountpointName:(NSString *)name;
+
+- (void)addClient;
+- (void)removeClient;
+
+// Weak reference to the element of the last constructed media. MT-Safe.
+- (void)setLastElement:(GstElement *)element;
+// Transfer: Full. NULL if the media was finalised.
+- (GstElement *)lastElement;
+
+// Dot graph of the last constructed media. Generated on demand, and cached until the
+// state of the media changes. The last graph is kept after the media was finalised.
+// MT-Safe.
+- (NSData *)dotGraph;
+- (void)invalidateDotGraph;
+// Generate the dot graph of the last constructed media now, so that it is available
+// after the media was finalised. MT-Safe.
+- (void)snapshotDotGraph;
 @end
 
-@implementation _VMPRTSPPipelineState
+@implementation _VMPRTSPPipelineState {
+	gint _clients;
+	GWeakRef _lastElement;
+	NSData *_dotGraph;
+	BOOL _dotGraphStale;
+}
+
 - (instancetype)initWithServer:(VMPRTSPServer *)server mountpointName:(NSString *)name {
 	self = [super init];
 	if (self) {
 		_server = server;
 		_mountpointName = name;
 		_state = kVMPStateCreated;
+		g_weak_ref_init(&_lastElement, NULL);
 	}
 	return self;
 }
 
+- (void)setLastElement:(GstElement *)element {
+	g_weak_ref_set(&_lastElement, element);
+	[self invalidateDotGraph];
+}
+
+- (GstElement *)lastElement {
+	return g_weak_ref_get(&_lastElement);
+}
+
+- (NSData *)dotGraph {
+	GstElement *element;
+	gchar *dot;
+
+	@synchronized(self) {
+		if (_dotGraph && !_dotGraphStale) {
+			return _dotGraph;
+		}
+
+		// Transfer: Full
+		element = [self lastElement];
+		if (element == NULL) {
+			return _dotGraph;
+		}
+
+		if (GST_IS_BIN(element)) {
+			dot = gst_debug_bin_to_dot_data(GST_BIN(element), GST_DEBUG_GRAPH_SHOW_ALL);
+			if (dot) {
+				_dotGraph = [NSData dataWithBytesNoCopy:dot length:strlen(dot) freeWhenDone:YES];
+				_dotGraphStale = NO;
+			}
+		}
+		gst_object_unref(element);
+
+		return _dotGraph;
+	}
+}
+
+- (void)invalidateDotGraph {
+	@synchronized(self) {
+		_dotGraphStale = YES;
+	}
+}
+
+- (void)snapshotDotGraph {
+	@synchronized(self) {
+		_dotGraphStale = YES;
+		(void) [self dotGraph];
+	}
+}
+
+- (void)dealloc {
+	g_weak_ref_clear(&_lastElement);
+}
+
+- (NSUInteger)clients {
+	return (NSUInteger) g_atomic_int_get(&_clients);
+}
+
+- (void)addClient {
+	g_atomic_int_inc(&_clients);
+}
+
+- (void)removeClient {
+	g_atomic_int_add(&_clients, -1);
+}
+
+@end
+
+// An RTSP session, and the mountpoint it was set up for
+@interface _VMPRTSPSession : NSObject
+@property (nonatomic, readonly) NSDate *createdAt;
+@property (nonatomic, copy) NSString *mountpointName;
+@end
+
+@implementation _VMPRTSPSession
+- (instancetype)init {
+	self = [super init];
+	if (self) {
+		_createdAt = [NSDate date];
+	}
+	return self;
+}
 @end
 
 #pragma mark - RTSP Media Construction Callbacks
 
+static void media_update_subscriptions(GstRTSPMedia *media, _VMPRTSPPipelineState *state,
+									   BOOL subscribe) {
+	NSDictionary<NSString *, VMPStreamPublisher *> *subscriptions;
+	GstElement *element;
+
+	subscriptions = [state subscriptions];
+	if ([subscriptions count] == 0) {
+		return;
+	}
+
+	// Transfer: Full
+	element = gst_rtsp_media_get_element(media);
+	if (GST_IS_BIN(element)) {
+		for (NSString *name in subscriptions) {
+			GstElement *appsrc;
+
+			appsrc = gst_bin_get_by_name(GST_BIN(element), [name UTF8String]);
+			if (appsrc == NULL) {
+				VMPWarn(@"Media for mountpoint '%@' has no appsrc named '%@'",
+						[state mountpointName], name);
+				continue;
+			}
+
+			if (subscribe) {
+				[subscriptions[name] addSubscriber:appsrc];
+			} else {
+				[subscriptions[name] removeSubscriber:appsrc];
+			}
+			gst_object_unref(appsrc);
+		}
+	}
+	gst_object_unref(element);
+}
+
+/* signal callback when the media is unprepared. The media is not reusable, so this
+ * happens exactly once per constructed media, after the last client left. */
+static void media_unprepared_cb(GstRTSPMedia *media, gpointer user_data) {
+	@autoreleasepool {
+		_VMPRTSPPipelineState *state;
+
+		state = (__bridge _VMPRTSPPipelineState *) user_data;
+
+		VMPInfo(@"media %p for mountpoint '%@' was unprepared", media, [state mountpointName]);
+		// The media is finalised after this, and its graph would be lost
+		[state snapshotDotGraph];
+		media_update_subscriptions(media, state, NO);
+		[[state server] _releaseChannels:[state channels]];
+	}
+}
+
 /* signal callback when the media is prepared for streaming. We can get the
  * session manager for each of the streams and connect to some signals. */
 static void media_prepared_cb(GstRTSPMedia *media, gpointer user_data) {
 	@autoreleasepool {
-		guint n_streams;
-		GstElement *element;
 		_VMPRTSPPipelineState *state;
+		NSDictionary *analysis;
+		GstElement *element;
 
 		state = (__bridge _VMPRTSPPipelineState *) user_data;
 
-		element = gst_rtsp_media_get_element(media);
-		n_streams = gst_rtsp_media_n_streams(media);
-
 		VMPInfo(@"media %p is prepared for mountpoint '%@' and has %u streams", media,
-				[state mountpointName], n_streams);
+				[state mountpointName], gst_rtsp_media_n_streams(media));
 
-		if (GST_IS_BIN(element)) {
-			NSData *dot_graph;
-			GstBin *bin;
-			gchar *dot_graph_str;
-
-			bin = GST_BIN(element);
-
-			dot_graph_str = gst_debug_bin_to_dot_data(bin, GST_DEBUG_GRAPH_SHOW_ALL);
-			if (dot_graph_str) {
-				dot_graph = [NSData dataWithBytesNoCopy:dot_graph_str
-												 length:strlen(dot_graph_str)
-										   freeWhenDone:YES];
-				[state setLastDotGraph:dot_graph];
-			}
-		}
+		// Pads, and caps were negotiated during preparation
+		[state invalidateDotGraph];
 
+		// Walking the pipeline is cheap compared to the preparation itself
+		element = gst_rtsp_media_get_element(media);
+		analysis = [VMPPipelineAnalyzer analyzePipeline:element];
+		[VMPPipelineAnalyzer logAnalysis:analysis pipelineName:[state mountpointName]];
+		[state setAnalysis:analysis];
 		gst_object_unref(element);
 	}
 }
 
+/* signal callback when the target state of the media changed */
+static void media_new_state_cb(GstRTSPMedia *media, gint new_state, gpointer user_data) {
+	@autoreleasepool {
+		_VMPRTSPPipelineState *state;
+
+		state = (__bridge _VMPRTSPPipelineState *) user_data;
+		[state invalidateDotGraph];
+	}
+}
+
 static void media_constructed_cb(GstRTSPMediaFactory *factory, GstRTSPMedia *media,
 								 gpointer user_data) {
 	@autoreleasepool {
 		GstElement *element;
-		gchar *dot_graph_str;
-		NSData *dot_graph;
 		_VMPRTSPPipelineState *state;
 
 		state = (__bridge _VMPRTSPPipelineState *) user_data;
@@ -118,55 +299,307 @@ static void media_constructed_cb(GstRTSPMediaFactory *factory, GstRTSPMedia *med
 		// Connect to the "prepared" signal to get more information about the streams once
 		// initialisation is complete
 		g_signal_connect(media, "prepared", (GCallback) media_prepared_cb, user_data);
+		g_signal_connect(media, "new-state", (GCallback) media_new_state_cb, user_data);
+
+		// Keep the consumed channels running for the lifetime of the media
+		[[state server] _acquireChannels:[state channels]];
+		media_update_subscriptions(media, state, YES);
+		g_signal_connect(media, "unprepared", (GCallback) media_unprepared_cb, user_data);
 
+		// The dot graph is generated lazily when requested, as this is expensive for large
+		// pipelines, and a client is waiting for the media here
 		element = gst_rtsp_media_get_element(media);
+		[state setLastElement:element];
+		[[[state server] tracer] tracePipeline:element mountpointName:[state mountpointName]];
+		[[[state server] queueMonitor] monitorPipeline:element
+										mountpointName:[state mountpointName]];
 
-		if (GST_IS_BIN(element)) {
-			VMPDebug(@"Pipeline for mountpoint '%@' is a bin", [state mountpointName]);
-			GstBin *bin;
-			bin = GST_BIN(element);
-
-			// Get first graph in case further initialisation fails in media_prepared_cb
-			dot_graph_str = gst_debug_bin_to_dot_data(bin, GST_DEBUG_GRAPH_SHOW_ALL);
-
-			if (dot_graph_str) {
-				VMPDebug(@"Dot graph for mountpoint '%@' was generated successfully",
-						 [state mountpointName]);
-				dot_graph = [NSData dataWithBytesNoCopy:dot_graph_str
-												 length:strlen(dot_graph_str)
-										   freeWhenDone:YES];
-			} else {
-				VMPDebug(@"Dot graph for mountpoint '%@' could not be generated",
-						 [state mountpointName]);
-				dot_graph = nil;
+		gst_object_unref(element);
+	}
+}
+
+#pragma mark - RTSP Client Callbacks
+
+/* signal callback before a SETUP request is handled. Rejects the request if the
+ * mountpoint has reached its client limit. */
+static GstRTSPStatusCode client_pre_setup_cb(GstRTSPClient *client, GstRTSPContext *ctx,
+											 gpointer user_data) {
+	@autoreleasepool {
+		VMPRTSPServer *server;
+
+		server = (__bridge VMPRTSPServer *) user_data;
+		return [server _statusForSetupRequest:ctx];
+	}
+}
+
+/* signal callback after a SETUP request was handled */
+static void client_setup_cb(GstRTSPClient *client, GstRTSPContext *ctx, gpointer user_data) {
+	@autoreleasepool {
+		VMPRTSPServer *server;
+
+		server = (__bridge VMPRTSPServer *) user_data;
+		[server _trackSetupRequest:ctx];
+	}
+}
+
+/* signal callback when a client created a new session */
+static void client_new_session_cb(GstRTSPClient *client, GstRTSPSession *session,
+								  gpointer user_data) {
+	@autoreleasepool {
+		VMPRTSPServer *server;
+
+		server = (__bridge VMPRTSPServer *) user_data;
+		[server _configureSession:session];
+	}
+}
+
+/* signal callback when a new client connected. The server outlives all clients. */
+static void client_connected_cb(GstRTSPServer *rtspServer, GstRTSPClient *client,
+								gpointer user_data) {
+	g_signal_connect(client, "pre-setup-request", (GCallback) client_pre_setup_cb, user_data);
+	g_signal_connect(client, "new-session", (GCallback) client_new_session_cb, user_data);
+	g_signal_connect(client, "setup-request", (GCallback) client_setup_cb, user_data);
+}
+
+/* signal callback when a session was removed from the session pool */
+static void session_removed_cb(GstRTSPSessionPool *pool, GstRTSPSession *session,
+							   gpointer user_data) {
+	@autoreleasepool {
+		VMPRTSPServer *server;
+
+		server = (__bridge VMPRTSPServer *) user_data;
+		[server _removeSession:session];
+	}
+}
+
+/* Called periodically by the session pool watch. Removes sessions without keep-alive
+ * within their timeout. */
+static gboolean session_pool_cleanup_cb(GstRTSPSessionPool *pool, gpointer user_data) {
+	guint removed;
+
+	removed = gst_rtsp_session_pool_cleanup(pool);
+	if (removed > 0) {
+		VMPInfo(@"Removed %u expired RTSP sessions", removed);
+	}
+
+	return TRUE;
+}
+
+struct session_count {
+	const gchar *path;
+	guint count;
+};
+
+static GstRTSPFilterResult session_count_filter(GstRTSPSessionPool *pool,
+												GstRTSPSession *session, gpointer user_data) {
+	struct session_count *count = user_data;
+	gint matched;
+
+	if (gst_rtsp_session_get_media(session, count->path, &matched) != NULL) {
+		count->count++;
+	}
+
+	return GST_RTSP_FILTER_KEEP;
+}
+
+#pragma mark - RTSP Client Statistics
+
+static NSString *transport_name(const GstRTSPTransport *transport) {
+	switch (transport->lower_transport) {
+	case GST_RTSP_LOWER_TRANS_UDP:
+		return @"udp";
+	case GST_RTSP_LOWER_TRANS_UDP_MCAST:
+		return @"udp-multicast";
+	case GST_RTSP_LOWER_TRANS_TCP:
+		return @"tcp";
+	default:
+		return @"unknown";
+	}
+}
+
+// Whether the comma-separated "host:port" list of a multiudpsink contains the client
+static BOOL multiudpsink_has_client(GstElement *sink, const gchar *host, gint port) {
+	gchar *clients = NULL;
+	gchar *client;
+	gchar **list;
+	BOOL found;
+
+	g_object_get(sink, "clients", &clients, NULL);
+	if (clients == NULL) {
+		return NO;
+	}
+
+	client = g_strdup_printf("%s:%d", host, port);
+	list = g_strsplit(clients, ",", -1);
+	found = g_strv_contains((const gchar *const *) list, client);
+
+	g_strfreev(list);
+	g_free(client);
+	g_free(clients);
+	return found;
+}
+
+/* Add the bytes, and packets sent to a unicast UDP client. Every stream of the media
+ * sends RTP, and RTCP with its own multiudpsink in the media pipeline. Only the sink
+ * sending RTP to the client is queried, as others warn about an unknown client. */
+static void add_udp_statistics(GstElement *pipeline, const GstRTSPTransport *transport,
+							   NSMutableDictionary *stats) {
+	GstIterator *it;
+	GValue item = G_VALUE_INIT;
+	guint64 bytes = 0, packets = 0, value;
+	BOOL found = NO;
+
+	it = gst_bin_iterate_recurse(GST_BIN(pipeline));
+	while (gst_iterator_next(it, &item) == GST_ITERATOR_OK) {
+		GstElement *element;
+		GstElementFactory *factory;
+		GstStructure *udpStats = NULL;
+
+		element = g_value_get_object(&item);
+		factory = gst_element_get_factory(element);
+		if (factory &&
+			g_strcmp0(gst_plugin_feature_get_name(GST_PLUGIN_FEATURE(factory)), "multiudpsink") ==
+				0 &&
+			multiudpsink_has_client(element, transport->destination,
+									(gint) transport->client_port.min)) {
+			g_signal_emit_by_name(element, "get-stats", transport->destination,
+								  (gint) transport->client_port.min, &udpStats);
+		}
+		if (udpStats) {
+			if (gst_structure_get_uint64(udpStats, "bytes-sent", &value)) {
+				bytes += value;
+				found = YES;
 			}
+			if (gst_structure_get_uint64(udpStats, "packets-sent", &value)) {
+				packets += value;
+			}
+			gst_structure_free(udpStats);
+		}
+		g_value_reset(&item);
+	}
+	g_value_unset(&item);
+	gst_iterator_free(it);
+
+	if (found) {
+		stats[@"bytesSent"] = @(bytes);
+		stats[@"packetsSent"] = @(packets);
+	}
+}
 
-			// Update the state object
-			[state setLastDotGraph:dot_graph];
+/* Add jitter, and loss of the last RTCP receiver report of a unicast UDP client. The
+ * report is attributed to the client by the address it was sent from. */
+static void add_rtcp_statistics(GstRTSPStream *stream, const GstRTSPTransport *transport,
+								NSMutableDictionary *stats) {
+	GObject *session;
+	GstStructure *sessionStats = NULL;
+	const GValue *sources;
+	GValueArray *array;
+	gchar *from, *fromV6;
+	guint clockRate = 0;
+
+	session = gst_rtsp_stream_get_rtpsession(stream);
+	if (!session) {
+		return;
+	}
+	g_object_get(session, "stats", &sessionStats, NULL);
+	g_object_unref(session);
+	if (!sessionStats) {
+		return;
+	}
+
+	sources = gst_structure_get_value(sessionStats, "source-stats");
+	if (!sources || !G_VALUE_HOLDS_BOXED(sources)) {
+		gst_structure_free(sessionStats);
+		return;
+	}
+
+	from = g_strdup_printf("%s:%d", transport->destination, transport->client_port.max);
+	fromV6 = g_strdup_printf("[%s]:%d", transport->destination, transport->client_port.max);
+
+	G_GNUC_BEGIN_IGNORE_DEPRECATIONS
+	array = g_value_get_boxed(sources);
+	// The clock rate of the stream is known by the sending (internal) source
+	for (guint i = 0; array && i < array->n_values; i++) {
+		const GstStructure *source = gst_value_get_structure(&array->values[i]);
+		gboolean internal = FALSE;
+		gint rate;
+
+		gst_structure_get_boolean(source, "internal", &internal);
+		if (internal && gst_structure_get_int(source, "clock-rate", &rate) && rate > 0) {
+			clockRate = (guint) rate;
+		}
+	}
+	for (guint i = 0; array && i < array->n_values; i++) {
+		const GstStructure *source = gst_value_get_structure(&array->values[i]);
+		const gchar *rtcpFrom;
+		gboolean haveReport = FALSE;
+		guint jitter, fractionLost;
+		gint packetsLost;
+
+		rtcpFrom = gst_structure_get_string(source, "rtcp-from");
+		gst_structure_get_boolean(source, "have-rb", &haveReport);
+		if (!haveReport || !rtcpFrom ||
+			(g_strcmp0(rtcpFrom, from) != 0 && g_strcmp0(rtcpFrom, fromV6) != 0)) {
+			continue;
 		}
 
-		gst_object_unref(element);
+		if (gst_structure_get_uint(source, "rb-jitter", &jitter) && clockRate > 0) {
+			stats[@"jitter"] = @(jitter * 1000.0 / clockRate);
+		}
+		if (gst_structure_get_int(source, "rb-packetslost", &packetsLost)) {
+			stats[@"packetsLost"] = @(packetsLost);
+		}
+		if (gst_structure_get_uint(source, "rb-fractionlost", &fractionLost)) {
+			stats[@"fractionLost"] = @(fractionLost / 256.0);
+		}
+		break;
 	}
+	G_GNUC_END_IGNORE_DEPRECATIONS
+
+	g_free(from);
+	g_free(fromV6);
+	gst_structure_free(sessionStats);
 }
 
 #pragma mark - VMPRTSPServer
 
-// Redeclare properties as readwrite
-@interface VMPRTSPServer ()
-@property (readwrite) VMPProfileModel *currentProfile;
-@end
-
 @implementation VMPRTSPServer {
 	GstRTSPServer *_server;
 	GstRTSPMountPoints *_mountPoints;
 
 	// Registered source ID for the RTSP Server (GSource)
 	guint _serverSourceId;
+	// Registered source ID for the session cleanup (GSource)
+	guint _sessionCleanupSourceId;
+	// Number of SETUP requests rejected due to client limits. Atomic.
+	gint _rejectedSetupRequests;
+	// All RTSP sessions by session identifier
+	NSMutableDictionary<NSString *, _VMPRTSPSession *> *_sessions;
+	// Number of error, and warning messages per pipeline and element
+	NSMutableDictionary<NSString *, NSMutableDictionary *> *_busMessageCounts;
 
 	NSMutableArray<VMPPipelineManager *> *_managedPipelines;
 	NSMutableArray<VMPRecordingManager *> *_activeRecordings;
 	NSMutableDictionary<NSString *, _VMPRTSPPipelineState *> *_rtspPipelineStates;
 
+	// Number of consumers (RTSP media, and recordings) per channel. Only used for
+	// on-demand channels.
+	NSMutableDictionary<NSString *, NSNumber *> *_channelConsumers;
+
+	// Managers with a pending restart retry loop by channel name. Only accessed on the
+	// main thread.
+	NSMutableSet<NSString *> *_pendingRestarts;
+
+	// Shared encoders by name. Encoders are always started on demand.
+	NSMutableDictionary<NSString *, VMPPipelineManager *> *_encoders;
+	// Maps the name of a shared encoder to its video channel
+	NSMutableDictionary<NSString *, NSString *> *_encoderChannels;
+
+	// HLS egress pipelines, and the URL path of their playlist by pipeline name. Only
+	// modified before the HTTP server is started.
+	NSMutableDictionary<NSString *, VMPPipelineManager *> *_hlsPipelines;
+	NSMutableDictionary<NSString *, NSString *> *_hlsPlaylists;
+
 	// Dispatch Queue for Recordings
 	dispatch_queue_t _recordingsQueue;
 }
@@ -194,11 +627,47 @@ static void media_constructed_cb(GstRTSPMediaFactory *factory, GstRTSPMedia *med
 
 		NSUInteger channelCount = [[_configuration channels] count];
 		_managedPipelines = [NSMutableArray arrayWithCapacity:channelCount];
+		_channelConsumers = [NSMutableDictionary dictionaryWithCapacity:channelCount];
+		_pendingRestarts = [NSMutableSet set];
+		_encoders = [NSMutableDictionary dictionaryWithCapacity:channelCount];
+		_encoderChannels = [NSMutableDictionary dictionaryWithCapacity:channelCount];
+		_activeRecordings = [NSMutableArray array];
+		_hlsPipelines = [NSMutableDictionary dictionary];
+		_hlsPlaylists = [NSMutableDictionary dictionary];
+		_sessions = [NSMutableDictionary dictionary];
+		_busMessageCounts = [NSMutableDictionary dictionary];
 
 		g_object_set(_server, "service", (const gchar *) [[_configuration rtspPort] UTF8String],
 					 NULL);
 		g_object_set(_server, "address", (const gchar *) [[_configuration rtspAddress] UTF8String],
 					 NULL);
+
+		// Clients are handled by a pool of threads, instead of the main context
+		GstRTSPThreadPool *threadPool = gst_rtsp_server_get_thread_pool(_server);
+		gst_rtsp_thread_pool_set_max_threads(threadPool,
+											 [[_configuration rtspThreadPoolSize] intValue]);
+		g_object_unref(threadPool);
+
+		GstRTSPSessionPool *sessionPool = gst_rtsp_server_get_session_pool(_server);
+		gst_rtsp_session_pool_set_max_sessions(sessionPool,
+											   [[_configuration rtspMaxSessions] unsignedIntValue]);
+		g_signal_connect(sessionPool, "session-removed", (GCallback) session_removed_cb,
+						 (__bridge void *) self);
+		g_object_unref(sessionPool);
+
+		g_signal_connect(_server, "client-connected", (GCallback) client_connected_cb,
+						 (__bridge void *) self);
+
+		_metrics = [VMPMetrics new];
+		if ([[_configuration tracing] boolValue]) {
+			_tracer = [VMPTracer new];
+		}
+		if ([[_configuration queueSampleInterval] doubleValue] > 0) {
+			_queueMonitor = [[VMPQueueMonitor alloc]
+				 initWithInterval:[[_configuration queueSampleInterval] doubleValue]
+				saturationTimeout:[[_configuration queueSaturationTimeout] doubleValue]];
+			[_queueMonitor setMetrics:_metrics];
+		}
 	}
 	return self;
 }
@@ -244,93 +713,756 @@ static void media_constructed_cb(GstRTSPMediaFactory *factory, GstRTSPMedia *med
 	VMPDebug(@"Received bus event from element %s on channel %@: %s", source, channel,
 			 GST_MESSAGE_TYPE_NAME(message));
 
-	switch (type) {
-	case GST_MESSAGE_ERROR: {
-		GError *err;
-		gchar *debug;
+	switch (type) {
+	case GST_MESSAGE_ERROR: {
+		GError *err;
+		gchar *debug;
+
+		// Transfer: FULL
+		gst_message_parse_error(message, &err, &debug);
+
+		VMPError(@"Error from element %s on channel %@: %s", source, channel, err->message);
+		[self _countBusMessage:@"errors" channel:channel element:source];
+
+		g_error_free(err);
+		g_free(debug);
+		break;
+	}
+	case GST_MESSAGE_WARNING: {
+		GError *err;
+		gchar *debug;
+
+		// Transfer: FULL
+		gst_message_parse_warning(message, &err, &debug);
+
+		VMPWarn(@"Warning from element %s on channel %@: %s", source, channel, err->message);
+		[self _countBusMessage:@"warnings" channel:channel element:source];
+
+		g_error_free(err);
+		g_free(debug);
+		break;
+	}
+	case GST_MESSAGE_EOS: {
+		VMPError(@"End of stream for channel %@", channel);
+
+		// Bus messages are delivered on the GLib dispatch thread. Restarts are
+		// scheduled on the main run loop instead.
+		[self performSelectorOnMainThread:@selector(_scheduleRestartForManager:)
+							   withObject:mgr
+							waitUntilDone:NO];
+		break;
+	}
+	default:
+		break;
+	}
+}
+
+/*
+	Called from the GLib dispatch thread when a channel stopped producing buffers
+	without posting an error, or EOS (e.g. a capture card without signal).
+*/
+- (void)onStall:(NSTimeInterval)duration manager:(VMPPipelineManager *)mgr {
+	VMPError(@"Channel %@ stalled for %.1f seconds", [mgr channel], duration);
+
+	[self performSelectorOnMainThread:@selector(_restartStalledManager:)
+						   withObject:mgr
+						waitUntilDone:NO];
+}
+
+#pragma mark - Private methods
+
+// Restart immediately, and fall back to restarts with increasing delay on failure
+- (void)_restartStalledManager:(VMPPipelineManager *)mgr {
+	if ([_pendingRestarts containsObject:[mgr channel]]) {
+		VMPDebug(@"Restart of stalled channel %@ is already scheduled", [mgr channel]);
+		return;
+	}
+	if ([self _isOnDemandChannel:[mgr channel]] &&
+		[self _consumerCountForChannel:[mgr channel]] == 0) {
+		VMPInfo(@"Channel %@ has no consumers. Skipping restart", [mgr channel]);
+		return;
+	}
+
+	[VMPLoopWatchdog beginActivity:[NSString stringWithFormat:@"-[VMPRTSPServer %@] %@",
+															   NSStringFromSelector(_cmd),
+															   [mgr channel]]
+							onLoop:VMPLoopMain];
+	if (![mgr restart]) {
+		VMPError(@"Could not restart stalled channel %@. Retrying...", [mgr channel]);
+		[self _scheduleRestartForManager:mgr];
+	}
+	[VMPLoopWatchdog endActivityOnLoop:VMPLoopMain];
+}
+
+// Errors, and warnings are rare, so the counters are protected by a lock
+- (void)_countBusMessage:(NSString *)type channel:(NSString *)channel element:(gchar *)element {
+	NSMutableDictionary<NSString *, NSMutableDictionary *> *perChannel;
+	NSMutableDictionary<NSString *, NSNumber *> *perElement;
+	NSString *name;
+
+	name = element ? [NSString stringWithUTF8String:element] : @"unknown";
+
+	@synchronized(_busMessageCounts) {
+		perChannel = _busMessageCounts[channel];
+		if (!perChannel) {
+			perChannel = [NSMutableDictionary dictionary];
+			_busMessageCounts[channel] = perChannel;
+		}
+		perElement = perChannel[type];
+		if (!perElement) {
+			perElement = [NSMutableDictionary dictionary];
+			perChannel[type] = perElement;
+		}
+		perElement[name] = @([perElement[name] unsignedIntegerValue] + 1);
+	}
+
+	[_metrics addValue:1
+			  toMetric:@"vmp_bus_messages_total"
+				labels:@{
+					@"pipeline" : channel,
+					@"element" : name,
+					@"severity" : [type isEqualToString:@"errors"] ? @"error" : @"warning"
+				}];
+}
+
+- (NSDictionary *)_busMessageStatistics {
+	NSMutableDictionary *result;
+
+	@synchronized(_busMessageCounts) {
+		result = [NSMutableDictionary dictionaryWithCapacity:[_busMessageCounts count]];
+		for (NSString *channel in _busMessageCounts) {
+			NSMutableDictionary *perChannel = [NSMutableDictionary dictionary];
+
+			for (NSString *type in _busMessageCounts[channel]) {
+				perChannel[type] = [_busMessageCounts[channel][type] copy];
+			}
+			result[channel] = perChannel;
+		}
+	}
+
+	return result;
+}
+
+- (void)_scheduleRestartForManager:(VMPPipelineManager *)mgr {
+	NSTimeInterval initialDelay = 1.0;
+	NSTimeInterval delayIncrement = 2.0;
+	NSTimeInterval maxDelay = 30.0;
+	NSString *channel = [mgr channel];
+
+	// Every failure path ends up here. Keep at most one retry loop per manager.
+	if ([_pendingRestarts containsObject:channel]) {
+		VMPDebug(@"Restart of %@ is already scheduled", channel);
+		return;
+	}
+	[_pendingRestarts addObject:channel];
+
+	[[NSRunLoop currentRunLoop]
+		 scheduleBlock:^BOOL {
+			 // Stop if pipeline was restarted successfully, continue
+			 // with increasing delay otherwise
+			 // An idle on-demand channel is started again by its next consumer
+			 if ([self _isOnDemandChannel:[mgr channel]] &&
+				 [self _consumerCountForChannel:[mgr channel]] == 0) {
+				 VMPInfo(@"Channel %@ has no consumers. Skipping restart", [mgr channel]);
+				 [_pendingRestarts removeObject:channel];
+				 return YES;
+			 }
+
+			 VMPInfo(@"Trying to restart pipeline mgr %@...", mgr);
+
+			 // Restarts are processed serially on the main run loop, so
+			 // two restarts of the same manager cannot interleave.
+			 [VMPLoopWatchdog
+				 beginActivity:[NSString stringWithFormat:@"Scheduled restart of %@", [mgr channel]]
+						onLoop:VMPLoopMain];
+			 BOOL status = [mgr restart];
+			 [VMPLoopWatchdog endActivityOnLoop:VMPLoopMain];
+			 if (status) {
+				 VMPInfo(@"Restart of %@ Successful!", mgr);
+				 [_pendingRestarts removeObject:channel];
+			 } else {
+				 VMPError(@"Could not restart %@. Retrying...", mgr);
+			 }
+
+			 return status;
+		 }
+		  initialDelay:initialDelay
+		delayIncrement:delayIncrement
+			  maxDelay:maxDelay];
+}
+
+// The mountpoint addressed by the URI of a request, or nil
+- (VMPConfigMountpointModel *)_mountpointForContext:(GstRTSPContext *)ctx {
+	NSString *path;
+	gchar *requestPath;
+
+	if (ctx->uri == NULL) {
+		return nil;
+	}
+
+	requestPath = gst_rtsp_mount_points_make_path(_mountPoints, ctx->uri);
+	if (requestPath == NULL) {
+		return nil;
+	}
+	path = [NSString stringWithUTF8String:requestPath];
+	g_free(requestPath);
+
+	// The request path contains the stream of the mountpoint (e.g. /comb/stream=0)
+	for (VMPConfigMountpointModel *cur in [_configuration mountpoints]) {
+		if ([path isEqualToString:[cur path]] ||
+			[path hasPrefix:[[cur path] stringByAppendingString:@"/"]]) {
+			return cur;
+		}
+	}
+
+	return nil;
+}
+
+- (GstRTSPStatusCode)_statusForSetupRequest:(GstRTSPContext *)ctx {
+	VMPConfigMountpointModel *mountpoint;
+	GstRTSPSessionPool *pool;
+	struct session_count count;
+	NSUInteger limit;
+	gint matched;
+
+	mountpoint = [self _mountpointForContext:ctx];
+	if (!mountpoint) {
+		return GST_RTSP_STS_OK;
+	}
+
+	limit = [([mountpoint properties][@"maxClients"]
+				  ?: [_configuration rtspMaxClientsPerMountpoint]) unsignedIntegerValue];
+	if (limit == 0) {
+		return GST_RTSP_STS_OK;
+	}
+
+	// Further streams of a session are already counted
+	if (ctx->session &&
+		gst_rtsp_session_get_media(ctx->session, [[mountpoint path] UTF8String], &matched)) {
+		return GST_RTSP_STS_OK;
+	}
+
+	// The session is created after this request is accepted, so concurrent requests
+	// may exceed the limit by the number of threads in the pool.
+	count.path = [[mountpoint path] UTF8String];
+	count.count = 0;
+	pool = gst_rtsp_server_get_session_pool(_server);
+	gst_rtsp_session_pool_filter(pool, session_count_filter, &count);
+	g_object_unref(pool);
+
+	if (count.count >= limit) {
+		g_atomic_int_inc(&_rejectedSetupRequests);
+		[_metrics addValue:1 toMetric:@"vmp_rtsp_rejected_setup_requests_total" labels:@{}];
+		VMPWarn(@"Rejecting client of mountpoint '%@': %u of %lu clients connected",
+				[mountpoint name], count.count, limit);
+		return GST_RTSP_STS_SERVICE_UNAVAILABLE;
+	}
+
+	return GST_RTSP_STS_OK;
+}
+
+- (void)_configureSession:(GstRTSPSession *)session {
+	NSString *sessionId;
+
+	gst_rtsp_session_set_timeout(session, [[_configuration rtspSessionTimeout] unsignedIntValue]);
+
+	sessionId = [NSString stringWithUTF8String:gst_rtsp_session_get_sessionid(session)];
+	@synchronized(_sessions) {
+		_sessions[sessionId] = [_VMPRTSPSession new];
+	}
+	[_metrics addValue:1 toMetric:@"vmp_rtsp_sessions" labels:@{}];
+}
+
+- (void)_removeSession:(GstRTSPSession *)session {
+	_VMPRTSPSession *info;
+	NSString *sessionId;
+
+	sessionId = [NSString stringWithUTF8String:gst_rtsp_session_get_sessionid(session)];
+	@synchronized(_sessions) {
+		info = _sessions[sessionId];
+		[_sessions removeObjectForKey:sessionId];
+	}
+
+	if (info) {
+		[_metrics addValue:-1 toMetric:@"vmp_rtsp_sessions" labels:@{}];
+	}
+	if ([info mountpointName]) {
+		[_rtspPipelineStates[[info mountpointName]] removeClient];
+		[_metrics addValue:-1
+				  toMetric:@"vmp_rtsp_clients"
+					labels:@{@"mountpoint" : [info mountpointName]}];
+	}
+}
+
+// Count the session as a client of the mountpoint on its first SETUP request
+- (void)_trackSetupRequest:(GstRTSPContext *)ctx {
+	VMPConfigMountpointModel *mountpoint;
+	_VMPRTSPSession *info;
+	NSString *sessionId;
+
+	if (ctx->session == NULL) {
+		return;
+	}
+	mountpoint = [self _mountpointForContext:ctx];
+	if (!mountpoint) {
+		return;
+	}
+
+	sessionId = [NSString stringWithUTF8String:gst_rtsp_session_get_sessionid(ctx->session)];
+	@synchronized(_sessions) {
+		info = _sessions[sessionId];
+		if (!info || [info mountpointName]) {
+			return;
+		}
+		[info setMountpointName:[mountpoint name]];
+	}
+
+	[_rtspPipelineStates[[mountpoint name]] addClient];
+	[_metrics addValue:1 toMetric:@"vmp_rtsp_clients" labels:@{@"mountpoint" : [mountpoint name]}];
+}
+
+// Statistics of a session for one mountpoint, or nil if the media does not belong to
+// any of the mountpoints.
+- (NSDictionary *)_statisticsForSessionMedia:(GstRTSPSessionMedia *)sessionMedia
+									 session:(GstRTSPSession *)session
+									 address:(NSString *)address
+								 mountpoints:(NSArray<VMPConfigMountpointModel *> *)mountpoints {
+	VMPConfigMountpointModel *mountpoint = nil;
+	NSMutableDictionary *stats;
+	NSMutableArray *streams;
+	NSString *sessionId;
+	NSDate *createdAt;
+	GstRTSPMedia *media;
+	GstElement *element;
+	GstObject *pipeline;
+	GPtrArray *transports;
+	gint matched;
+
+	for (VMPConfigMountpointModel *cur in mountpoints) {
+		const gchar *path = [[cur path] UTF8String];
+
+		if (gst_rtsp_session_media_matches(sessionMedia, path, &matched) &&
+			matched == (gint) strlen(path)) {
+			mountpoint = cur;
+			break;
+		}
+	}
+	if (!mountpoint) {
+		return nil;
+	}
+
+	// Transfer: None
+	media = gst_rtsp_session_media_get_media(sessionMedia);
+	// Transfer: Full
+	element = gst_rtsp_media_get_element(media);
+	pipeline = gst_object_get_parent(GST_OBJECT(element));
+	gst_object_unref(element);
+
+	transports = gst_rtsp_session_media_get_transports(sessionMedia);
+	streams = [NSMutableArray arrayWithCapacity:transports->len];
+	for (guint i = 0; i < transports->len; i++) {
+		GstRTSPStreamTransport *trans;
+		const GstRTSPTransport *transport;
+		GstRTSPStream *stream;
+		NSMutableDictionary *cur;
+
+		trans = g_ptr_array_index(transports, i);
+		if (!trans) {
+			continue;
+		}
+		transport = gst_rtsp_stream_transport_get_transport(trans);
+		stream = gst_rtsp_stream_transport_get_stream(trans);
+
+		cur = [NSMutableDictionary dictionaryWithCapacity:7];
+		cur[@"index"] = @(gst_rtsp_stream_get_index(stream));
+		cur[@"transport"] = transport_name(transport);
+		// Multicast clients share their stream, and TCP clients have no address to
+		// attribute the statistics to
+		if (transport->lower_transport == GST_RTSP_LOWER_TRANS_UDP) {
+			if (pipeline) {
+				add_udp_statistics(GST_ELEMENT(pipeline), transport, cur);
+			}
+			add_rtcp_statistics(stream, transport, cur);
+		}
+		[streams addObject:cur];
+	}
+	g_ptr_array_unref(transports);
+	if (pipeline) {
+		gst_object_unref(pipeline);
+	}
+
+	sessionId = [NSString stringWithUTF8String:gst_rtsp_session_get_sessionid(session)];
+	@synchronized(_sessions) {
+		createdAt = [_sessions[sessionId] createdAt];
+	}
+
+	stats = [NSMutableDictionary dictionaryWithCapacity:6];
+	stats[@"session"] = sessionId;
+	stats[@"mountpoint"] = [mountpoint name];
+	stats[@"address"] = address;
+	stats[@"timeout"] = @(gst_rtsp_session_get_timeout(session));
+	stats[@"streams"] = streams;
+	if (createdAt) {
+		stats[@"age"] = @(-[createdAt timeIntervalSinceNow]);
+	}
+
+	return stats;
+}
+
+- (NSDictionary *)_rtspStatistics {
+	NSMutableDictionary<NSString *, NSNumber *> *clients;
+	GstRTSPSessionPool *pool;
+	guint sessions;
+
+	pool = gst_rtsp_server_get_session_pool(_server);
+	sessions = gst_rtsp_session_pool_get_n_sessions(pool);
+	g_object_unref(pool);
+
+	clients = [NSMutableDictionary dictionaryWithCapacity:[_rtspPipelineStates count]];
+	for (NSString *name in _rtspPipelineStates) {
+		clients[name] = @([_rtspPipelineStates[name] clients]);
+	}
+
+	return @{
+		@"sessions" : @(sessions),
+		@"clients" : clients,
+		@"maxSessions" : [_configuration rtspMaxSessions],
+		@"maxClientsPerMountpoint" : [_configuration rtspMaxClientsPerMountpoint],
+		@"threadPoolSize" : [_configuration rtspThreadPoolSize],
+		@"sessionTimeout" : [_configuration rtspSessionTimeout],
+		@"rejectedSetupRequests" : @(g_atomic_int_get(&_rejectedSetupRequests)),
+	};
+}
+
+- (BOOL)_isOnDemandChannel:(NSString *)channel {
+	// HLS egress pipelines run for the lifetime of the server
+	if (_hlsPipelines[channel]) {
+		return NO;
+	}
+
+	if ([[_configuration onDemandChannels] boolValue]) {
+		return YES;
+	}
+
+	@synchronized(_encoders) {
+		return _encoders[channel] != nil;
+	}
+}
+
+- (NSUInteger)_consumerCountForChannel:(NSString *)channel {
+	@synchronized(_channelConsumers) {
+		return [_channelConsumers[channel] unsignedIntegerValue];
+	}
+}
+
+- (void)_acquireChannels:(NSArray<NSString *> *)channels {
+	[self _acquireChannels:channels waitUntilDone:NO];
+}
+
+// If wait is YES, the channels are started when this method returns
+- (void)_acquireChannels:(NSArray<NSString *> *)channels waitUntilDone:(BOOL)wait {
+	if ([channels count] == 0) {
+		return;
+	}
+
+	// Pipeline managers are started, stopped, and restarted on the main thread only
+	[self performSelectorOnMainThread:@selector(_acquireChannelsOnMainThread:)
+						   withObject:channels
+						waitUntilDone:wait];
+}
+
+- (void)_releaseChannels:(NSArray<NSString *> *)channels {
+	if ([channels count] == 0) {
+		return;
+	}
+
+	[self performSelectorOnMainThread:@selector(_releaseChannelsOnMainThread:)
+						   withObject:channels
+						waitUntilDone:NO];
+}
+
+- (void)_acquireChannelsOnMainThread:(NSArray<NSString *> *)channels {
+	for (NSString *channel in channels) {
+		VMPPipelineManager *mgr;
+		NSUInteger count;
+
+		if (![self _isOnDemandChannel:channel]) {
+			continue;
+		}
+
+		@synchronized(_channelConsumers) {
+			count = [_channelConsumers[channel] unsignedIntegerValue] + 1;
+			_channelConsumers[channel] = @(count);
+		}
+
+		// Cancel a pending idle stop
+		[NSObject cancelPreviousPerformRequestsWithTarget:self
+												 selector:@selector(_stopIdleChannel:)
+												   object:channel];
+
+		mgr = [self pipelineManagerForChannel:channel];
+		if (!mgr) {
+			VMPWarn(@"Consumer acquired unknown channel %@", channel);
+			continue;
+		}
+
+		VMPDebug(@"Channel %@ has %lu consumers", channel, count);
+		// A pending restart loop starts the channel now that it has a consumer
+		if ([_pendingRestarts containsObject:channel]) {
+			continue;
+		}
+		if (count == 1 && ![[mgr state] isEqualToString:kVMPStatePlaying]) {
+			VMPInfo(@"Starting on-demand channel %@", channel);
+			[VMPLoopWatchdog
+				beginActivity:[NSString stringWithFormat:@"Start of on-demand channel %@", channel]
+					   onLoop:VMPLoopMain];
+			if (![mgr start]) {
+				VMPError(@"Failed to start on-demand channel %@", channel);
+				[self _scheduleRestartForManager:mgr];
+			}
+			[VMPLoopWatchdog endActivityOnLoop:VMPLoopMain];
+		}
+	}
+}
+
+- (void)_releaseChannelsOnMainThread:(NSArray<NSString *> *)channels {
+	NSTimeInterval timeout;
+
+	timeout = [[_configuration channelIdleTimeout] doubleValue];
+
+	for (NSString *channel in channels) {
+		NSUInteger count;
+
+		if (![self _isOnDemandChannel:channel]) {
+			continue;
+		}
+
+		@synchronized(_channelConsumers) {
+			count = [_channelConsumers[channel] unsignedIntegerValue];
+			if (count > 0) {
+				count--;
+			}
+			_channelConsumers[channel] = @(count);
+		}
+
+		VMPDebug(@"Channel %@ has %lu consumers", channel, count);
+		if (count == 0) {
+			VMPInfo(@"Channel %@ is idle. Stopping in %.1f seconds", channel, timeout);
+			[self performSelector:@selector(_stopIdleChannel:)
+					   withObject:channel
+					   afterDelay:timeout];
+		}
+	}
+}
+
+- (void)_stopIdleChannel:(NSString *)channel {
+	VMPPipelineManager *mgr;
+
+	// A consumer might have acquired the channel in the meantime
+	if ([self _consumerCountForChannel:channel] > 0) {
+		return;
+	}
+
+	mgr = [self pipelineManagerForChannel:channel];
+	if (mgr) {
+		VMPInfo(@"Stopping idle on-demand channel %@", channel);
+		[VMPLoopWatchdog
+			beginActivity:[NSString stringWithFormat:@"Stop of on-demand channel %@", channel]
+				   onLoop:VMPLoopMain];
+		[mgr stop];
+		[VMPLoopWatchdog endActivityOnLoop:VMPLoopMain];
+	}
+}
+
+// Publisher fanning out the buffers of a channel, or shared encoder to its consumers
+- (VMPStreamPublisher *)_publisherWithName:(NSString *)name audio:(BOOL)audio {
+	VMPStreamPublisher *publisher = [VMPStreamPublisher publisherWithName:name];
+	NSNumber *queueSize;
+
+	// Audio buffers are small, and far more frequent than video frames
+	queueSize = audio ? [_configuration audioBusQueueSize] : [_configuration channelBusQueueSize];
+	[publisher setQueueSize:[queueSize unsignedIntegerValue]];
+	return publisher;
+}
+
+- (BOOL)_usesNativeChannelBus {
+	return [[_configuration channelBus] isEqualToString:VMPConfigChannelBusNative];
+}
+
+// Sink element publishing a video channel ({VIDEOSINK} in the profile)
+- (NSString *)_videoSinkForChannel:(NSString *)channel {
+	if ([self _usesNativeChannelBus]) {
+		return @"appsink name=publisher sync=false";
+	}
+
+	return [NSString stringWithFormat:@"intervideosink channel=%@", channel];
+}
+
+// Source element receiving a video channel ({VIDEOSRC} in the profile). With the native
+// channel bus, the appsrc is added to the subscriptions of the consuming pipeline.
+- (NSString *)_videoSourceForChannel:(NSString *)channel
+						 elementName:(NSString *)elementName
+					   subscriptions:
+						   (NSMutableDictionary<NSString *, VMPStreamPublisher *> *)subscriptions {
+	if ([self _usesNativeChannelBus]) {
+		VMPStreamPublisher *publisher = [[self pipelineManagerForChannel:channel] publisher];
+
+		if (publisher) {
+			subscriptions[elementName] = publisher;
+			return [NSString stringWithFormat:@"appsrc name=%@ is-live=true format=time",
+											  elementName];
+		}
+
+		VMPWarn(@"Channel %@ is not published on the channel bus. Using intervideosrc", channel);
+	}
+
+	return [NSString stringWithFormat:@"intervideosrc channel=%@", channel];
+}
+
+// Returns the shared encoder for a video channel and encoding configuration, and creates it
+// if necessary. The encoder is started by its first consumer.
+- (VMPPipelineManager *)_sharedEncoderForChannel:(NSString *)channel
+										   width:(NSNumber *)width
+										  height:(NSNumber *)height
+										 bitrate:(NSNumber *)bitrate
+										   error:(NSError **)error {
+	VMPPipelineManager *encoder;
+	NSMutableDictionary<NSString *, VMPStreamPublisher *> *subscriptions;
+	NSDictionary<NSString *, NSString *> *vars;
+	NSString *name, *pipeline;
 
-		// Transfer: FULL
-		gst_message_parse_error(message, &err, &debug);
+	name = [NSString stringWithFormat:@"_encoder_%@_%@x%@_%@", channel, width, height, bitrate];
 
-		VMPError(@"Error from element %s on channel %@: %s", source, channel, err->message);
+	@synchronized(_encoders) {
+		encoder = _encoders[name];
+		if (encoder) {
+			return encoder;
+		}
 
-		g_error_free(err);
-		g_free(debug);
-		break;
+		subscriptions = [NSMutableDictionary dictionaryWithCapacity:1];
+		vars = @{
+			@"VIDEOCHANNEL" : channel,
+			@"VIDEOSRC" : [self _videoSourceForChannel:channel
+										   elementName:@"channel"
+										 subscriptions:subscriptions],
+			@"WIDTH" : [width stringValue],
+			@"HEIGHT" : [height stringValue],
+			@"BITRATE" : [bitrate stringValue]
+		};
+		pipeline = [_currentProfile pipelineForSharedEncoderType:@"video"
+													   variables:vars
+														   error:error];
+		if (!pipeline) {
+			return nil;
+		}
+		pipeline = [pipeline stringByAppendingString:@" ! appsink name=publisher sync=false"];
+
+		encoder = [VMPPipelineManager managerWithLaunchArgs:pipeline channel:name delegate:self];
+		[encoder setPublisher:[self _publisherWithName:name audio:NO]];
+		[encoder setSubscriptions:subscriptions];
+		[encoder setTracer:_tracer];
+		[encoder setQueueMonitor:_queueMonitor];
+		[encoder setMetrics:_metrics];
+		[encoder setStallTimeout:[[_configuration channelStallTimeout] doubleValue]];
+		_encoders[name] = encoder;
+		_encoderChannels[name] = channel;
 	}
-	case GST_MESSAGE_WARNING: {
-		GError *err;
-		gchar *debug;
 
-		// Transfer: FULL
-		gst_message_parse_warning(message, &err, &debug);
+	VMPInfo(@"Created shared encoder %@ for channel %@", name, channel);
+	return encoder;
+}
 
-		VMPWarn(@"Warning from element %s on channel %@: %s", source, channel, err->message);
+// Returns the shared compositor of a combined mountpoint, creating it on first use.
+// It is shared between the RTSP media, and the HLS egress of the mountpoint.
+- (VMPPipelineManager *)_sharedEncoderForCombinedMountpoint:(NSString *)mountpoint
+											   videoChannel:(NSString *)videoChannel
+									  secondaryVideoChannel:(NSString *)secondaryVideoChannel
+													  error:(NSError **)error {
+	VMPPipelineManager *encoder;
+	NSMutableDictionary<NSString *, VMPStreamPublisher *> *subscriptions;
+	NSDictionary<NSString *, NSString *> *vars;
+	NSString *name, *pipeline;
 
-		g_error_free(err);
-		g_free(debug);
-		break;
-	}
-	case GST_MESSAGE_EOS: {
-		VMPError(@"End of stream for channel %@", channel);
+	name = [NSString stringWithFormat:@"_encoder_%@", mountpoint];
 
-		NSTimeInterval initialDelay = 1.0;
-		NSTimeInterval delayIncrement = 2.0;
-		NSTimeInterval maxDelay = 30.0;
-
-		[[NSRunLoop currentRunLoop]
-			 scheduleBlock:^BOOL {
-				 VMPInfo(@"Stopping pipeline mgr %@ for scheduled restart...", mgr);
-				 [mgr stop];
-
-				 // Stop if pipeline was started successfully, continue
-				 // with increasing delay otherwise
-				 VMPInfo(@"Trying to restart pipeline mgr %@...", mgr);
-
-				 // Interference with new bus messages is not possible due
-				 // the NSRunLoop processing events and timers serially on a single
-				 // thread.
-				 BOOL status = [mgr start];
-				 if (status) {
-					 VMPInfo(@"Restart of %@ Successful!", mgr);
-				 } else {
-					 VMPError(@"Could not restart %@. Retrying...", mgr);
-				 }
-
-				 return status;
-			 }
-			  initialDelay:initialDelay
-			delayIncrement:delayIncrement
-				  maxDelay:maxDelay];
+	@synchronized(_encoders) {
+		encoder = _encoders[name];
+		if (encoder) {
+			return encoder;
+		}
 
-		break;
-	}
-	default:
-		break;
+		subscriptions = [NSMutableDictionary dictionaryWithCapacity:2];
+		vars = @{
+			@"VIDEOCHANNEL.0" : videoChannel,
+			@"VIDEOCHANNEL.1" : secondaryVideoChannel,
+			@"VIDEOSRC.0" : [self _videoSourceForChannel:videoChannel
+											 elementName:@"channel0"
+										   subscriptions:subscriptions],
+			@"VIDEOSRC.1" : [self _videoSourceForChannel:secondaryVideoChannel
+											 elementName:@"channel1"
+										   subscriptions:subscriptions],
+		};
+		pipeline = [_currentProfile pipelineForSharedEncoderType:@"combined"
+													   variables:vars
+														   error:error];
+		if (!pipeline) {
+			return nil;
+		}
+		pipeline = [pipeline stringByAppendingString:@" ! appsink name=publisher sync=false"];
+
+		encoder = [VMPPipelineManager managerWithLaunchArgs:pipeline channel:name delegate:self];
+		[encoder setPublisher:[self _publisherWithName:name audio:NO]];
+		[encoder setSubscriptions:subscriptions];
+		[encoder setTracer:_tracer];
+		[encoder setQueueMonitor:_queueMonitor];
+		[encoder setMetrics:_metrics];
+		[encoder setStallTimeout:[[_configuration channelStallTimeout] doubleValue]];
+		_encoders[name] = encoder;
+		_encoderChannels[name] = videoChannel;
 	}
-}
 
-#pragma mark - Private methods
+	VMPInfo(@"Created shared encoder %@ for mountpoint %@", name, mountpoint);
+	return encoder;
+}
 
 // Iterate over the channelConfiguration array, create all pipeline managers accordingly, and
 // start them.
+//
+// On-demand channels are only created here, and started by their first consumer.
+//
+// Template substitution is done serially, as configuration errors are reported for the first
+// faulty channel. Parsing, and the state change to PLAYING is done concurrently, as a slow device
+// should not delay the other channels.
 - (BOOL)_startChannelPipelinesWithError:(NSError **)error {
 	NSArray *channels;
+	NSMutableArray<VMPPipelineManager *> *managers;
+	NSMutableDictionary<NSString *, NSNumber *> *substitutionDurations;
+	NSMutableDictionary *channelTimings;
+	gint64 startupBegin, begin;
+	BOOL *results;
 	VMPInfo(@"Starting channel pipelines");
 
+	startupBegin = g_get_monotonic_time();
 	channels = [_configuration channels];
 	VMPDebug(@"Found %lu channels in configuration", [channels count]);
 
+	managers = [NSMutableArray arrayWithCapacity:[channels count]];
+	substitutionDurations = [NSMutableDictionary dictionaryWithCapacity:[channels count]];
+
 	for (VMPConfigChannelModel *channel in channels) {
 		NSString *type, *name;
 		NSDictionary<NSString *, id> *properties;
 		VMPPipelineManager *manager;
 		NSDictionary *vars = nil;
+		NSMutableDictionary *allVars;
 		NSString *pipeline;
+		BOOL isAudio;
 
 		type = [channel type];
 		name = [channel name];
 		properties = [channel properties];
+		isAudio = [type isEqualToString:VMPConfigChannelTypePulseAudio] ||
+				  [type isEqualToString:VMPConfigChannelTypeAudioTest];
 
 		if ([type isEqualToString:VMPConfigChannelTypeV4L2]) {
 			VMPInfo(@"Starting channel %@ of type %@", name, type);
@@ -375,6 +1507,21 @@ static void media_constructed_cb(GstRTSPMediaFactory *factory, GstRTSPMedia *med
 
 			// Substitution dictionary for pipeline template
 			vars = @{@"VIDEOCHANNEL.0" : name, @"DEV" : [device stringValue], @"CON" : connection};
+		} else if (isAudio && [_currentProfile sharedAudio]) {
+			// Audio channels are only captured here if the capture is shared. Otherwise, every
+			// consumer opens the device in its own sub-pipeline.
+			VMPInfo(@"Starting channel %@ of type %@", name, type);
+			if ([type isEqualToString:VMPConfigChannelTypePulseAudio]) {
+				NSString *device = properties[@"device"];
+				if (!device) {
+					CONFIG_ERROR(error, @"pulse channel is missing 'device' property")
+					return NO;
+				}
+
+				vars = @{@"PULSEDEV" : device};
+			} else {
+				vars = @{};
+			}
 		}
 
 		// Skip pipeline creation if type is unknown
@@ -382,40 +1529,181 @@ static void media_constructed_cb(GstRTSPMediaFactory *factory, GstRTSPMedia *med
 			continue;
 		}
 
-		VMPDebug(@"Substitution dictionary for pipeline with name '%@': %@", name, vars);
+		begin = g_get_monotonic_time();
+		if (isAudio) {
+			VMPDebug(@"Substitution dictionary for pipeline with name '%@': %@", name, vars);
+
+			pipeline = [_currentProfile pipelineForSharedAudioType:type variables:vars error:error];
+			pipeline = [pipeline stringByAppendingString:@" ! appsink name=publisher sync=false"];
+		} else {
+			// Sink element for publishing the channel
+			allVars = [vars mutableCopy];
+			allVars[@"VIDEOSINK"] = [self _videoSinkForChannel:name];
+
+			VMPDebug(@"Substitution dictionary for pipeline with name '%@': %@", name, allVars);
 
-		pipeline = [_currentProfile pipelineForChannelType:type variables:vars error:error];
+			pipeline = [_currentProfile pipelineForChannelType:type variables:allVars error:error];
+		}
 		if (!pipeline) {
 			return NO;
 		}
+		substitutionDurations[name] = @((double) (g_get_monotonic_time() - begin) / 1000.0);
 
 		manager = [VMPPipelineManager managerWithLaunchArgs:pipeline channel:name delegate:self];
-		if (![manager start]) {
+		[manager setTracer:_tracer];
+		[manager setQueueMonitor:_queueMonitor];
+		[manager setMetrics:_metrics];
+		[manager setStallTimeout:[[_configuration channelStallTimeout] doubleValue]];
+		if (isAudio || [self _usesNativeChannelBus]) {
+			[manager setPublisher:[self _publisherWithName:name audio:isAudio]];
+		}
+		[managers addObject:manager];
+	}
+
+	if ([[_configuration onDemandChannels] boolValue]) {
+		VMPInfo(@"Channels are started on demand");
+		[_managedPipelines addObjectsFromArray:managers];
+		_startupTimings = @{
+			@"channels" : @{},
+			@"total" : @((double) (g_get_monotonic_time() - startupBegin) / 1000.0),
+		};
+		return YES;
+	}
+
+	// Start all pipelines concurrently. Each block only writes its own slot.
+	results = calloc([managers count], sizeof(BOOL));
+	if (results == NULL) {
+		CONFIG_ERROR(error, @"Failed to allocate memory for channel startup")
+		return NO;
+	}
+
+	dispatch_apply([managers count], dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_HIGH, 0),
+				   ^(size_t i) {
+					   results[i] = [managers[i] start];
+				   });
+
+	channelTimings = [NSMutableDictionary dictionaryWithCapacity:[managers count]];
+	for (NSUInteger i = 0; i < [managers count]; i++) {
+		VMPPipelineManager *manager = managers[i];
+		NSDictionary *stats = [manager statistics];
+		NSDictionary *timing;
+
+		timing = @{
+			@"substitution" : substitutionDurations[[manager channel]],
+			@"parse" : stats[kVMPStatisticsParseDuration],
+			@"stateChange" : stats[kVMPStatisticsStateChangeDuration],
+		};
+		channelTimings[[manager channel]] = timing;
+
+		VMPInfo(@"Startup of channel %@: substitution %@ ms, parse %@ ms, state change %@ ms",
+				[manager channel], timing[@"substitution"], timing[@"parse"],
+				timing[@"stateChange"]);
+	}
+
+	_startupTimings = @{
+		@"channels" : channelTimings,
+		@"total" : @((double) (g_get_monotonic_time() - startupBegin) / 1000.0),
+	};
+	VMPInfo(@"Started %lu channel pipelines in %@ ms", [managers count],
+			_startupTimings[@"total"]);
+
+	// Only manage the channels if all of them started
+	for (NSUInteger i = 0; i < [managers count]; i++) {
+		if (!results[i]) {
+			free(results);
+
+			/* The other pipelines may already be playing, and a failed pipeline may
+			 * still exist. Stop all of them, as they are not managed yet, and their
+			 * bus watches would keep the managers alive.
+			 */
+			for (VMPPipelineManager *manager in managers) {
+				[manager stop];
+			}
 			CONFIG_ERROR(error, @"Failed to start pipeline")
 			return NO;
 		}
+	}
 
-		[_managedPipelines addObject:manager];
-
-		VMPInfo(@"pipeline '%@' for channel %@ started successfully", manager, name);
+	for (NSUInteger i = 0; i < [managers count]; i++) {
+		[_managedPipelines addObject:managers[i]];
+		VMPInfo(@"pipeline '%@' for channel %@ started successfully", managers[i],
+				[managers[i] channel]);
 	}
+	free(results);
 
 	VMPDebug(@"Finished starting channel pipelines");
 	return YES;
 }
 
 /*
-	We use intervideo{src,sink} for separating source, and pipelines managed by the GStreamer
-   RTSP server. Separating audio pipelines is much more difficult, and as of writing this, there
-   is a major bug in the interaudio{src,sink}, which makes multiple listening clients impossible
+	We use intervideo{src,sink}, or the native channel bus (see VMPStreamPublisher) for
+   separating source, and pipelines managed by the GStreamer RTSP server. Separating audio
+   pipelines is much more difficult, and as of writing this, there is a major bug in the
+   interaudio{src,sink}, which makes multiple listening clients impossible
    (see: https://gitlab.freedesktop.org/gstreamer/gst-plugins-bad/-/issues/1788)
 
    Instead, we use the concept of channels for configuration, but use sub-pipelines for audio
    processing for each mountpoint.
 
+   If the profile contains 'sharedAudio' templates, every audio channel is captured once
+   in its own channel pipeline, and published with a VMPStreamPublisher. The sub-pipeline
+   of a mountpoint then starts with an appsrc subscribed to the capture, so all mountpoints
+   and recordings receive the same samples.
+
    This method converts the channel description to a sub-pipeline.
 */
 
+// Stream the media of a mountpoint via multicast if the mountpoint has a "multicast"
+// property. All clients receive the same RTP stream from an address of the pool.
+- (BOOL)_configureMulticastForFactory:(GstRTSPMediaFactory *)factory
+						   mountpoint:(VMPConfigMountpointModel *)mountpoint
+								error:(NSError **)error {
+	NSDictionary *multicast;
+	NSString *addressMin, *addressMax;
+	NSNumber *portMin, *portMax, *ttl;
+	GstRTSPAddressPool *pool;
+	BOOL added;
+
+	multicast = [mountpoint properties][@"multicast"];
+	if (!multicast) {
+		return YES;
+	}
+	if (![multicast isKindOfClass:[NSDictionary class]]) {
+		CONFIG_ERROR(error, @"Mountpoint property 'multicast' is not a dictionary")
+		return NO;
+	}
+
+	addressMin = multicast[@"addressMin"];
+	addressMax = multicast[@"addressMax"] ?: addressMin;
+	portMin = multicast[@"portMin"] ?: @5000;
+	portMax = multicast[@"portMax"] ?: @5999;
+	ttl = multicast[@"ttl"] ?: @1;
+	if (!addressMin) {
+		CONFIG_ERROR(error, @"Multicast mountpoint is missing 'addressMin'")
+		return NO;
+	}
+
+	pool = gst_rtsp_address_pool_new();
+	added = gst_rtsp_address_pool_add_range(
+		pool, [addressMin UTF8String], [addressMax UTF8String], [portMin unsignedShortValue],
+		[portMax unsignedShortValue], [ttl unsignedCharValue]);
+	if (!added) {
+		g_object_unref(pool);
+		CONFIG_ERROR(error, @"Invalid multicast address, or port range")
+		return NO;
+	}
+
+	VMPInfo(@"Mountpoint '%@' streams via multicast (%@-%@, ports %@-%@, ttl %@)",
+			[mountpoint name], addressMin, addressMax, portMin, portMax, ttl);
+
+	gst_rtsp_media_factory_set_address_pool(factory, pool);
+	gst_rtsp_media_factory_set_protocols(factory, GST_RTSP_LOWER_TRANS_UDP_MCAST);
+	gst_rtsp_media_factory_set_max_mcast_ttl(factory, [ttl unsignedIntValue]);
+	g_object_unref(pool);
+
+	return YES;
+}
+
 - (BOOL)_createMountpointsWithError:(NSError **)error {
 	VMPDebug(@"Creating mountpoints");
 	NSArray *mountpoints = [_configuration mountpoints];
@@ -423,6 +1711,7 @@ static void media_constructed_cb(GstRTSPMediaFactory *factory, GstRTSPMedia *med
 	for (VMPConfigMountpointModel *mountpoint in mountpoints) {
 		NSString *name, *type, *path;
 		NSDictionary<NSString *, id> *properties;
+		NSMutableDictionary<NSString *, VMPStreamPublisher *> *subscriptions;
 		_VMPRTSPPipelineState *state;
 
 		name = [mountpoint name];
@@ -434,6 +1723,7 @@ static void media_constructed_cb(GstRTSPMediaFactory *factory, GstRTSPMedia *med
 
 		// Add state object to dictionary
 		_rtspPipelineStates[name] = state;
+		[_metrics setValue:0 forMetric:@"vmp_rtsp_clients" labels:@{@"mountpoint" : name}];
 
 		VMPInfo(@"Creating mountpoint '%@' of type '%@' at path '%@'", name, type, path);
 
@@ -445,6 +1735,7 @@ static void media_constructed_cb(GstRTSPMediaFactory *factory, GstRTSPMedia *med
 			NSString *videoChannel, *secondaryVideoChannel, *audioChannel;
 			NSString *pipeline, *audioPipeline;
 			NSDictionary<NSString *, NSString *> *vars;
+			NSMutableArray<NSString *> *channels;
 
 			videoChannel = properties[@"videoChannel"];
 			secondaryVideoChannel = properties[@"secondaryVideoChannel"];
@@ -455,21 +1746,67 @@ static void media_constructed_cb(GstRTSPMediaFactory *factory, GstRTSPMedia *med
 				return NO;
 			}
 
-			vars = @{
-				@"VIDEOCHANNEL.0" : videoChannel,
-				@"VIDEOCHANNEL.1" : secondaryVideoChannel,
-			};
+			subscriptions = [NSMutableDictionary dictionaryWithCapacity:3];
+			if ([_currentProfile sharedEncoders][@"combined"]) {
+				// Consume the encoded stream of a shared compositor
+				VMPPipelineManager *encoder;
+
+				encoder = [self _sharedEncoderForCombinedMountpoint:name
+													   videoChannel:videoChannel
+											  secondaryVideoChannel:secondaryVideoChannel
+															  error:error];
+				if (!encoder) {
+					return NO;
+				}
 
-			pipeline = [_currentProfile pipelineForMountpointType:type variables:vars error:error];
-			if (!pipeline) {
-				return NO;
+				pipeline = [_currentProfile pipelineForSharedEncoderType:@"mountpoint"
+															   variables:@{}
+																   error:error];
+				if (!pipeline) {
+					return NO;
+				}
+				pipeline = [NSString
+					stringWithFormat:@"appsrc name=video0 is-live=true format=time ! %@", pipeline];
+
+				channels = [NSMutableArray
+					arrayWithObjects:videoChannel, secondaryVideoChannel, [encoder channel], nil];
+				subscriptions[@"video0"] = [encoder publisher];
+			} else {
+				vars = @{
+					@"VIDEOCHANNEL.0" : videoChannel,
+					@"VIDEOCHANNEL.1" : secondaryVideoChannel,
+					@"VIDEOSRC.0" : [self _videoSourceForChannel:videoChannel
+													 elementName:@"channel0"
+												   subscriptions:subscriptions],
+					@"VIDEOSRC.1" : [self _videoSourceForChannel:secondaryVideoChannel
+													 elementName:@"channel1"
+												   subscriptions:subscriptions],
+				};
+
+				pipeline = [_currentProfile pipelineForMountpointType:type
+															variables:vars
+																error:error];
+				if (!pipeline) {
+					return NO;
+				}
+
+				channels =
+					[NSMutableArray arrayWithObjects:videoChannel, secondaryVideoChannel, nil];
 			}
 
-			audioPipeline = [self _pipelineFromAudioChannel:audioChannel error:error];
+			audioPipeline = [self _pipelineFromAudioChannel:audioChannel
+											  subscriptions:subscriptions
+													  error:error];
 			if (!audioPipeline) {
 				return NO;
 			}
 
+			if (subscriptions[@"audio"]) {
+				[channels addObject:audioChannel];
+			}
+			[state setChannels:channels];
+			[state setSubscriptions:subscriptions];
+
 			VMPDebug(@"Video-only mountpoint pipeline: %@", pipeline);
 
 			pipeline = [NSString stringWithFormat:@"%@ %@", pipeline, audioPipeline];
@@ -482,6 +1819,10 @@ static void media_constructed_cb(GstRTSPMediaFactory *factory, GstRTSPMedia *med
 			gst_rtsp_media_factory_set_shared(factory, TRUE);
 
 			gst_rtsp_media_factory_set_launch(factory, (const gchar *) [pipeline UTF8String]);
+			if (![self _configureMulticastForFactory:factory mountpoint:mountpoint error:error]) {
+				g_object_unref(factory);
+				return NO;
+			}
 			g_signal_connect(factory, "media-constructed", (GCallback) media_constructed_cb,
 							 (__bridge void *) state);
 			gst_rtsp_mount_points_add_factory(_mountPoints, (const gchar *) [path UTF8String],
@@ -491,6 +1832,7 @@ static void media_constructed_cb(GstRTSPMediaFactory *factory, GstRTSPMedia *med
 			NSString *videoChannel, *audioChannel;
 			NSString *pipeline, *audioPipeline;
 			NSDictionary<NSString *, NSString *> *vars;
+			NSMutableArray<NSString *> *channels;
 
 			videoChannel = properties[@"videoChannel"];
 			audioChannel = properties[@"audioChannel"];
@@ -504,20 +1846,66 @@ static void media_constructed_cb(GstRTSPMediaFactory *factory, GstRTSPMedia *med
 			// Only create one pipeline and share it with other clients
 			gst_rtsp_media_factory_set_shared(factory, TRUE);
 
-			vars = @{
-				@"VIDEOCHANNEL.0" : videoChannel,
-			};
+			subscriptions = [NSMutableDictionary dictionaryWithCapacity:2];
+			if ([_currentProfile sharedEncoders]) {
+				// Consume the encoded stream of a shared encoder
+				VMPPipelineManager *encoder;
+				NSNumber *width, *height, *bitrate;
+
+				width = properties[@"width"] ?: @1920;
+				height = properties[@"height"] ?: @1080;
+				bitrate = properties[@"bitrate"] ?: @2500;
+
+				encoder = [self _sharedEncoderForChannel:videoChannel
+												   width:width
+												  height:height
+												 bitrate:bitrate
+												   error:error];
+				if (!encoder) {
+					return NO;
+				}
 
-			pipeline = [_currentProfile pipelineForMountpointType:type variables:vars error:error];
-			if (!pipeline) {
-				return NO;
+				pipeline = [_currentProfile pipelineForSharedEncoderType:@"mountpoint"
+															   variables:@{}
+																   error:error];
+				if (!pipeline) {
+					return NO;
+				}
+				pipeline = [NSString
+					stringWithFormat:@"appsrc name=video0 is-live=true format=time ! %@", pipeline];
+
+				channels = [NSMutableArray arrayWithObjects:videoChannel, [encoder channel], nil];
+				subscriptions[@"video0"] = [encoder publisher];
+			} else {
+				vars = @{
+					@"VIDEOCHANNEL.0" : videoChannel,
+					@"VIDEOSRC.0" : [self _videoSourceForChannel:videoChannel
+													 elementName:@"channel0"
+												   subscriptions:subscriptions],
+				};
+				channels = [NSMutableArray arrayWithObject:videoChannel];
+
+				pipeline = [_currentProfile pipelineForMountpointType:type
+															variables:vars
+																error:error];
+				if (!pipeline) {
+					return NO;
+				}
 			}
 
-			audioPipeline = [self _pipelineFromAudioChannel:audioChannel error:error];
+			audioPipeline = [self _pipelineFromAudioChannel:audioChannel
+											  subscriptions:subscriptions
+													  error:error];
 			if (!audioPipeline) {
 				return NO;
 			}
 
+			if (subscriptions[@"audio"]) {
+				[channels addObject:audioChannel];
+			}
+			[state setChannels:channels];
+			[state setSubscriptions:subscriptions];
+
 			VMPDebug(@"Video-only single mountpoint pipeline: %@", pipeline);
 
 			pipeline = [NSString stringWithFormat:@"%@ %@", pipeline, audioPipeline];
@@ -525,6 +1913,10 @@ static void media_constructed_cb(GstRTSPMediaFactory *factory, GstRTSPMedia *med
 			VMPDebug(@"Combined single mountpoint pipeline: %@", pipeline);
 
 			gst_rtsp_media_factory_set_launch(factory, (const gchar *) [pipeline UTF8String]);
+			if (![self _configureMulticastForFactory:factory mountpoint:mountpoint error:error]) {
+				g_object_unref(factory);
+				return NO;
+			}
 
 			g_signal_connect(factory, "media-constructed", (GCallback) media_constructed_cb,
 							 (__bridge void *) state);
@@ -538,9 +1930,35 @@ static void media_constructed_cb(GstRTSPMediaFactory *factory, GstRTSPMedia *med
 	return YES;
 }
 
-- (NSString *)_pipelineFromAudioChannel:(NSString *)channel error:(NSError **)error {
+- (NSString *)_pipelineFromAudioChannel:(NSString *)channel
+						  subscriptions:
+							  (NSMutableDictionary<NSString *, VMPStreamPublisher *> *)subscriptions
+								  error:(NSError **)error {
 	NSArray *channels;
 
+	if ([_currentProfile sharedAudio]) {
+		VMPPipelineManager *capture;
+		NSString *pipeline;
+
+		capture = [self pipelineManagerForChannel:channel];
+		if (![capture publisher]) {
+			VMP_FAST_ERROR(error, VMPErrorCodeConfigurationError,
+						   @"Audio channel '%@' is not defined in channel config", channel);
+			return nil;
+		}
+
+		pipeline = [_currentProfile pipelineForSharedAudioType:@"mountpoint"
+													 variables:@{}
+														 error:error];
+		if (!pipeline) {
+			return nil;
+		}
+
+		subscriptions[@"audio"] = [capture publisher];
+		return [NSString stringWithFormat:@"appsrc name=audio is-live=true format=time ! %@",
+										  pipeline];
+	}
+
 	channels = [_configuration channels];
 
 	for (VMPConfigChannelModel *chan in channels) {
@@ -586,6 +2004,129 @@ static void media_constructed_cb(GstRTSPMediaFactory *factory, GstRTSPMedia *med
 	return nil;
 }
 
+// Segment mountpoints into HLS playlists. The egress pipelines consume the encoded stream
+// of the shared encoder, and the shared audio capture of the mountpoint, and keep them
+// running.
+//
+// Must be called after the mountpoints were created.
+- (BOOL)_startHLSPipelinesWithError:(NSError **)error {
+	VMPConfigHLSModel *hls;
+	NSFileManager *fileManager;
+	NSCharacterSet *slashes;
+	NSUInteger segmentDuration, playlistLength;
+
+	hls = [_configuration hls];
+	if (!hls) {
+		return YES;
+	}
+
+	fileManager = [NSFileManager defaultManager];
+	slashes = [NSCharacterSet characterSetWithCharactersInString:@"/"];
+	segmentDuration = [[hls segmentDuration] unsignedIntegerValue];
+	playlistLength = [[hls playlistLength] unsignedIntegerValue];
+
+	for (VMPConfigMountpointModel *mountpoint in [_configuration mountpoints]) {
+		NSString *name, *managerName, *relativePath, *directory;
+		NSString *videoPipeline, *audioPipeline;
+		NSMutableString *pipeline;
+		NSDictionary<NSString *, VMPStreamPublisher *> *subscriptions;
+		_VMPRTSPPipelineState *state;
+		VMPPipelineManager *manager;
+
+		name = [mountpoint name];
+		if ([hls mountpoints] && ![[hls mountpoints] containsObject:name]) {
+			continue;
+		}
+
+		state = _rtspPipelineStates[name];
+		subscriptions = [state subscriptions];
+		if (!subscriptions[@"video0"] || !subscriptions[@"audio"]) {
+			VMP_FAST_ERROR(error, VMPErrorCodeConfigurationError,
+						   @"HLS for mountpoint '%@' requires shared encoders, and shared audio "
+						   @"in the profile",
+						   name);
+			return NO;
+		}
+
+		relativePath = [[mountpoint path] stringByTrimmingCharactersInSet:slashes];
+		directory = [[hls directory] stringByAppendingPathComponent:relativePath];
+		if (![fileManager createDirectoryAtPath:directory
+					withIntermediateDirectories:YES
+									 attributes:nil
+										  error:error]) {
+			return NO;
+		}
+
+		videoPipeline = [_currentProfile pipelineForSharedEncoderType:@"recording"
+															variables:@{}
+																error:error];
+		if (!videoPipeline) {
+			return NO;
+		}
+		audioPipeline = [_currentProfile pipelineForSharedAudioType:@"recording"
+														  variables:@{@"BITRATE" : @"96000"}
+															  error:error];
+		if (!audioPipeline) {
+			return NO;
+		}
+
+		// hlssink2 cuts segments at key frames. Its key frame requests are forwarded to the
+		// shared encoder by the publisher.
+		pipeline = [NSMutableString
+			stringWithFormat:@"appsrc name=video0 is-live=true format=time ! %@", videoPipeline];
+		[pipeline appendFormat:@" ! hlssink2 name=hls location=\"%@/segment%%05d.ts\"", directory];
+		[pipeline appendFormat:@" playlist-location=\"%@/index.m3u8\"", directory];
+		[pipeline appendFormat:@" target-duration=%lu playlist-length=%lu max-files=%lu",
+							   segmentDuration, playlistLength, playlistLength * 2];
+		[pipeline appendFormat:@" appsrc name=audio is-live=true format=time ! %@", audioPipeline];
+		[pipeline appendString:@" ! aacparse ! hls.audio"];
+
+		VMPDebug(@"HLS pipeline for mountpoint %@: %@", name, pipeline);
+
+		managerName = [NSString stringWithFormat:@"_hls_%@", name];
+		manager = [VMPPipelineManager managerWithLaunchArgs:pipeline
+													channel:managerName
+												   delegate:self];
+		[manager setSubscriptions:subscriptions];
+		[manager setTracer:_tracer];
+		[manager setQueueMonitor:_queueMonitor];
+		[manager setMetrics:_metrics];
+		[manager setStallTimeout:[[_configuration channelStallTimeout] doubleValue]];
+		_hlsPipelines[managerName] = manager;
+		_hlsPlaylists[managerName] =
+			[NSString stringWithFormat:@"/hls/%@/index.m3u8", relativePath];
+
+		// The egress is a permanent consumer of the channels, and encoders of the mountpoint
+		[self _acquireChannels:[state channels]];
+
+		VMPInfo(@"Starting HLS egress for mountpoint %@ in %@", name, directory);
+		if (![manager start]) {
+			VMPError(@"Failed to start HLS egress for mountpoint %@", name);
+			[self _scheduleRestartForManager:manager];
+		}
+	}
+
+	return YES;
+}
+
+- (NSArray *)_hlsStatistics {
+	NSMutableArray *egress = [NSMutableArray arrayWithCapacity:[_hlsPipelines count]];
+
+	for (NSString *name in _hlsPipelines) {
+		VMPPipelineManager *mgr = _hlsPipelines[name];
+		NSMutableDictionary *cur;
+
+		cur = [NSMutableDictionary dictionaryWithDictionary:[mgr statistics]];
+		cur[@"name"] = name;
+		cur[@"state"] = [mgr state];
+		cur[@"playlist"] = _hlsPlaylists[name];
+
+		[egress addObject:cur];
+	}
+
+	return egress;
+}
+
 #pragma mark - Public methods
 
 - (NSData *)dotGraphForMountPointName:(NSString *)name {
@@ -596,7 +2137,29 @@ static void media_constructed_cb(GstRTSPMediaFactory *factory, GstRTSPMedia *med
 		return nil;
 	}
 
-	return [state lastDotGraph];
+	return [state dotGraph];
+}
+
+- (NSDictionary *)analysisForMountpointName:(NSString *)name {
+	return [_rtspPipelineStates[name] analysis];
+}
+
+- (VMPElementModel *)topologyForMountpointName:(NSString *)name {
+	_VMPRTSPPipelineState *state;
+	VMPElementModel *model;
+	GstElement *element;
+
+	state = _rtspPipelineStates[name];
+	// Transfer: Full
+	element = [state lastElement];
+	if (element == NULL) {
+		return nil;
+	}
+
+	model = [VMPElementModel modelWithGstElement:element];
+	gst_object_unref(element);
+
+	return model;
 }
 
 - (VMPPipelineManager *)pipelineManagerForChannel:(NSString *)channel {
@@ -606,7 +2169,156 @@ static void media_constructed_cb(GstRTSPMediaFactory *factory, GstRTSPMedia *med
 		}
 	}
 
-	return nil;
+	if (_hlsPipelines[channel]) {
+		return _hlsPipelines[channel];
+	}
+
+	@synchronized(_encoders) {
+		return _encoders[channel];
+	}
+}
+
+- (NSArray<NSDictionary *> *)clientStatisticsForMountpointName:(NSString *)name {
+	NSArray<VMPConfigMountpointModel *> *mountpoints;
+	NSMutableArray<NSDictionary *> *result;
+	GList *clients;
+
+	mountpoints = [_configuration mountpoints];
+	if (name) {
+		VMPConfigMountpointModel *mountpoint = nil;
+
+		for (VMPConfigMountpointModel *cur in mountpoints) {
+			if ([[cur name] isEqualToString:name]) {
+				mountpoint = cur;
+				break;
+			}
+		}
+		if (!mountpoint) {
+			return nil;
+		}
+		mountpoints = @[ mountpoint ];
+	}
+
+	result = [NSMutableArray array];
+
+	// Transfer: Full
+	clients = gst_rtsp_server_client_filter(_server, NULL, NULL);
+	for (GList *c = clients; c != NULL; c = c->next) {
+		GstRTSPClient *client = c->data;
+		GstRTSPConnection *connection;
+		NSString *address = @"unknown";
+		GList *sessions;
+
+		connection = gst_rtsp_client_get_connection(client);
+		if (connection && gst_rtsp_connection_get_ip(connection)) {
+			address = [NSString stringWithUTF8String:gst_rtsp_connection_get_ip(connection)];
+		}
+
+		sessions = gst_rtsp_client_session_filter(client, NULL, NULL);
+		for (GList *s = sessions; s != NULL; s = s->next) {
+			GList *medias;
+
+			medias = gst_rtsp_session_filter(s->data, NULL, NULL);
+			for (GList *m = medias; m != NULL; m = m->next) {
+				NSDictionary *stats;
+
+				stats = [self _statisticsForSessionMedia:m->data
+												 session:s->data
+												 address:address
+											 mountpoints:mountpoints];
+				if (stats) {
+					[result addObject:stats];
+				}
+			}
+			g_list_free_full(medias, g_object_unref);
+		}
+		g_list_free_full(sessions, g_object_unref);
+	}
+	g_list_free_full(clients, g_object_unref);
+
+	return result;
+}
+
+- (NSDictionary *)globalStatistics {
+	NSMutableArray *pipelines = [NSMutableArray arrayWithCapacity:[_managedPipelines count]];
+	NSMutableDictionary *statistics;
+
+	for (VMPPipelineManager *mgr in _managedPipelines) {
+		NSMutableDictionary *cur;
+		NSString *type = @"unknown";
+
+		for (VMPConfigChannelModel *channel in [_configuration channels]) {
+			if ([[channel name] isEqualToString:[mgr channel]]) {
+				type = [channel type];
+				break;
+			}
+		}
+
+		cur = [NSMutableDictionary dictionaryWithDictionary:[mgr statistics]];
+		cur[@"name"] = [mgr channel];
+		cur[@"type"] = type;
+		cur[@"state"] = [mgr state];
+		cur[@"consumers"] = @([self _consumerCountForChannel:[mgr channel]]);
+		if ([mgr publisher]) {
+			cur[@"channelBus"] = [[mgr publisher] statistics];
+		}
+
+		[pipelines addObject:cur];
+	}
+
+	statistics = [NSMutableDictionary dictionaryWithDictionary:@{
+		@"managed_pipelines" : pipelines,
+		@"shared_encoders" : [self _sharedEncoderStatistics],
+		@"hls" : [self _hlsStatistics],
+		@"rtsp" : [self _rtspStatistics],
+		@"bus_messages" : [self _busMessageStatistics],
+	}];
+	if (_queueMonitor) {
+		statistics[@"queues"] = [_queueMonitor statistics];
+	}
+
+	return statistics;
+}
+
+// Statistics of all shared encoders, and the number of running encoders per channel. A
+// channel consumed by several mountpoints, or recordings with the same configuration is
+// encoded once.
+- (NSDictionary *)_sharedEncoderStatistics {
+	NSMutableDictionary<NSString *, NSNumber *> *perChannel;
+	NSMutableArray *encoders;
+	NSArray<VMPPipelineManager *> *managers;
+	NSDictionary<NSString *, NSString *> *encoderChannels;
+
+	@synchronized(_encoders) {
+		managers = [_encoders allValues];
+		encoderChannels = [_encoderChannels copy];
+	}
+
+	perChannel = [NSMutableDictionary dictionaryWithCapacity:[[_configuration channels] count]];
+	encoders = [NSMutableArray arrayWithCapacity:[managers count]];
+
+	for (VMPConfigChannelModel *channel in [_configuration channels]) {
+		perChannel[[channel name]] = @0;
+	}
+
+	for (VMPPipelineManager *mgr in managers) {
+		NSMutableDictionary *cur;
+		NSString *channel = encoderChannels[[mgr channel]];
+
+		cur = [NSMutableDictionary dictionaryWithDictionary:[mgr statistics]];
+		[cur addEntriesFromDictionary:[[mgr publisher] statistics]];
+		cur[@"name"] = [mgr channel];
+		cur[@"channel"] = channel;
+		cur[@"state"] = [mgr state];
+		cur[@"consumers"] = @([self _consumerCountForChannel:[mgr channel]]);
+		[encoders addObject:cur];
+
+		if ([[mgr state] isEqualToString:kVMPStatePlaying]) {
+			perChannel[channel] = @([perChannel[channel] unsignedIntegerValue] + 1);
+		}
+	}
+
+	return @{@"encoders" : encoders, @"encodersPerChannel" : perChannel};
 }
 
 - (NSArray *)channelInfo {
@@ -636,9 +2348,22 @@ static void media_constructed_cb(GstRTSPMediaFactory *factory, GstRTSPMedia *med
 		return NO;
 	}
 
+	// Start the HLS egress of the mountpoints
+	if (![self _startHLSPipelinesWithError:error]) {
+		return NO;
+	}
+
 	// Start the RTSP server
 	_serverSourceId = gst_rtsp_server_attach(_server, NULL);
 
+	// Remove expired sessions
+	GstRTSPSessionPool *sessionPool = gst_rtsp_server_get_session_pool(_server);
+	GSource *cleanup = gst_rtsp_session_pool_create_watch(sessionPool);
+	g_source_set_callback(cleanup, (GSourceFunc) session_pool_cleanup_cb, NULL, NULL);
+	_sessionCleanupSourceId = g_source_attach(cleanup, NULL);
+	g_source_unref(cleanup);
+	g_object_unref(sessionPool);
+
 	VMPInfo(@"RTSP server listening on address '%@' on port '%@'", [_configuration rtspAddress],
 			[_configuration rtspPort]);
 
@@ -648,13 +2373,28 @@ static void media_constructed_cb(GstRTSPMediaFactory *factory, GstRTSPMedia *med
 - (void)stop {
 	VMPInfo(@"Stopping RTSP server...");
 
+	// Stop the HLS egress before its sources
+	for (VMPPipelineManager *mgr in [_hlsPipelines allValues]) {
+		VMPInfo(@"Stopping HLS egress %@", [mgr channel]);
+		[mgr stop];
+	}
+
 	// Stop all pipelines
 	for (VMPPipelineManager *mgr in _managedPipelines) {
 		VMPInfo(@"Stopping pipeline for channel %@", [mgr channel]);
 		[mgr stop];
 	}
+	@synchronized(_encoders) {
+		for (VMPPipelineManager *mgr in [_encoders allValues]) {
+			VMPInfo(@"Stopping shared encoder %@", [mgr channel]);
+			[mgr stop];
+		}
+	}
+
+	[_queueMonitor invalidate];
 
 	// Stop the RTSP server
+	g_source_remove(_sessionCleanupSourceId);
 	g_source_remove(_serverSourceId);
 
 	return;
@@ -696,7 +2436,9 @@ static void media_constructed_cb(GstRTSPMediaFactory *factory, GstRTSPMedia *med
 		return nil;
 	}
 
-	if (![[audio type] isEqualToString:VMPConfigChannelTypePulseAudio]) {
+	// A shared capture is available for every audio channel type
+	if (![_currentProfile sharedAudio] &&
+		![[audio type] isEqualToString:VMPConfigChannelTypePulseAudio]) {
 		CONFIG_ERROR(error, @"Currently, only audio channels of type 'pulse' are supported");
 		return nil;
 	}
@@ -713,7 +2455,7 @@ static void media_constructed_cb(GstRTSPMediaFactory *factory, GstRTSPMedia *med
 	audioBitrate = [NSNumber numberWithUnsignedLong:[audioBitrate unsignedLongValue] * 1000];
 
 	pulseDevice = [audio properties][@"device"];
-	if (!pulseDevice) {
+	if (!pulseDevice && ![_currentProfile sharedAudio]) {
 		CONFIG_ERROR(error, @"'device' key missing in audio channel configuration");
 		return nil;
 	}
@@ -735,39 +2477,88 @@ static void media_constructed_cb(GstRTSPMediaFactory *factory, GstRTSPMedia *med
 	NSDictionary<NSString *, NSString *> *vars;
 	NSString *template;
 	NSMutableString *pipeline;
+	VMPPipelineManager *encoder = nil;
+	VMPPipelineManager *capture = nil;
+	NSMutableDictionary<NSString *, VMPStreamPublisher *> *subscriptions;
+	NSMutableArray<NSString *> *consumedChannels;
+
+	subscriptions = [NSMutableDictionary dictionaryWithCapacity:2];
+
+	if ([_currentProfile sharedEncoders]) {
+		// Consume the encoded stream of a shared encoder
+		encoder = [self _sharedEncoderForChannel:videoChannel
+										   width:width
+										  height:height
+										 bitrate:videoBitrate
+										   error:error];
+		if (!encoder) {
+			return nil;
+		}
 
-	template = [_currentProfile recordings][@"video"];
-	if (!template) {
-		CONFIG_ERROR(error, @"'video' key not present in 'recordings' profile");
-		return nil;
-	}
+		template = [_currentProfile pipelineForSharedEncoderType:@"recording"
+													   variables:@{}
+														   error:error];
+		if (!template) {
+			return nil;
+		}
+		template = [NSString stringWithFormat:@"appsrc name=video is-live=true format=time ! %@",
+											  template];
+	} else {
+		template = [_currentProfile recordings][@"video"];
+		if (!template) {
+			CONFIG_ERROR(error, @"'video' key not present in 'recordings' profile");
+			return nil;
+		}
 
-	// Substitution dictionary for video pipeline
-	vars = @{
-		@"VIDEOCHANNEL" : videoChannel,
-		@"WIDTH" : [width stringValue],
-		@"HEIGHT" : [height stringValue],
-		@"BITRATE" : [videoBitrate stringValue]
-	};
-	template = [template stringBySubstitutingVariables:vars error:error];
-	if (!template) {
-		return nil;
+		// Substitution dictionary for video pipeline
+		vars = @{
+			@"VIDEOCHANNEL" : videoChannel,
+			@"VIDEOSRC" : [self _videoSourceForChannel:videoChannel
+										   elementName:@"channel"
+										 subscriptions:subscriptions],
+			@"WIDTH" : [width stringValue],
+			@"HEIGHT" : [height stringValue],
+			@"BITRATE" : [videoBitrate stringValue]
+		};
+		template = [template stringBySubstitutingVariables:vars error:error];
+		if (!template) {
+			return nil;
+		}
 	}
 
 	pipeline = [template mutableCopy];
 	[pipeline appendFormat:@" ! matroskamux name=mux !	filesink location=%@ ", [path path]];
 
-	template = [_currentProfile recordings][@"pulse"];
-	if (!template) {
-		CONFIG_ERROR(error, @"'pulse' key not present in 'recordings' profile");
-		return nil;
-	}
+	if ([_currentProfile sharedAudio]) {
+		// Consume the shared capture of the audio channel
+		capture = [self pipelineManagerForChannel:audioChannel];
+		if (![capture publisher]) {
+			CONFIG_ERROR(error, @"No shared capture for audio channel");
+			return nil;
+		}
 
-	// Substitution directory for audio pipeline
-	vars = @{@"PULSEDEV" : pulseDevice, @"BITRATE" : [audioBitrate stringValue]};
-	template = [template stringBySubstitutingVariables:vars error:error];
-	if (!template) {
-		return nil;
+		vars = @{@"BITRATE" : [audioBitrate stringValue]};
+		template = [_currentProfile pipelineForSharedAudioType:@"recording"
+													 variables:vars
+														 error:error];
+		if (!template) {
+			return nil;
+		}
+		template = [NSString stringWithFormat:@"appsrc name=audio is-live=true format=time ! %@",
+											  template];
+	} else {
+		template = [_currentProfile recordings][@"pulse"];
+		if (!template) {
+			CONFIG_ERROR(error, @"'pulse' key not present in 'recordings' profile");
+			return nil;
+		}
+
+		// Substitution directory for audio pipeline
+		vars = @{@"PULSEDEV" : pulseDevice, @"BITRATE" : [audioBitrate stringValue]};
+		template = [template stringBySubstitutingVariables:vars error:error];
+		if (!template) {
+			return nil;
+		}
 	}
 
 	[pipeline appendString:template];
@@ -780,10 +2571,25 @@ static void media_constructed_cb(GstRTSPMediaFactory *factory, GstRTSPMedia *med
 	   filesink location=<PATH> <AUDIO_PIPELINE> ! mux. -e
 	*/
 
-	return [VMPRecordingManager recorderWithLaunchArgs:pipeline
-												  path:path
-										   recordUntil:date
-											  delegate:self];
+	VMPRecordingManager *recording;
+
+	recording = [VMPRecordingManager recorderWithLaunchArgs:pipeline
+													   path:path
+												recordUntil:date
+												   delegate:self];
+	consumedChannels = [NSMutableArray arrayWithObject:videoChannel];
+	if (encoder) {
+		[consumedChannels addObject:[encoder channel]];
+		subscriptions[@"video"] = [encoder publisher];
+	}
+	if (capture) {
+		[consumedChannels addObject:audioChannel];
+		subscriptions[@"audio"] = [capture publisher];
+	}
+	[recording setConsumedChannels:consumedChannels];
+	[recording setSubscriptions:subscriptions];
+
+	return recording;
 }
 
 /*
@@ -824,7 +2630,10 @@ static void media_constructed_cb(GstRTSPMediaFactory *factory, GstRTSPMedia *med
 
 	@synchronized(self) {
 		[_activeRecordings addObject:recording];
+		[_metrics setValue:[_activeRecordings count] forMetric:@"vmp_recordings_active" labels:@{}];
 	}
+	// The recording consumes the channels from its start
+	[self _acquireChannels:[recording consumedChannels] waitUntilDone:YES];
 
 	dispatchTime = dispatch_time(DISPATCH_TIME_NOW, (int64_t) (interval * NSEC_PER_SEC));
 
@@ -853,14 +2662,20 @@ static void media_constructed_cb(GstRTSPMediaFactory *factory, GstRTSPMedia *med
 
 		@synchronized(self) {
 			[_activeRecordings removeObject:recording];
+			[_metrics setValue:[_activeRecordings count]
+					 forMetric:@"vmp_recordings_active"
+						labels:@{}];
 		}
+		[self _releaseChannels:[recording consumedChannels]];
 	});
 
 	return YES;
 }
 
 - (NSArray<VMPRecordingManager *> *)recordings {
-	return [_activeRecordings copy];
+	@synchronized(self) {
+		return [_activeRecordings copy];
+	}
 }
 
 - (void)dealloc {
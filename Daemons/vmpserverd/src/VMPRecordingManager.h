@@ -34,6 +34,12 @@
 
 @property (atomic, assign) BOOL eosReceived;
 
+/**
+ * Names of the channels consumed by this recording. On-demand
+ * channels are kept running while the recording is active.
+ */
+@property (nonatomic, copy, nullable) NSArray<NSString *> *consumedChannels;
+
 + (instancetype)recorderWithLaunchArgs:(NSString *)launchArgs
 								  path:(NSURL *)path
 						   recordUntil:(NSDate *)date
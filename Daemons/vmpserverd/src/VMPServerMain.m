@@ -5,77 +5,41 @@
  */
 
 #import <MicroHTTPKit/MicroHTTPKit.h>
+#import <dispatch/dispatch.h>
 #import <glib.h>
 
 #import "VMPCalendarSync.h"
 #import "VMPConfigModel.h"
+#import "VMPGraphRenderer.h"
 #import "VMPJournal.h"
+#import "VMPLoopWatchdog.h"
+#import "VMPMetrics.h"
 #import "VMPProfileManager.h"
 #import "VMPRTSPServer.h"
 #import "VMPServerMain.h"
 
-#import <graphviz/cgraph.h>
-#import <graphviz/gvc.h>
+#include <errno.h>
 
 #include "config.h"
 
-// Convert a DOT graph to SVG
-static NSData *convertDOTtoSVG(NSData *dotData, NSError **error) {
-	NSData *svgData;
-	GVC_t *gvc;
-	Agraph_t *g;
-	char *rendered;
-	unsigned int length;
-
-	// Initialize Graphviz context
-	gvc = gvContext();
-	if (!gvc) {
-		VMP_FAST_ERROR(error, VMPErrorCodeGraphvizError, @"Failed to initialize Graphviz context");
-		return nil;
-	}
-
-	// Create a graph from the DOT data
-	g = agmemread((char *) [dotData bytes]);
-	if (!g) {
-		VMP_FAST_ERROR(error, VMPErrorCodeGraphvizError, @"Failed to create graph from DOT data");
-		gvFreeContext(gvc);
-		return nil;
-	}
-
-	if (gvLayout(gvc, g, "dot") != 0) {
-		VMP_FAST_ERROR(error, VMPErrorCodeGraphvizError, @"Failed to layout graph");
-		agclose(g);
-		gvFreeContext(gvc);
-		return nil;
-	}
-
-	if (gvRenderData(gvc, g, "svg", &rendered, &length) != 0) {
-		VMP_FAST_ERROR(error, VMPErrorCodeGraphvizError, @"Failed to render graph to SVG");
-		gvFreeLayout(gvc, g);
-		agclose(g);
-		gvFreeContext(gvc);
-		return nil;
-	}
-
-	svgData = [NSData dataWithBytes:rendered length:length];
-
-	// Clean up
-	gvFreeRenderData(rendered);
-	gvFreeLayout(gvc, g);
-	agclose(g);
-	gvFreeContext(gvc);
-
-	return svgData;
-}
-
 @implementation VMPServerMain {
 	VMPRTSPServer *_rtspServer;
 	VMPCalendarSync *_calendarSync;
 	VMPProfileManager *_profileMgr;
 	HKHTTPServer *_httpServer;
+	VMPGraphRenderer *_graphRenderer;
+	VMPLoopWatchdog *_loopWatchdog;
 	NSString *_version;
 	NSDate *_startedAtDate;
 	NSString *_startedAtDateISO8601;
+	// Duration of profile discovery and selection in milliseconds
+	double _profileLoadDuration;
+
+	// GLib main loop dispatching the default main context
+	GMainLoop *_glibMainLoop;
+	NSThread *_glibThread;
+	// Keeps the main run loop running, as it has no other sources
+	NSTimer *_keepAliveTimer;
 }
 
 #define DEFAULT_HEADERS                                                                            \
@@ -110,8 +74,11 @@ static NSData *convertDOTtoSVG(NSData *dotData, NSError **error) {
 	self = [super init];
 	if (self) {
 		_configuration = configuration;
+		HKHTTPServerConfiguration *httpConfiguration;
 		NSUInteger port;
+		gint64 begin;
 
+		begin = g_get_monotonic_time();
 		if (platform) {
 			_profileMgr = [VMPProfileManager managerWithPath:[configuration profileDirectory]
 											 runtimePlatform:platform
@@ -123,6 +90,8 @@ static NSData *convertDOTtoSVG(NSData *dotData, NSError **error) {
 		if (!_profileMgr) {
 			return nil;
 		}
+		_profileLoadDuration = (double) (g_get_monotonic_time() - begin) / 1000.0;
+		VMPInfo(@"Loaded profiles in %.2f ms", _profileLoadDuration);
 
 		_version =
 			[NSString stringWithFormat:@"%d.%d.%d", MAJOR_VERSION, MINOR_VERSION, PATCH_VERSION];
@@ -138,8 +107,32 @@ static NSData *convertDOTtoSVG(NSData *dotData, NSError **error) {
 
 		// Create HTTP server
 		port = [[configuration httpPort] integerValue];
+		httpConfiguration = [HKHTTPServerConfiguration defaultConfiguration];
+		if ([[configuration httpThreadingModel] isEqualToString:VMPConfigHTTPThreadingPool]) {
+			[httpConfiguration setThreadingModel:HKHTTPServerThreadingModelThreadPool];
+		} else if ([[configuration httpThreadingModel]
+					   isEqualToString:VMPConfigHTTPThreadingPerConnection]) {
+			[httpConfiguration setThreadingModel:HKHTTPServerThreadingModelThreadPerConnection];
+		}
+		if ([[configuration httpPollingMode] isEqualToString:@"poll"]) {
+			[httpConfiguration setPollingMode:HKHTTPServerPollingModePoll];
+		} else if ([[configuration httpPollingMode] isEqualToString:@"epoll"]) {
+			[httpConfiguration setPollingMode:HKHTTPServerPollingModeEpoll];
+		}
+		[httpConfiguration
+			setThreadPoolSize:[[configuration httpThreadPoolSize] unsignedIntegerValue]];
+		[httpConfiguration
+			setConnectionLimit:[[configuration httpConnectionLimit] unsignedIntegerValue]];
+		[httpConfiguration setPerIPConnectionLimit:[[configuration httpPerIPConnectionLimit]
+													   unsignedIntegerValue]];
+		[httpConfiguration
+			setConnectionTimeout:[[configuration httpConnectionTimeout] unsignedIntegerValue]];
+		VMPDebug(@"HTTP server configuration: %@", httpConfiguration);
+
 		// We install HTTP handlers later on when -runWithError: is invoked
-		_httpServer = [HKHTTPServer serverWithPort:port];
+		_httpServer = [HKHTTPServer serverWithPort:port configuration:httpConfiguration];
+		// Pipeline graphs are rendered with Graphviz on a background queue
+		_graphRenderer = [[VMPGraphRenderer alloc] initWithMaxPendingRenders:4 cacheSize:32];
 
 		// Create a new iCalendar Sync instance
 		NSURL *icalURL = [NSURL URLWithString:[configuration icalURL]];
@@ -288,9 +281,21 @@ static NSData *convertDOTtoSVG(NSData *dotData, NSError **error) {
 	return ^HKHTTPResponse *(HKHTTPRequest *request) {
 		VMPProfileModel *profile;
 		HKHTTPJSONResponse *response;
+		NSMutableDictionary *startup;
+		NSDictionary *channelTimings;
 		profile = [_profileMgr currentProfile];
 
-		NSDictionary *data = @{
+		// Startup timing breakdown in milliseconds
+		startup = [NSMutableDictionary dictionaryWithDictionary:@{
+			@"profileLoad" : @(_profileLoadDuration),
+		}];
+		channelTimings = [_rtspServer startupTimings];
+		if (channelTimings) {
+			startup[@"channelStartup"] = channelTimings[@"total"];
+			startup[@"channels"] = channelTimings[@"channels"];
+		}
+
+		NSMutableDictionary *data = [NSMutableDictionary dictionaryWithDictionary:@{
 			@"version" : _version,
 			@"platform" : [_profileMgr runtimePlatform],
 			@"profile" : @{
@@ -300,7 +305,13 @@ static NSData *convertDOTtoSVG(NSData *dotData, NSError **error) {
 				@"description" : [profile description],
 			},
 			@"startedAt" : _startedAtDateISO8601,
-		};
+			@"statistics" : [_rtspServer globalStatistics],
+			@"startup" : startup,
+			@"graphRenderer" : [_graphRenderer statistics],
+		}];
+		if (_loopWatchdog) {
+			data[@"loops"] = [_loopWatchdog statistics];
+		}
 
 		response = [HKHTTPJSONResponse responseWithJSONObject:data status:200 error:NULL];
 		[response setHeaders:DEFAULT_HEADERS];
@@ -309,15 +320,60 @@ static NSData *convertDOTtoSVG(NSData *dotData, NSError **error) {
 }
 
 - (HKHandlerBlock)_configHandlerV1 {
-	return ^HKHTTPResponse *(HKHTTPRequest *request) {
-		return [HKHTTPJSONResponse responseWithJSONObject:[_configuration propertyList]
+	HKHTTPResponse *response;
+
+	// The configuration does not change at runtime, so the response is serialised once
+	response = [HKHTTPJSONResponse responseWithJSONObject:[_configuration propertyList]
 												   status:200
 													error:NULL];
+	[response setImmutable:YES];
+
+	return ^HKHTTPResponse *(HKHTTPRequest *request) {
+		return response;
 	};
 }
 
-- (HKHandlerBlock)_channelGraphHandlerV1 {
-	return ^HKHTTPResponse *(HKHTTPRequest *request) {
+// Render the graph with the shared renderer. The rendering runs in the
+// background, and the connection is suspended until the SVG is ready.
+- (void)_renderSVGForDOTData:(NSData *)dot completion:(HKResponseHandler)completion {
+	[_graphRenderer
+		renderSVGForDOTData:dot
+		  completionHandler:^(NSData *svgData, NSError *error) {
+			  HKHTTPResponse *errorResponse;
+			  NSDictionary *response;
+
+			  if (svgData) {
+				  completion([[HKHTTPResponse alloc]
+					  initWithData:svgData
+						   headers:@{@"Content-Type" : @"image/svg+xml"}
+							status:200]);
+				  return;
+			  }
+
+			  response = @{
+				  @"error" : [error localizedDescription],
+			  };
+			  if ([error code] != VMPErrorCodeGraphvizBusy) {
+				  completion([HKHTTPJSONResponse responseWithJSONObject:response
+																 status:500
+																  error:NULL]);
+				  return;
+			  }
+
+			  // Too many graphs are pending, so let the client retry later
+			  errorResponse = [HKHTTPJSONResponse responseWithJSONObject:response
+																  status:503
+																   error:NULL];
+			  [errorResponse setHeaders:@{
+				  @"Content-Type" : @"application/json",
+				  @"Retry-After" : @"1",
+			  }];
+			  completion(errorResponse);
+		  }];
+}
+
+- (HKAsyncHandlerBlock)_channelGraphHandlerV1 {
+	return ^(HKHTTPRequest *request, HKResponseHandler completion) {
 		NSString *channel;
 		NSString *format;
 		NSData *pipelineDot;
@@ -331,7 +387,8 @@ static NSData *convertDOTtoSVG(NSData *dotData, NSError **error) {
 			NSDictionary *response = @{
 				@"error" : @"Missing channel parameter",
 			};
-			return [HKHTTPJSONResponse responseWithJSONObject:response status:400 error:NULL];
+			completion([HKHTTPJSONResponse responseWithJSONObject:response status:400 error:NULL]);
+			return;
 		}
 		if (!format) {
 			format = @"svg";
@@ -343,45 +400,43 @@ static NSData *convertDOTtoSVG(NSData *dotData, NSError **error) {
 			NSDictionary *response = @{
 				@"error" : @"Channel not found",
 			};
-			return [HKHTTPJSONResponse responseWithJSONObject:response status:404 error:NULL];
+			completion([HKHTTPJSONResponse responseWithJSONObject:response status:404 error:NULL]);
+			return;
 		}
 
+		// An on-demand channel without consumers has no pipeline
 		pipelineDot = [mgr pipelineDotGraph];
-
-		if ([format isEqualToString:@"svg"]) {
-			NSError *error;
-			NSData *svgData;
-
-			svgData = convertDOTtoSVG(pipelineDot, &error);
-			if (!svgData) {
-				NSDictionary *response = @{
-					@"error" : [error localizedDescription],
-				};
-				return [HKHTTPJSONResponse responseWithJSONObject:response status:500 error:NULL];
-			}
-
-			headers = @{
-				@"Content-Type" : @"image/svg+xml",
+		if (!pipelineDot) {
+			NSDictionary *response = @{
+				@"error" : @"Channel not running",
 			};
+			completion([HKHTTPJSONResponse responseWithJSONObject:response status:404 error:NULL]);
+			return;
+		}
 
-			return [[HKHTTPResponse alloc] initWithData:svgData headers:headers status:200];
+		if ([format isEqualToString:@"svg"]) {
+			[self _renderSVGForDOTData:pipelineDot completion:completion];
+			return;
 		} else if ([format isEqualToString:@"dot"]) {
 			headers = @{
 				@"Content-Type" : @"text/plain",
 			};
 
-			return [[HKHTTPResponse alloc] initWithData:pipelineDot headers:headers status:200];
+			completion([[HKHTTPResponse alloc] initWithData:pipelineDot
+													headers:headers
+													 status:200]);
+			return;
 		}
 
 		NSDictionary *response = @{
 			@"error" : @"Invalid format parameter",
 		};
-		return [HKHTTPJSONResponse responseWithJSONObject:response status:400 error:NULL];
+		completion([HKHTTPJSONResponse responseWithJSONObject:response status:400 error:NULL]);
 	};
 }
 
-- (HKHandlerBlock)_mountpointGraphHandlerV1 {
-	return ^HKHTTPResponse *(HKHTTPRequest *request) {
+- (HKAsyncHandlerBlock)_mountpointGraphHandlerV1 {
+	return ^(HKHTTPRequest *request, HKResponseHandler completion) {
 		NSString *mountpoint;
 		NSString *format;
 		NSDictionary *headers;
@@ -394,7 +449,8 @@ static NSData *convertDOTtoSVG(NSData *dotData, NSError **error) {
 			NSDictionary *response = @{
 				@"error" : @"Missing mountpoint parameter",
 			};
-			return [HKHTTPJSONResponse responseWithJSONObject:response status:400 error:NULL];
+			completion([HKHTTPJSONResponse responseWithJSONObject:response status:400 error:NULL]);
+			return;
 		}
 		if (!format) {
 			format = @"svg";
@@ -406,38 +462,263 @@ static NSData *convertDOTtoSVG(NSData *dotData, NSError **error) {
 			NSDictionary *response = @{
 				@"error" : @"Mountpoint not found",
 			};
-			return [HKHTTPJSONResponse responseWithJSONObject:response status:404 error:NULL];
+			completion([HKHTTPJSONResponse responseWithJSONObject:response status:404 error:NULL]);
+			return;
 		}
 
 		if ([format isEqualToString:@"svg"]) {
-			NSError *error;
-			NSData *svgData;
-
-			svgData = convertDOTtoSVG(data, &error);
-			if (!svgData) {
-				NSDictionary *response = @{
-					@"error" : [error localizedDescription],
-				};
-				return [HKHTTPJSONResponse responseWithJSONObject:response status:500 error:NULL];
-			}
-
-			headers = @{
-				@"Content-Type" : @"image/svg+xml",
-			};
-
-			return [[HKHTTPResponse alloc] initWithData:svgData headers:headers status:200];
+			[self _renderSVGForDOTData:data completion:completion];
+			return;
 		} else if ([format isEqualToString:@"dot"]) {
 			headers = @{
 				@"Content-Type" : @"text/plain",
 			};
 
-			return [[HKHTTPResponse alloc] initWithData:data headers:headers status:200];
+			completion([[HKHTTPResponse alloc] initWithData:data headers:headers status:200]);
+			return;
 		}
 
 		NSDictionary *response = @{
 			@"error" : @"Invalid format parameter",
 		};
-		return [HKHTTPJSONResponse responseWithJSONObject:response status:400 error:NULL];
+		completion([HKHTTPJSONResponse responseWithJSONObject:response status:400 error:NULL]);
+	};
+}
+
+- (HKHandlerBlock)_channelTopologyHandlerV1 {
+	return ^HKHTTPResponse *(HKHTTPRequest *request) {
+		NSString *channel;
+		VMPPipelineManager *mgr;
+		VMPElementModel *topology;
+		HKHTTPJSONResponse *jsonResponse;
+
+		channel = [request queryParameters][@"channel"];
+		if (!channel) {
+			NSDictionary *response = @{
+				@"error" : @"Missing channel parameter",
+			};
+			return [HKHTTPJSONResponse responseWithJSONObject:response status:400 error:NULL];
+		}
+
+		mgr = [_rtspServer pipelineManagerForChannel:channel];
+		topology = [mgr pipelineTopology];
+		if (!topology) {
+			NSDictionary *response = @{
+				@"error" : @"Channel not found",
+			};
+			return [HKHTTPJSONResponse responseWithJSONObject:response status:404 error:NULL];
+		}
+
+		jsonResponse = [HKHTTPJSONResponse responseWithJSONObject:[topology propertyList]
+														   status:200
+															error:NULL];
+		[jsonResponse setHeaders:DEFAULT_HEADERS];
+		return jsonResponse;
+	};
+}
+
+- (HKHandlerBlock)_mountpointTopologyHandlerV1 {
+	return ^HKHTTPResponse *(HKHTTPRequest *request) {
+		NSString *mountpoint;
+		VMPElementModel *topology;
+		HKHTTPJSONResponse *jsonResponse;
+
+		mountpoint = [request queryParameters][@"mountpoint"];
+		if (!mountpoint) {
+			NSDictionary *response = @{
+				@"error" : @"Missing mountpoint parameter",
+			};
+			return [HKHTTPJSONResponse responseWithJSONObject:response status:400 error:NULL];
+		}
+
+		// Only available while a client is connected to the mountpoint
+		topology = [_rtspServer topologyForMountpointName:mountpoint];
+		if (!topology) {
+			NSDictionary *response = @{
+				@"error" : @"Mountpoint not found, or no client connected",
+			};
+			return [HKHTTPJSONResponse responseWithJSONObject:response status:404 error:NULL];
+		}
+
+		jsonResponse = [HKHTTPJSONResponse responseWithJSONObject:[topology propertyList]
+														   status:200
+															error:NULL];
+		[jsonResponse setHeaders:DEFAULT_HEADERS];
+		return jsonResponse;
+	};
+}
+
+- (HKHandlerBlock)_channelAnalysisHandlerV1 {
+	return ^HKHTTPResponse *(HKHTTPRequest *request) {
+		NSString *channel;
+		NSDictionary *analysis;
+		HKHTTPJSONResponse *jsonResponse;
+
+		channel = [request queryParameters][@"channel"];
+		if (!channel) {
+			NSDictionary *response = @{
+				@"error" : @"Missing channel parameter",
+			};
+			return [HKHTTPJSONResponse responseWithJSONObject:response status:400 error:NULL];
+		}
+
+		// Only available after the pipeline reached PLAYING
+		analysis = [[_rtspServer pipelineManagerForChannel:channel] analysis];
+		if (!analysis) {
+			NSDictionary *response = @{
+				@"error" : @"Channel not found, or not playing",
+			};
+			return [HKHTTPJSONResponse responseWithJSONObject:response status:404 error:NULL];
+		}
+
+		jsonResponse = [HKHTTPJSONResponse responseWithJSONObject:analysis
+														   status:200
+															error:NULL];
+		[jsonResponse setHeaders:DEFAULT_HEADERS];
+		return jsonResponse;
+	};
+}
+
+- (HKHandlerBlock)_mountpointAnalysisHandlerV1 {
+	return ^HKHTTPResponse *(HKHTTPRequest *request) {
+		NSString *mountpoint;
+		NSDictionary *analysis;
+		HKHTTPJSONResponse *jsonResponse;
+
+		mountpoint = [request queryParameters][@"mountpoint"];
+		if (!mountpoint) {
+			NSDictionary *response = @{
+				@"error" : @"Missing mountpoint parameter",
+			};
+			return [HKHTTPJSONResponse responseWithJSONObject:response status:400 error:NULL];
+		}
+
+		// Only available after the media of the mountpoint was prepared
+		analysis = [_rtspServer analysisForMountpointName:mountpoint];
+		if (!analysis) {
+			NSDictionary *response = @{
+				@"error" : @"Mountpoint not found, or not prepared",
+			};
+			return [HKHTTPJSONResponse responseWithJSONObject:response status:404 error:NULL];
+		}
+
+		jsonResponse = [HKHTTPJSONResponse responseWithJSONObject:analysis
+														   status:200
+															error:NULL];
+		[jsonResponse setHeaders:DEFAULT_HEADERS];
+		return jsonResponse;
+	};
+}
+
+- (HKHandlerBlock)_channelTraceHandlerV1 {
+	return ^HKHTTPResponse *(HKHTTPRequest *request) {
+		NSString *channel;
+		NSDictionary *statistics;
+		HKHTTPJSONResponse *jsonResponse;
+
+		channel = [request queryParameters][@"channel"];
+		if (!channel) {
+			NSDictionary *response = @{
+				@"error" : @"Missing channel parameter",
+			};
+			return [HKHTTPJSONResponse responseWithJSONObject:response status:400 error:NULL];
+		}
+
+		statistics = [[_rtspServer tracer] statisticsForChannel:channel];
+		if (!statistics) {
+			NSDictionary *response = @{
+				@"error" : @"Channel not found, or not traced",
+			};
+			return [HKHTTPJSONResponse responseWithJSONObject:response status:404 error:NULL];
+		}
+
+		jsonResponse = [HKHTTPJSONResponse responseWithJSONObject:statistics
+														   status:200
+															error:NULL];
+		[jsonResponse setHeaders:DEFAULT_HEADERS];
+		return jsonResponse;
+	};
+}
+
+- (HKHandlerBlock)_mountpointTraceHandlerV1 {
+	return ^HKHTTPResponse *(HKHTTPRequest *request) {
+		NSString *mountpoint;
+		NSDictionary *statistics;
+		HKHTTPJSONResponse *jsonResponse;
+
+		mountpoint = [request queryParameters][@"mountpoint"];
+		if (!mountpoint) {
+			NSDictionary *response = @{
+				@"error" : @"Missing mountpoint parameter",
+			};
+			return [HKHTTPJSONResponse responseWithJSONObject:response status:400 error:NULL];
+		}
+
+		// Only available after the media of the mountpoint was constructed
+		statistics = [[_rtspServer tracer] statisticsForMountpointName:mountpoint];
+		if (!statistics) {
+			NSDictionary *response = @{
+				@"error" : @"Mountpoint not found, or not traced",
+			};
+			return [HKHTTPJSONResponse responseWithJSONObject:response status:404 error:NULL];
+		}
+
+		jsonResponse = [HKHTTPJSONResponse responseWithJSONObject:statistics
+														   status:200
+															error:NULL];
+		[jsonResponse setHeaders:DEFAULT_HEADERS];
+		return jsonResponse;
+	};
+}
+
+- (HKHandlerBlock)_mountpointClientsHandlerV1 {
+	return ^HKHTTPResponse *(HKHTTPRequest *request) {
+		NSString *mountpoint;
+		NSArray *clients;
+		HKHTTPJSONResponse *jsonResponse;
+
+		// Optional, all mountpoints if missing
+		mountpoint = [request queryParameters][@"mountpoint"];
+
+		clients = [_rtspServer clientStatisticsForMountpointName:mountpoint];
+		if (!clients) {
+			NSDictionary *response = @{
+				@"error" : @"Mountpoint not found",
+			};
+			jsonResponse = [HKHTTPJSONResponse responseWithJSONObject:response
+															   status:404
+																error:NULL];
+			[jsonResponse setHeaders:DEFAULT_HEADERS];
+			return jsonResponse;
+		}
+
+		jsonResponse = [HKHTTPJSONResponse responseWithJSONObject:@{@"clients" : clients}
+														   status:200
+															error:NULL];
+		[jsonResponse setHeaders:DEFAULT_HEADERS];
+		return jsonResponse;
+	};
+}
+
+/*
+ * GET /metrics
+ *
+ * Metrics in the Prometheus text exposition format.
+ */
+- (HKHandlerBlock)_metricsHandler {
+	return ^HKHTTPResponse *(HKHTTPRequest *request) {
+		NSString *exposition;
+		NSDictionary *headers;
+		NSData *data;
+
+		// Only reads the samples, the pipelines are not walked
+		exposition = [[_rtspServer metrics] expositionWithHTTPServer:_httpServer];
+		data = [exposition dataUsingEncoding:NSUTF8StringEncoding];
+		headers = @{
+			@"Content-Type" : @"text/plain; version=0.0.4; charset=utf-8",
+		};
+
+		return [[HKHTTPResponse alloc] initWithData:data headers:headers status:200];
 	};
 }
 
@@ -577,13 +858,200 @@ static NSData *convertDOTtoSVG(NSData *dotData, NSError **error) {
 	};
 }
 
+/*
+ * GET /api/v1/recording/download?name=recording_2024-03-11T13:04:57+0000.mkv
+ *
+ * Serves a recording from the scratch directory. The file is sent with
+ * sendfile(2), and supports range requests, so interrupted downloads can be
+ * resumed. A recording that is still in progress is sent up to its size at
+ * the time of the request.
+ */
+- (HKHandlerBlock)_recordingDownloadHandlerV1 {
+	return ^HKHTTPResponse *(HKHTTPRequest *request) {
+		NSString *name, *path, *contentType, *disposition;
+		NSCharacterSet *dispositionCharacters;
+		NSDictionary *headers;
+		HKHTTPFileResponse *fileResponse;
+		NSError *error = nil;
+
+		if ([[_configuration scratchDirectory] length] == 0) {
+			NSDictionary *response = @{
+				@"error" : @"No scratch directory set",
+			};
+			return [HKHTTPJSONResponse responseWithJSONObject:response status:500 error:NULL];
+		}
+
+		name = [request queryParameters][@"name"];
+		if (!name) {
+			NSDictionary *response = @{
+				@"error" : @"Missing name parameter",
+			};
+			return [HKHTTPJSONResponse responseWithJSONObject:response status:400 error:NULL];
+		}
+		// Only serve files directly in the scratch directory
+		if ([name length] == 0 || [name hasPrefix:@"."] || [name containsString:@"/"]) {
+			NSDictionary *response = @{
+				@"error" : @"Invalid name parameter",
+			};
+			return [HKHTTPJSONResponse responseWithJSONObject:response status:400 error:NULL];
+		}
+
+		// attr-char of RFC 5987
+		dispositionCharacters =
+			[NSCharacterSet characterSetWithCharactersInString:@"ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+															   @"abcdefghijklmnopqrstuvwxyz"
+															   @"0123456789!#$&+-.^_`|~"];
+		if ([[name pathExtension] isEqualToString:@"mkv"]) {
+			contentType = @"video/x-matroska";
+		} else {
+			contentType = @"application/octet-stream";
+		}
+		// Percent-encode the name (RFC 6266), so quotes, and control characters in the
+		// name cannot break the header
+		disposition = [NSString
+			stringWithFormat:@"attachment; filename*=UTF-8''%@",
+							 [name stringByAddingPercentEncodingWithAllowedCharacters:
+									   dispositionCharacters]];
+		headers = @{
+			@"Content-Type" : contentType,
+			@"Content-Disposition" : disposition,
+		};
+
+		path = [[_configuration scratchDirectory] stringByAppendingPathComponent:name];
+		fileResponse = [HKHTTPFileResponse responseWithPath:path
+													request:request
+													headers:headers
+													  error:&error];
+		if (!fileResponse) {
+			if ([error code] == ENOENT || [error code] == EISDIR) {
+				NSDictionary *response = @{
+					@"error" : @"Recording not found",
+				};
+				return [HKHTTPJSONResponse responseWithJSONObject:response status:404 error:NULL];
+			}
+
+			VMPError(@"Failed to open recording %@: %@", path, error);
+			NSDictionary *response = @{
+				@"error" : @"Failed to open recording",
+			};
+			return [HKHTTPJSONResponse responseWithJSONObject:response status:500 error:NULL];
+		}
+
+		return fileResponse;
+	};
+}
+
+// Serves playlists, and segments of the HLS egress below /hls/
+- (HKHandlerBlock)_hlsHandler {
+	VMPConfigHLSModel *hls = [_configuration hls];
+
+	return ^HKHTTPResponse *(HKHTTPRequest *request) {
+		NSString *relativePath, *extension, *contentType, *cacheControl;
+		NSDictionary *headers;
+		NSData *data;
+
+		relativePath = [[[request URL] path] substringFromIndex:[@"/hls/" length]];
+		// Only serve files in the HLS directory
+		if ([[relativePath pathComponents] containsObject:@".."]) {
+			NSDictionary *response = @{
+				@"error" : @"Invalid path",
+			};
+			return [HKHTTPJSONResponse responseWithJSONObject:response status:400 error:NULL];
+		}
+
+		extension = [relativePath pathExtension];
+		if ([extension isEqualToString:@"m3u8"]) {
+			contentType = @"application/vnd.apple.mpegurl";
+			// The playlist is rewritten with every segment
+			cacheControl = @"no-cache";
+		} else if ([extension isEqualToString:@"ts"]) {
+			NSUInteger listed;
+
+			// Segment names are reused after a restart of the egress, so segments are only
+			// cached while they can be listed in the playlist
+			listed = [[hls segmentDuration] unsignedIntegerValue] *
+					 [[hls playlistLength] unsignedIntegerValue];
+			contentType = @"video/mp2t";
+			cacheControl = [NSString stringWithFormat:@"max-age=%lu", listed];
+		} else {
+			return [HKHTTPResponse responseWithStatus:404];
+		}
+
+		data = [NSData
+			dataWithContentsOfFile:[[hls directory] stringByAppendingPathComponent:relativePath]];
+		if (!data) {
+			return [HKHTTPResponse responseWithStatus:404];
+		}
+
+		headers = @{
+			@"Access-Control-Allow-Origin" : @"*",
+			@"Content-Type" : contentType,
+			@"Cache-Control" : cacheControl,
+		};
+		return [[HKHTTPResponse alloc] initWithData:data headers:headers status:200];
+	};
+}
+
+// Create a route, and report its handler as an activity of the HTTP loop while it runs
+- (HKRoute *)_routeWithPath:(NSString *)path
+					 method:(NSString *)method
+					handler:(HKHandlerBlock)handler {
+	NSString *activity = [NSString stringWithFormat:@"%@ %@", method, path];
+
+	return [HKRoute routeWithPath:path
+						   method:method
+						  handler:^HKHTTPResponse *(HKHTTPRequest *request) {
+							  HKHTTPResponse *response;
+
+							  [VMPLoopWatchdog beginActivity:activity onLoop:VMPLoopHTTP];
+							  response = handler(request);
+							  [VMPLoopWatchdog endActivityOnLoop:VMPLoopHTTP];
+
+							  return response;
+						  }];
+}
+
+// Run a synchronous handler on a global dispatch queue, so that slow work, like
+// starting a pipeline, does not block the HTTP server
+- (HKAsyncHandlerBlock)_backgroundHandler:(HKHandlerBlock)handler {
+	return ^(HKHTTPRequest *request, HKResponseHandler completion) {
+		dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+			completion(handler(request));
+		});
+	};
+}
+
+// Create an asynchronous route. Only the synchronous part of the handler is
+// reported to the watchdog, as the connection is suspended until completion.
+- (HKRoute *)_routeWithPath:(NSString *)path
+					 method:(NSString *)method
+			   asyncHandler:(HKAsyncHandlerBlock)handler {
+	NSString *activity = [NSString stringWithFormat:@"%@ %@", method, path];
+
+	return [HKRoute routeWithPath:path
+						   method:method
+					 asyncHandler:^(HKHTTPRequest *request, HKResponseHandler completion) {
+						 [VMPLoopWatchdog beginActivity:activity onLoop:VMPLoopHTTP];
+						 handler(request, completion);
+						 [VMPLoopWatchdog endActivityOnLoop:VMPLoopHTTP];
+					 }];
+}
+
 - (void)setupHTTPHandlers {
 	HKRouter *router;
 	HKRoute *statusRoute;
 	HKRoute *configRoute;
 	HKRoute *channelGraphRoute;
 	HKRoute *mountpointGraphRoute;
+	HKRoute *channelTopologyRoute;
+	HKRoute *mountpointTopologyRoute;
+	HKRoute *channelAnalysisRoute;
+	HKRoute *mountpointAnalysisRoute;
+	HKRoute *mountpointClientsRoute;
 	HKRoute *recordingCreateRoute;
+	HKRoute *recordingDownloadRoute;
+	HKRoute *metricsRoute;
+	HKAsyncHandlerBlock recordingCreateHandler;
 	HKHandlerBlock CORSHandler;
 
 	router = [_httpServer router];
@@ -600,50 +1068,146 @@ static NSData *convertDOTtoSVG(NSData *dotData, NSError **error) {
 	}
 
 	// GET /api/v1/status
-	statusRoute = [HKRoute routeWithPath:@"/api/v1/status"
-								  method:HKHTTPMethodGET
-								 handler:[self _statusHandlerV1]];
+	statusRoute = [self _routeWithPath:@"/api/v1/status"
+								method:HKHTTPMethodGET
+							   handler:[self _statusHandlerV1]];
 	// GET /api/v1/config
-	configRoute = [HKRoute routeWithPath:@"/api/v1/config"
-								  method:HKHTTPMethodGET
-								 handler:[self _configHandlerV1]];
+	configRoute = [self _routeWithPath:@"/api/v1/config"
+								method:HKHTTPMethodGET
+							   handler:[self _configHandlerV1]];
 	// GET /api/v1/channel/graph
-	channelGraphRoute = [HKRoute routeWithPath:@"/api/v1/channel/graph"
-										method:HKHTTPMethodGET
-									   handler:[self _channelGraphHandlerV1]];
+	channelGraphRoute = [self _routeWithPath:@"/api/v1/channel/graph"
+									  method:HKHTTPMethodGET
+								asyncHandler:[self _channelGraphHandlerV1]];
 	// GET /api/v1/mountpoint/graph
-	mountpointGraphRoute = [HKRoute routeWithPath:@"/api/v1/mountpoint/graph"
+	mountpointGraphRoute = [self _routeWithPath:@"/api/v1/mountpoint/graph"
+										 method:HKHTTPMethodGET
+								   asyncHandler:[self _mountpointGraphHandlerV1]];
+	// GET /api/v1/channel/topology
+	channelTopologyRoute = [self _routeWithPath:@"/api/v1/channel/topology"
+										 method:HKHTTPMethodGET
+										handler:[self _channelTopologyHandlerV1]];
+	// GET /api/v1/mountpoint/topology
+	mountpointTopologyRoute = [self _routeWithPath:@"/api/v1/mountpoint/topology"
+											method:HKHTTPMethodGET
+										   handler:[self _mountpointTopologyHandlerV1]];
+	// GET /api/v1/channel/analysis
+	channelAnalysisRoute = [self _routeWithPath:@"/api/v1/channel/analysis"
+										 method:HKHTTPMethodGET
+										handler:[self _channelAnalysisHandlerV1]];
+	// GET /api/v1/mountpoint/analysis
+	mountpointAnalysisRoute = [self _routeWithPath:@"/api/v1/mountpoint/analysis"
+											method:HKHTTPMethodGET
+										   handler:[self _mountpointAnalysisHandlerV1]];
+	// GET /api/v1/mountpoint/clients
+	mountpointClientsRoute = [self _routeWithPath:@"/api/v1/mountpoint/clients"
 										   method:HKHTTPMethodGET
-										  handler:[self _mountpointGraphHandlerV1]];
+										  handler:[self _mountpointClientsHandlerV1]];
 	// POST /api/v1/recording/create
-	recordingCreateRoute = [HKRoute routeWithPath:@"/api/v1/recording/create"
-										   method:HKHTTPMethodPOST
-										  handler:[self _recordingCreateV1]];
+	recordingCreateHandler = [self _backgroundHandler:[self _recordingCreateV1]];
+	recordingCreateRoute = [self _routeWithPath:@"/api/v1/recording/create"
+										 method:HKHTTPMethodPOST
+								   asyncHandler:recordingCreateHandler];
+	// GET /api/v1/recording/download
+	recordingDownloadRoute = [self _routeWithPath:@"/api/v1/recording/download"
+										   method:HKHTTPMethodGET
+										  handler:[self _recordingDownloadHandlerV1]];
 
 	[router registerRoute:statusRoute withCORSHandler:CORSHandler];
 	[router registerRoute:configRoute withCORSHandler:CORSHandler];
 	[router registerRoute:channelGraphRoute withCORSHandler:CORSHandler];
 	[router registerRoute:mountpointGraphRoute withCORSHandler:CORSHandler];
+	[router registerRoute:channelTopologyRoute withCORSHandler:CORSHandler];
+	[router registerRoute:mountpointTopologyRoute withCORSHandler:CORSHandler];
+	[router registerRoute:channelAnalysisRoute withCORSHandler:CORSHandler];
+	[router registerRoute:mountpointAnalysisRoute withCORSHandler:CORSHandler];
+	[router registerRoute:mountpointClientsRoute withCORSHandler:CORSHandler];
 	[router registerRoute:recordingCreateRoute withCORSHandler:CORSHandler];
+	[router registerRoute:recordingDownloadRoute withCORSHandler:CORSHandler];
+
+	// GET /metrics
+	metricsRoute = [self _routeWithPath:@"/metrics"
+								 method:HKHTTPMethodGET
+								handler:[self _metricsHandler]];
+	[router registerRoute:metricsRoute];
+
+	// GET /api/v1/channel/trace, and /api/v1/mountpoint/trace
+	if ([_rtspServer tracer]) {
+		HKRoute *channelTraceRoute;
+		HKRoute *mountpointTraceRoute;
+
+		channelTraceRoute = [self _routeWithPath:@"/api/v1/channel/trace"
+										  method:HKHTTPMethodGET
+										 handler:[self _channelTraceHandlerV1]];
+		mountpointTraceRoute = [self _routeWithPath:@"/api/v1/mountpoint/trace"
+											 method:HKHTTPMethodGET
+											handler:[self _mountpointTraceHandlerV1]];
+		[router registerRoute:channelTraceRoute withCORSHandler:CORSHandler];
+		[router registerRoute:mountpointTraceRoute withCORSHandler:CORSHandler];
+	}
+
+	// GET /hls/<mountpoint path>/index.m3u8, and the segments listed in it
+	if ([[[_configuration hls] serve] boolValue]) {
+		HKRoute *hlsRoute;
+
+		hlsRoute = [self _routeWithPath:@"/hls/*"
+								 method:HKHTTPMethodGET
+								handler:[self _hlsHandler]];
+		[router registerRoute:hlsRoute withCORSHandler:CORSHandler];
+	}
 }
 
 #pragma mark - Server Lifecycle
 
-- (void)iterateMainLoop:(NSTimer *)timer {
-	// One iteration of the main loop in the default context. Non-blocking.
-	g_main_context_iteration(NULL, FALSE);
+/*
+ * Dispatch the GLib default main context on a dedicated thread.
+ *
+ * GStreamer bus watches, and the sources of the GStreamer RTSP server are
+ * attached to the default main context. Running the context in its own thread
+ * (instead of iterating it periodically from the NSRunLoop) dispatches events as soon as
+ * the context is woken up.
+ *
+ * Note that delegate callbacks of the pipeline managers are thus invoked on this thread.
+ */
+- (void)_runGLibMainLoop:(id)unused {
+	@autoreleasepool {
+		VMPDebug(@"GLib dispatch thread started");
+
+		// Blocks until g_main_loop_quit is called
+		g_main_loop_run(_glibMainLoop);
+
+		VMPDebug(@"GLib dispatch thread stopped");
+	}
 }
 
-- (BOOL)runWithError:(NSError **)error {
-	// Iterate glib mainloop context with NSTimer (fire every second)
-	NSTimer *timer = [NSTimer scheduledTimerWithTimeInterval:1.0
-													  target:self
-													selector:@selector(iterateMainLoop:)
-													userInfo:nil
-													 repeats:YES];
+// Fired on the main run loop. Does nothing.
+- (void)_keepAlive:(NSTimer *)timer {
+}
 
-	NSRunLoop *current = [NSRunLoop currentRunLoop];
-	[current addTimer:timer forMode:NSDefaultRunLoopMode];
+- (BOOL)runWithError:(NSError **)error {
+	/* The main run loop schedules restarts, starts, and stops on-demand channels, and
+	 * receives the heartbeat of the loop watchdog. Without a source, -[NSRunLoop run]
+	 * returns immediately, and the daemon exits.
+	 */
+	_keepAliveTimer = [NSTimer scheduledTimerWithTimeInterval:60.0
+													   target:self
+													 selector:@selector(_keepAlive:)
+													 userInfo:nil
+													  repeats:YES];
+
+	_glibMainLoop = g_main_loop_new(NULL, FALSE);
+	_glibThread = [[NSThread alloc] initWithTarget:self
+										  selector:@selector(_runGLibMainLoop:)
+											object:nil];
+	[_glibThread setName:@"glib-dispatch"];
+	[_glibThread start];
+
+	// Heartbeat the main run loop, and the GLib main context
+	if ([[_configuration loopStallThreshold] doubleValue] > 0) {
+		_loopWatchdog = [[VMPLoopWatchdog alloc]
+			initWithInterval:0.1
+				   threshold:[[_configuration loopStallThreshold] doubleValue]];
+	}
 
 	if (![_rtspServer startWithError:error]) {
 		return NO;
@@ -663,6 +1227,18 @@ static NSData *convertDOTtoSVG(NSData *dotData, NSError **error) {
 	VMPInfo(@"Shutting down...");
 	[_rtspServer stop];
 	[_httpServer stop];
+	[_loopWatchdog invalidate];
+	[_keepAliveTimer invalidate];
+
+	if (_glibMainLoop) {
+		g_main_loop_quit(_glibMainLoop);
+	}
+}
+
+- (void)dealloc {
+	if (_glibMainLoop) {
+		g_main_loop_unref(_glibMainLoop);
+	}
 }
 
 @end
\ No newline at end of file
@@ -0,0 +1,100 @@
+/* vmpserverd - A virtual multimedia processor
+ * Copyright (C) 2024 Hugo Melder
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#import <Foundation/Foundation.h>
+#import <gst/gst.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+extern NSString *const kVMPStreamStatisticsSubscribers;
+extern NSString *const kVMPStreamStatisticsBuffersPublished;
+extern NSString *const kVMPStreamStatisticsBuffersDropped;
+extern NSString *const kVMPStreamStatisticsSubscriberStatistics;
+
+/**
+ * @brief Fan-out of a stream from one pipeline to any number of pipelines
+ *
+ * A publisher is attached to an appsink element. Every buffer arriving at the
+ * appsink is pushed to all subscribed appsrc elements. Buffers are not copied:
+ * subscribers receive a new buffer object referencing the same memory, with
+ * timestamps shifted to the running time of the subscribing pipeline.
+ *
+ * New subscribers only receive data starting with the next key frame, and a
+ * key frame is requested from upstream when subscribing. Key frame requests
+ * of subscribing pipelines are forwarded as well. This allows encoded streams
+ * to be shared between independent pipelines.
+ * Raw streams, like a captured audio device, consist of key frames only, and
+ * all subscribers receive the same samples.
+ *
+ * Every subscriber has a bounded queue. If a subscriber does not keep up, new
+ * buffers are dropped for this subscriber only, and counted in the statistics.
+ *
+ * All methods are MT-Safe.
+ */
+@interface VMPStreamPublisher : NSObject
+
+/**
+ * @brief Name of the publisher used in log messages
+ */
+@property (nonatomic, readonly) NSString *name;
+
+/**
+ * @brief Maximum number of buffers queued in a subscribing appsrc
+ *
+ * Defaults to 4, like channelBusQueueSize in the configuration. Changes apply to
+ * buffers published afterwards.
+ */
+@property (atomic, assign) NSUInteger queueSize;
+
+/**
+ * @brief Statistics of the publisher
+ *
+ * Contains the number of subscribers, the number of published, and
+ * dropped buffers, and an array with the statistics of each subscriber
+ * ("name", "buffersPushed", "buffersDropped", "queued").
+ */
+@property (readonly) NSDictionary *statistics;
+
++ (instancetype)publisherWithName:(NSString *)name;
+
+- (instancetype)initWithName:(NSString *)name;
+
+/**
+ * @brief Attach the publisher to an appsink element
+ *
+ * Replaces the previously attached appsink. Subscribers are resynchronised
+ * with the new stream.
+ */
+- (void)attachToSink:(GstElement *)appsink;
+
+/**
+ * @brief Detach the publisher from the current appsink
+ */
+- (void)detach;
+
+/**
+ * @brief Resynchronise all subscribers with the stream
+ *
+ * Called after the publishing pipeline was restarted, and the running time of the
+ * stream was reset.
+ */
+- (void)resynchronize;
+
+/**
+ * @brief Subscribe an appsrc element to the stream
+ *
+ * The appsrc must be live, and operate in the time format.
+ */
+- (void)addSubscriber:(GstElement *)appsrc;
+
+/**
+ * @brief Unsubscribe an appsrc element from the stream
+ */
+- (void)removeSubscriber:(GstElement *)appsrc;
+
+@end
+
+NS_ASSUME_NONNULL_END
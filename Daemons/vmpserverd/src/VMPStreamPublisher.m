@@ -0,0 +1,364 @@
+/* vmpserverd - A virtual multimedia processor
+ * Copyright (C) 2024 Hugo Melder
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#import <gst/app/app.h>
+#import <gst/video/video.h>
+
+#import "VMPJournal.h"
+#import "VMPStreamPublisher.h"
+
+NSString *const kVMPStreamStatisticsSubscribers = @"subscribers";
+NSString *const kVMPStreamStatisticsBuffersPublished = @"buffersPublished";
+NSString *const kVMPStreamStatisticsBuffersDropped = @"buffersDropped";
+NSString *const kVMPStreamStatisticsSubscriberStatistics = @"subscriberStatistics";
+
+#pragma mark - Subscriber
+
+@interface _VMPStreamSubscriber : NSObject
+
+// Strong reference to the appsrc element
+@property (nonatomic, readonly) GstElement *element;
+// Path of the element in its pipeline
+@property (nonatomic, readonly) NSString *name;
+// Caps last set on the appsrc
+@property (nonatomic) GstCaps *caps;
+// Offset between the running time of the publisher, and the subscriber in nanoseconds
+@property (nonatomic) gint64 offset;
+@property (nonatomic) BOOL waitingForKeyframe;
+@property (nonatomic) guint64 buffersPushed;
+@property (nonatomic) guint64 buffersDropped;
+// Probe on the source pad of the appsrc forwarding key frame requests
+@property (nonatomic) gulong probeId;
+
+- (instancetype)initWithElement:(GstElement *)element;
+@end
+
+@implementation _VMPStreamSubscriber
+- (instancetype)initWithElement:(GstElement *)element {
+	self = [super init];
+	if (self) {
+		gchar *path;
+
+		_element = gst_object_ref(element);
+		path = gst_object_get_path_string(GST_OBJECT(element));
+		_name = [NSString stringWithUTF8String:path];
+		g_free(path);
+		_caps = NULL;
+		_waitingForKeyframe = YES;
+	}
+	return self;
+}
+
+- (void)dealloc {
+	if (_probeId != 0) {
+		GstPad *pad = gst_element_get_static_pad(_element, "src");
+
+		gst_pad_remove_probe(pad, _probeId);
+		gst_object_unref(pad);
+	}
+	gst_caps_replace(&_caps, NULL);
+	gst_object_unref(_element);
+}
+@end
+
+#pragma mark - Publisher
+
+@interface VMPStreamPublisher ()
+- (void)_publishSample:(GstSample *)sample;
+- (void)_requestKeyframe;
+@end
+
+/* Called from a streaming thread of a subscribing pipeline.
+ *
+ * Elements like hlssink2 request key frames to cut segments. The request ends at the
+ * appsrc, so it is forwarded to the encoder of the publishing pipeline. The probe is
+ * removed before the publisher is deallocated.
+ */
+static GstPadProbeReturn subscriber_event_probe(GstPad *pad, GstPadProbeInfo *info,
+												gpointer user_data) {
+	GstEvent *event = GST_PAD_PROBE_INFO_EVENT(info);
+
+	if (gst_video_event_is_force_key_unit(event)) {
+		@autoreleasepool {
+			__unsafe_unretained VMPStreamPublisher *publisher = (__bridge id) user_data;
+
+			[publisher _requestKeyframe];
+		}
+	}
+
+	return GST_PAD_PROBE_OK;
+}
+
+/* Called from the streaming thread of the appsink.
+ *
+ * The publisher is bridged without retaining it. The publisher detaches itself from
+ * the appsink before it is deallocated.
+ */
+static GstFlowReturn new_sample_cb(GstAppSink *appsink, gpointer user_data) {
+	@autoreleasepool {
+		__unsafe_unretained VMPStreamPublisher *publisher = (__bridge id) user_data;
+		GstSample *sample;
+
+		// Transfer: Full
+		sample = gst_app_sink_pull_sample(appsink);
+		if (sample == NULL) {
+			return GST_FLOW_EOS;
+		}
+
+		[publisher _publishSample:sample];
+		gst_sample_unref(sample);
+	}
+
+	return GST_FLOW_OK;
+}
+
+@implementation VMPStreamPublisher {
+	GstElement *_sink;
+	NSMutableArray<_VMPStreamSubscriber *> *_subscribers;
+	guint64 _buffersPublished;
+	guint64 _buffersDropped;
+}
+
++ (instancetype)publisherWithName:(NSString *)name {
+	return [[VMPStreamPublisher alloc] initWithName:name];
+}
+
+- (instancetype)initWithName:(NSString *)name {
+	self = [super init];
+	if (self) {
+		_name = [name copy];
+		_queueSize = 4;
+		_sink = NULL;
+		_subscribers = [NSMutableArray array];
+	}
+	return self;
+}
+
+- (void)attachToSink:(GstElement *)appsink {
+	GstAppSinkCallbacks callbacks = {NULL};
+
+	VMP_ASSERT(GST_IS_APP_SINK(appsink), @"Publisher can only be attached to an appsink");
+
+	[self detach];
+
+	callbacks.new_sample = new_sample_cb;
+	gst_app_sink_set_callbacks(GST_APP_SINK(appsink), &callbacks, (__bridge void *) self, NULL);
+
+	@synchronized(self) {
+		_sink = gst_object_ref(appsink);
+	}
+
+	VMPDebug(@"Publisher %@ attached to %s", _name, GST_OBJECT_NAME(appsink));
+	[self resynchronize];
+}
+
+- (void)detach {
+	GstAppSinkCallbacks callbacks = {NULL};
+	GstElement *sink;
+
+	@synchronized(self) {
+		sink = _sink;
+		_sink = NULL;
+	}
+
+	if (sink != NULL) {
+		gst_app_sink_set_callbacks(GST_APP_SINK(sink), &callbacks, NULL, NULL);
+		gst_object_unref(sink);
+	}
+}
+
+- (void)resynchronize {
+	@synchronized(self) {
+		for (_VMPStreamSubscriber *subscriber in _subscribers) {
+			[subscriber setWaitingForKeyframe:YES];
+		}
+	}
+
+	[self _requestKeyframe];
+}
+
+- (void)addSubscriber:(GstElement *)appsrc {
+	_VMPStreamSubscriber *subscriber;
+	GstPad *pad;
+
+	VMP_ASSERT(GST_IS_APP_SRC(appsrc), @"Only appsrc elements can subscribe to a publisher");
+
+	subscriber = [[_VMPStreamSubscriber alloc] initWithElement:appsrc];
+
+	pad = gst_element_get_static_pad(appsrc, "src");
+	[subscriber setProbeId:gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_EVENT_UPSTREAM,
+											 subscriber_event_probe, (__bridge void *) self,
+											 NULL)];
+	gst_object_unref(pad);
+
+	@synchronized(self) {
+		[_subscribers addObject:subscriber];
+	}
+
+	VMPInfo(@"%s subscribed to publisher %@", GST_OBJECT_NAME(appsrc), _name);
+	[self _requestKeyframe];
+}
+
+- (void)removeSubscriber:(GstElement *)appsrc {
+	@synchronized(self) {
+		for (NSUInteger i = 0; i < [_subscribers count]; i++) {
+			if ([_subscribers[i] element] == appsrc) {
+				VMPInfo(@"%s unsubscribed from publisher %@ (%llu buffers dropped)",
+						GST_OBJECT_NAME(appsrc), _name,
+						(unsigned long long) [_subscribers[i] buffersDropped]);
+				[_subscribers removeObjectAtIndex:i];
+				break;
+			}
+		}
+	}
+}
+
+- (NSDictionary *)statistics {
+	@synchronized(self) {
+		NSMutableArray *subscribers = [NSMutableArray arrayWithCapacity:[_subscribers count]];
+
+		for (_VMPStreamSubscriber *subscriber in _subscribers) {
+			GstAppSrc *src = GST_APP_SRC([subscriber element]);
+
+			[subscribers addObject:@{
+				@"name" : [subscriber name],
+				@"buffersPushed" : @([subscriber buffersPushed]),
+				@"buffersDropped" : @([subscriber buffersDropped]),
+				@"queued" : @(gst_app_src_get_current_level_buffers(src)),
+			}];
+		}
+
+		return @{
+			kVMPStreamStatisticsSubscribers : @([_subscribers count]),
+			kVMPStreamStatisticsBuffersPublished : @(_buffersPublished),
+			kVMPStreamStatisticsBuffersDropped : @(_buffersDropped),
+			kVMPStreamStatisticsSubscriberStatistics : subscribers,
+		};
+	}
+}
+
+#pragma mark - Private methods
+
+// Ask the encoder upstream of the appsink for a new key frame, so new subscribers
+// do not need to wait for the next regular key frame
+- (void)_requestKeyframe {
+	GstElement *sink = NULL;
+	GstEvent *event;
+
+	@synchronized(self) {
+		if (_sink != NULL) {
+			sink = gst_object_ref(_sink);
+		}
+	}
+
+	if (sink != NULL) {
+		event = gst_video_event_new_upstream_force_key_unit(GST_CLOCK_TIME_NONE, TRUE, 0);
+		gst_element_send_event(sink, event);
+		gst_object_unref(sink);
+	}
+}
+
+- (void)_publishSample:(GstSample *)sample {
+	const GstSegment *segment;
+	GstBuffer *buffer;
+	GstCaps *caps;
+	GstClockTime runningTime;
+	BOOL keyframe;
+	BOOL needsKeyframe = NO;
+	guint64 queueSize;
+
+	buffer = gst_sample_get_buffer(sample);
+	caps = gst_sample_get_caps(sample);
+	segment = gst_sample_get_segment(sample);
+	if (buffer == NULL || caps == NULL || segment == NULL) {
+		return;
+	}
+
+	runningTime = gst_segment_to_running_time(segment, GST_FORMAT_TIME, GST_BUFFER_PTS(buffer));
+	if (!GST_CLOCK_TIME_IS_VALID(runningTime)) {
+		return;
+	}
+
+	// Raw video, and audio buffers are never delta units
+	keyframe = !GST_BUFFER_FLAG_IS_SET(buffer, GST_BUFFER_FLAG_DELTA_UNIT);
+	queueSize = [self queueSize];
+
+	@synchronized(self) {
+		_buffersPublished++;
+
+		for (_VMPStreamSubscriber *subscriber in _subscribers) {
+			GstAppSrc *src = GST_APP_SRC([subscriber element]);
+			GstBuffer *out;
+			gint64 pts;
+
+			if ([subscriber waitingForKeyframe]) {
+				GstClockTime now;
+
+				if (!keyframe) {
+					continue;
+				}
+
+				// The subscribing pipeline is not playing yet
+				now = gst_element_get_current_running_time([subscriber element]);
+				if (!GST_CLOCK_TIME_IS_VALID(now)) {
+					continue;
+				}
+
+				[subscriber setOffset:(gint64) now - (gint64) runningTime];
+				[subscriber setWaitingForKeyframe:NO];
+			}
+
+			// Drop instead of queueing without bound. An encoded stream is only decodable
+			// again from the next key frame on.
+			if (gst_app_src_get_current_level_buffers(src) >= queueSize) {
+				[subscriber setBuffersDropped:[subscriber buffersDropped] + 1];
+				_buffersDropped++;
+				if (!keyframe) {
+					[subscriber setWaitingForKeyframe:YES];
+					needsKeyframe = YES;
+				}
+				continue;
+			}
+
+			if ([subscriber caps] == NULL || !gst_caps_is_equal([subscriber caps], caps)) {
+				GstCaps *current = [subscriber caps];
+
+				gst_caps_replace(&current, caps);
+				[subscriber setCaps:current];
+				gst_app_src_set_caps(src, caps);
+			}
+
+			// Only the metadata is copied. The memory is shared with the published buffer.
+			out = gst_buffer_copy(buffer);
+
+			pts = MAX((gint64) runningTime + [subscriber offset], 0);
+			if (GST_BUFFER_DTS_IS_VALID(buffer)) {
+				gint64 delta = (gint64) GST_BUFFER_DTS(buffer) - (gint64) GST_BUFFER_PTS(buffer);
+				GST_BUFFER_DTS(out) = (GstClockTime) MAX(pts + delta, 0);
+			}
+			GST_BUFFER_PTS(out) = (GstClockTime) pts;
+
+			// Transfer: Full
+			gst_app_src_push_buffer(src, out);
+			[subscriber setBuffersPushed:[subscriber buffersPushed] + 1];
+		}
+	}
+
+	if (needsKeyframe) {
+		[self _requestKeyframe];
+	}
+}
+
+- (NSString *)description {
+	return [NSString stringWithFormat:@"<%@: %p> name: %@", NSStringFromClass([self class]), self,
+									  _name];
+}
+
+- (void)dealloc {
+	[self detach];
+}
+
+@end
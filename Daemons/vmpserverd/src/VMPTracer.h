@@ -0,0 +1,107 @@
+/* vmpserverd - A virtual multimedia processor
+ * Copyright (C) 2024 Hugo Melder
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#import <Foundation/Foundation.h>
+#import <gst/gst.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/// Number of samples kept per series. Older samples are discarded.
+extern const NSUInteger kVMPTracerWindowSize;
+
+/**
+ * @brief Per-element latency and CPU tracing of GStreamer pipelines
+ *
+ * The tracer installs a GstTracer in the process, which is notified whenever a
+ * buffer is pushed from one pad to another. Only pipelines registered with
+ * tracePipeline:channel: or tracePipeline:mountpointName: are measured.
+ *
+ * The following series are recorded:
+ * @li Processing time: Wall clock time an element spent handling a buffer in its
+ * chain function, excluding the time spent in downstream elements.
+ * @li CPU time: CPU time of the streaming thread spent in the element, excluding
+ * downstream elements.
+ * @li Queue dwell time: Time between a buffer entering, and leaving a queue.
+ * @li Latency: Time between a source element pushing a buffer, and a sink element
+ * receiving a buffer with the same timestamp.
+ *
+ * Each series keeps the last kVMPTracerWindowSize samples. Example structure
+ * of a series:
+ * @code
+ * {
+ *     "count": 90412, // Number of samples since the pipeline was registered
+ *     "mean": 0.42, // Milliseconds over the samples in the window
+ *     "p50": 0.31,
+ *     "p90": 0.77,
+ *     "p99": 2.1,
+ *     "max": 3.4,
+ *     "histogram": [
+ *         {"le": 0.05, "count": 3}, // Samples in the window per bucket
+ *         ...
+ *         {"le": "+Inf", "count": 0}
+ *     ]
+ * }
+ * @endcode
+ *
+ * Tracing adds overhead to every buffer pushed in the process, and is thus
+ * meant for diagnosing performance problems.
+ *
+ * All methods are MT-Safe.
+ */
+@interface VMPTracer : NSObject
+
+/**
+ * @brief Trace the pipeline of a channel
+ *
+ * The top-level pipeline of the given element is traced until it is finalised.
+ * Statistics of a previously traced pipeline of the channel are discarded.
+ */
+- (void)tracePipeline:(GstElement *)element channel:(NSString *)channel;
+
+/**
+ * @brief Trace the pipeline of an RTSP media
+ *
+ * @see tracePipeline:channel:
+ */
+- (void)tracePipeline:(GstElement *)element mountpointName:(NSString *)name;
+
+/**
+ * @brief Trace statistics of a channel
+ *
+ * Example structure:
+ * @code
+ * {
+ *     "window": 512, // Maximum number of samples per series
+ *     "elements": {
+ *         "x264enc0": {
+ *             "processing": <series>,
+ *             "cpu": <series>
+ *         }
+ *     },
+ *     "queues": {
+ *         "queue0": <series>
+ *     },
+ *     "latency": <series>
+ * }
+ * @endcode
+ *
+ * Elements are identified by their path in the pipeline, without the name of the
+ * pipeline.
+ *
+ * @returns the statistics, or nil if no pipeline is traced for the channel
+ */
+- (nullable NSDictionary *)statisticsForChannel:(NSString *)channel;
+
+/**
+ * @brief Trace statistics of the last constructed RTSP media of a mountpoint
+ *
+ * @see statisticsForChannel:
+ */
+- (nullable NSDictionary *)statisticsForMountpointName:(NSString *)name;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,613 @@
+/* vmpserverd - A virtual multimedia processor
+ * Copyright (C) 2024 Hugo Melder
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#import <glib.h>
+#import <stdlib.h>
+#import <string.h>
+#import <time.h>
+
+#import "VMPJournal.h"
+#import "VMPTracer.h"
+
+#define TRACE_WINDOW 512
+// Maximum number of buffers waiting in a queue that are tracked
+#define TRACE_PENDING_MAX 256
+// Number of recent source timestamps used for matching buffers at sinks
+#define TRACE_SOURCE_STAMPS 64
+
+const NSUInteger kVMPTracerWindowSize = TRACE_WINDOW;
+
+// Upper bounds of the histogram buckets in milliseconds
+static const double bucketBounds[] = {0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10, 25, 50, 100, 250, 1000};
+#define BUCKET_BOUND_COUNT (sizeof(bucketBounds) / sizeof(bucketBounds[0]))
+
+// Quark for attaching a trace_pipeline to a traced pipeline
+static GQuark traceQuark;
+
+#pragma mark - Trace Data
+
+// Ring buffer of samples in nanoseconds
+struct trace_series {
+	guint64 samples[TRACE_WINDOW];
+	guint64 count;
+};
+
+struct trace_element {
+	// Path of the element without the pipeline
+	gchar *name;
+	struct trace_series processing;
+	struct trace_series cpu;
+};
+
+struct trace_stamp {
+	GstClockTime pts;
+	GstClockTime time;
+};
+
+struct trace_queue {
+	gchar *name;
+	// Arrival of buffers at the queue (struct trace_stamp)
+	GQueue pending;
+	struct trace_series dwell;
+};
+
+// Dwell times of a queue, copied for computing statistics without holding the lock
+struct trace_queue_copy {
+	gchar *name;
+	struct trace_series dwell;
+};
+
+// Reference-counted trace data of a pipeline. Protected by lock.
+struct trace_pipeline {
+	GMutex lock;
+	// GstElement -> struct trace_element
+	GHashTable *elements;
+	// GstElement -> struct trace_queue
+	GHashTable *queues;
+	struct trace_stamp sourceStamps[TRACE_SOURCE_STAMPS];
+	guint nextSourceStamp;
+	struct trace_series latency;
+};
+
+static void trace_element_free(struct trace_element *element) {
+	g_free(element->name);
+	g_free(element);
+}
+
+static void trace_queue_free(struct trace_queue *queue) {
+	g_queue_clear_full(&queue->pending, g_free);
+	g_free(queue->name);
+	g_free(queue);
+}
+
+static void trace_pipeline_clear(struct trace_pipeline *pipeline) {
+	g_hash_table_unref(pipeline->elements);
+	g_hash_table_unref(pipeline->queues);
+	g_mutex_clear(&pipeline->lock);
+}
+
+static struct trace_pipeline *trace_pipeline_new(void) {
+	struct trace_pipeline *pipeline;
+
+	pipeline = g_atomic_rc_box_new0(struct trace_pipeline);
+	g_mutex_init(&pipeline->lock);
+	pipeline->elements =
+		g_hash_table_new_full(NULL, NULL, NULL, (GDestroyNotify) trace_element_free);
+	pipeline->queues = g_hash_table_new_full(NULL, NULL, NULL, (GDestroyNotify) trace_queue_free);
+
+	return pipeline;
+}
+
+static void trace_pipeline_release(gpointer pipeline) {
+	g_atomic_rc_box_release_full(pipeline, (GDestroyNotify) trace_pipeline_clear);
+}
+
+static void trace_series_add(struct trace_series *series, guint64 sample) {
+	series->samples[series->count % TRACE_WINDOW] = sample;
+	series->count++;
+}
+
+// Path of the element in its pipeline, e.g. "bin0/x264enc0"
+static gchar *element_name(GstElement *element) {
+	gchar *path;
+	gchar *name;
+	gchar *start;
+
+	path = gst_object_get_path_string(GST_OBJECT(element));
+	start = strchr(path + 1, '/');
+	name = g_strdup(start ? start + 1 : path);
+	g_free(path);
+
+	return name;
+}
+
+static gboolean is_queue(GstElement *element) {
+	return g_str_has_prefix(G_OBJECT_TYPE_NAME(element), "GstQueue");
+}
+
+static gint64 thread_cpu_time(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return (gint64) ts.tv_sec * GST_SECOND + ts.tv_nsec;
+}
+
+static struct trace_pipeline *trace_pipeline_for_object(GstObject *object) {
+	GstObject *parent;
+
+	// We only compare pointers while the pad is linked, so the parents are alive
+	while ((parent = GST_OBJECT_PARENT(object)) != NULL) {
+		object = parent;
+	}
+
+	return g_object_get_qdata(G_OBJECT(object), traceQuark);
+}
+
+// Called with the lock held
+static void trace_record_processing(struct trace_pipeline *pipeline, GstElement *element,
+									guint64 processing, guint64 cpu) {
+	struct trace_element *entry;
+
+	entry = g_hash_table_lookup(pipeline->elements, element);
+	if (entry == NULL) {
+		entry = g_new0(struct trace_element, 1);
+		entry->name = element_name(element);
+		g_hash_table_insert(pipeline->elements, element, entry);
+	}
+
+	trace_series_add(&entry->processing, processing);
+	trace_series_add(&entry->cpu, cpu);
+}
+
+/* Record queue dwell time, and end-to-end latency of a buffer pushed from
+ * the source element to the sink element.
+ *
+ * Buffers are identified by their presentation timestamp. Leaky queues drop
+ * buffers, so stamps older than the buffer leaving the queue are discarded.
+ */
+static void trace_buffer(struct trace_pipeline *pipeline, GstElement *src, GstElement *sink,
+						 GstClockTime pts, GstClockTime time) {
+	struct trace_queue *queue;
+	struct trace_stamp *stamp;
+	guint i;
+
+	g_mutex_lock(&pipeline->lock);
+
+	if (src != NULL && is_queue(src)) {
+		queue = g_hash_table_lookup(pipeline->queues, src);
+		while (queue != NULL && (stamp = g_queue_pop_head(&queue->pending)) != NULL) {
+			gboolean found;
+
+			found = !GST_CLOCK_TIME_IS_VALID(pts) || stamp->pts == pts;
+			if (found) {
+				trace_series_add(&queue->dwell, time - stamp->time);
+			}
+			g_free(stamp);
+			if (found) {
+				break;
+			}
+		}
+	}
+
+	if (sink != NULL && is_queue(sink)) {
+		queue = g_hash_table_lookup(pipeline->queues, sink);
+		if (queue == NULL) {
+			queue = g_new0(struct trace_queue, 1);
+			queue->name = element_name(sink);
+			g_queue_init(&queue->pending);
+			g_hash_table_insert(pipeline->queues, sink, queue);
+		}
+
+		if (g_queue_get_length(&queue->pending) >= TRACE_PENDING_MAX) {
+			g_free(g_queue_pop_head(&queue->pending));
+		}
+		stamp = g_new(struct trace_stamp, 1);
+		stamp->pts = pts;
+		stamp->time = time;
+		g_queue_push_tail(&queue->pending, stamp);
+	}
+
+	if (GST_CLOCK_TIME_IS_VALID(pts)) {
+		if (src != NULL && GST_OBJECT_FLAG_IS_SET(src, GST_ELEMENT_FLAG_SOURCE)) {
+			stamp = &pipeline->sourceStamps[pipeline->nextSourceStamp];
+			stamp->pts = pts;
+			stamp->time = time;
+			pipeline->nextSourceStamp = (pipeline->nextSourceStamp + 1) % TRACE_SOURCE_STAMPS;
+		}
+
+		if (sink != NULL && GST_OBJECT_FLAG_IS_SET(sink, GST_ELEMENT_FLAG_SINK)) {
+			for (i = 0; i < TRACE_SOURCE_STAMPS; i++) {
+				stamp = &pipeline->sourceStamps[i];
+				if (stamp->time != 0 && stamp->pts == pts) {
+					trace_series_add(&pipeline->latency, time - stamp->time);
+					break;
+				}
+			}
+		}
+	}
+
+	g_mutex_unlock(&pipeline->lock);
+}
+
+#pragma mark - GstTracer
+
+/* A push from one pad to its peer. The push returns after all elements downstream
+ * handled the buffer in the same thread, so frames of nested pushes form a stack
+ * per streaming thread.
+ */
+struct trace_frame {
+	// Not owned. NULL if the pipeline is not traced.
+	struct trace_pipeline *pipeline;
+	// Element receiving the buffer, or NULL for pads of bins
+	GstElement *element;
+	GstClockTime start;
+	GstClockTime children;
+	gint64 cpuStart;
+	gint64 cpuChildren;
+};
+
+static GPrivate traceStack = G_PRIVATE_INIT((GDestroyNotify) g_array_unref);
+
+static void trace_push_pre(GstClockTime ts, GstPad *pad, GstBuffer *buffer) {
+	struct trace_frame frame = {0};
+	GstObject *parent;
+	GArray *stack;
+	GstPad *peer;
+
+	stack = g_private_get(&traceStack);
+	if (stack == NULL) {
+		stack = g_array_new(FALSE, FALSE, sizeof(struct trace_frame));
+		g_private_set(&traceStack, stack);
+	}
+
+	peer = GST_PAD_PEER(pad);
+	if (peer != NULL) {
+		frame.pipeline = trace_pipeline_for_object(GST_OBJECT(peer));
+	}
+
+	if (frame.pipeline != NULL) {
+		GstElement *src = NULL;
+
+		// Pads of bins, and proxy pads of ghost pads only forward the buffer
+		parent = GST_OBJECT_PARENT(peer);
+		if (GST_IS_ELEMENT(parent) && !GST_IS_BIN(parent)) {
+			frame.element = GST_ELEMENT(parent);
+		}
+		parent = GST_OBJECT_PARENT(pad);
+		if (GST_IS_ELEMENT(parent) && !GST_IS_BIN(parent)) {
+			src = GST_ELEMENT(parent);
+		}
+
+		if (buffer != NULL) {
+			trace_buffer(frame.pipeline, src, frame.element, GST_BUFFER_PTS(buffer), ts);
+		}
+
+		frame.cpuStart = thread_cpu_time();
+	}
+	frame.start = ts;
+
+	g_array_append_val(stack, frame);
+}
+
+static void trace_push_post(GstClockTime ts) {
+	struct trace_frame frame;
+	GstClockTime total;
+	gint64 cpu = 0;
+	GArray *stack;
+
+	// The tracer may be installed while a buffer is pushed
+	stack = g_private_get(&traceStack);
+	if (stack == NULL || stack->len == 0) {
+		return;
+	}
+
+	frame = g_array_index(stack, struct trace_frame, stack->len - 1);
+	g_array_set_size(stack, stack->len - 1);
+
+	total = ts - frame.start;
+	if (frame.pipeline != NULL) {
+		cpu = thread_cpu_time() - frame.cpuStart;
+
+		if (frame.element != NULL) {
+			g_mutex_lock(&frame.pipeline->lock);
+			trace_record_processing(frame.pipeline, frame.element,
+									total > frame.children ? total - frame.children : 0,
+									(guint64) MAX(cpu - frame.cpuChildren, 0));
+			g_mutex_unlock(&frame.pipeline->lock);
+		}
+	}
+
+	if (stack->len > 0) {
+		struct trace_frame *upstream;
+
+		upstream = &g_array_index(stack, struct trace_frame, stack->len - 1);
+		upstream->children += total;
+		upstream->cpuChildren += cpu;
+	}
+}
+
+static void pad_push_pre_cb(GObject *tracer, GstClockTime ts, GstPad *pad, GstBuffer *buffer) {
+	trace_push_pre(ts, pad, buffer);
+}
+
+static void pad_push_list_pre_cb(GObject *tracer, GstClockTime ts, GstPad *pad,
+								 GstBufferList *list) {
+	GstBuffer *buffer = NULL;
+
+	if (gst_buffer_list_length(list) > 0) {
+		buffer = gst_buffer_list_get(list, 0);
+	}
+	trace_push_pre(ts, pad, buffer);
+}
+
+static void pad_push_post_cb(GObject *tracer, GstClockTime ts, GstPad *pad, GstFlowReturn res) {
+	trace_push_post(ts);
+}
+
+typedef struct {
+	GstTracer parent;
+} VMPGstTracer;
+
+typedef struct {
+	GstTracerClass parent_class;
+} VMPGstTracerClass;
+
+G_DEFINE_TYPE(VMPGstTracer, vmp_gst_tracer, GST_TYPE_TRACER)
+
+static void vmp_gst_tracer_class_init(VMPGstTracerClass *klass) {
+}
+
+static void vmp_gst_tracer_init(VMPGstTracer *self) {
+	GstTracer *tracer = GST_TRACER(self);
+
+	gst_tracing_register_hook(tracer, "pad-push-pre", G_CALLBACK(pad_push_pre_cb));
+	gst_tracing_register_hook(tracer, "pad-push-post", G_CALLBACK(pad_push_post_cb));
+	gst_tracing_register_hook(tracer, "pad-push-list-pre", G_CALLBACK(pad_push_list_pre_cb));
+	gst_tracing_register_hook(tracer, "pad-push-list-post", G_CALLBACK(pad_push_post_cb));
+}
+
+#pragma mark - VMPTracer
+
+// Holds a reference to the trace data of a pipeline
+@interface _VMPTracedPipeline : NSObject
+@property (nonatomic, readonly) struct trace_pipeline *data;
+- (instancetype)initWithData:(struct trace_pipeline *)data;
+@end
+
+@implementation _VMPTracedPipeline
+- (instancetype)initWithData:(struct trace_pipeline *)data {
+	self = [super init];
+	if (self) {
+		_data = g_atomic_rc_box_acquire(data);
+	}
+	return self;
+}
+
+- (void)dealloc {
+	trace_pipeline_release(_data);
+}
+@end
+
+static int compare_samples(const void *a, const void *b) {
+	guint64 x = *(const guint64 *) a;
+	guint64 y = *(const guint64 *) b;
+
+	return (x > y) - (x < y);
+}
+
+// Called on a copy of the series, as sorting is too slow for holding the lock of the pipeline
+static NSDictionary *series_statistics(const struct trace_series *series) {
+	NSMutableArray *histogram;
+	guint64 samples[TRACE_WINDOW];
+	guint counts[BUCKET_BOUND_COUNT + 1] = {0};
+	guint64 sum = 0;
+	guint n;
+	guint i;
+
+	n = (guint) MIN(series->count, TRACE_WINDOW);
+	if (n == 0) {
+		return @{@"count" : @0};
+	}
+
+	memcpy(samples, series->samples, n * sizeof(guint64));
+	qsort(samples, n, sizeof(guint64), compare_samples);
+
+	for (i = 0; i < n; i++) {
+		double ms = (double) samples[i] / GST_MSECOND;
+		guint bucket = 0;
+
+		while (bucket < BUCKET_BOUND_COUNT && ms > bucketBounds[bucket]) {
+			bucket++;
+		}
+		counts[bucket]++;
+		sum += samples[i];
+	}
+
+	histogram = [NSMutableArray arrayWithCapacity:BUCKET_BOUND_COUNT + 1];
+	for (i = 0; i < BUCKET_BOUND_COUNT; i++) {
+		[histogram addObject:@{@"le" : @(bucketBounds[i]), @"count" : @(counts[i])}];
+	}
+	[histogram addObject:@{@"le" : @"+Inf", @"count" : @(counts[BUCKET_BOUND_COUNT])}];
+
+#define PERCENTILE(p) @((double) samples[(n - 1) * (p) / 100] / GST_MSECOND)
+	return @{
+		@"count" : @(series->count),
+		@"mean" : @((double) sum / n / GST_MSECOND),
+		@"p50" : PERCENTILE(50),
+		@"p90" : PERCENTILE(90),
+		@"p99" : PERCENTILE(99),
+		@"max" : @((double) samples[n - 1] / GST_MSECOND),
+		@"histogram" : histogram,
+	};
+#undef PERCENTILE
+}
+
+@implementation VMPTracer {
+	NSMutableDictionary<NSString *, _VMPTracedPipeline *> *_channels;
+	NSMutableDictionary<NSString *, _VMPTracedPipeline *> *_mountpoints;
+}
+
++ (void)initialize {
+	if (self == [VMPTracer class]) {
+		traceQuark = g_quark_from_static_string("vmp-trace-pipeline");
+	}
+}
+
+- (instancetype)init {
+	static gsize installed = 0;
+
+	self = [super init];
+	if (self) {
+		_channels = [NSMutableDictionary dictionary];
+		_mountpoints = [NSMutableDictionary dictionary];
+
+		// Hooks are global, and cannot be removed. The tracer is thus never freed.
+		if (g_once_init_enter(&installed)) {
+			g_object_new(vmp_gst_tracer_get_type(), NULL);
+			VMPInfo(@"Installed pipeline tracer");
+			g_once_init_leave(&installed, 1);
+		}
+	}
+	return self;
+}
+
+- (_VMPTracedPipeline *)_tracePipeline:(GstElement *)element {
+	struct trace_pipeline *data;
+	_VMPTracedPipeline *traced;
+	GstObject *pipeline;
+	GstObject *parent;
+
+	pipeline = gst_object_ref(GST_OBJECT(element));
+	while ((parent = gst_object_get_parent(pipeline)) != NULL) {
+		gst_object_unref(pipeline);
+		pipeline = parent;
+	}
+
+	data = trace_pipeline_new();
+	traced = [[_VMPTracedPipeline alloc] initWithData:data];
+	// Transfer the initial reference to the pipeline
+	g_object_set_qdata_full(G_OBJECT(pipeline), traceQuark, data, trace_pipeline_release);
+	gst_object_unref(pipeline);
+
+	return traced;
+}
+
+- (void)tracePipeline:(GstElement *)element channel:(NSString *)channel {
+	_VMPTracedPipeline *traced = [self _tracePipeline:element];
+
+	@synchronized(self) {
+		_channels[channel] = traced;
+	}
+}
+
+- (void)tracePipeline:(GstElement *)element mountpointName:(NSString *)name {
+	_VMPTracedPipeline *traced = [self _tracePipeline:element];
+
+	@synchronized(self) {
+		_mountpoints[name] = traced;
+	}
+}
+
+/* The streaming threads take the lock of the pipeline for every buffer. The
+ * series are copied under the lock, and sorted after releasing it.
+ */
+- (NSDictionary *)_statisticsForTracedPipeline:(_VMPTracedPipeline *)traced {
+	struct trace_pipeline *data = [traced data];
+	struct trace_series *latencyCopy;
+	NSMutableDictionary *elements;
+	NSMutableDictionary *queues;
+	NSDictionary *latency;
+	GArray *elementCopies;
+	GArray *queueCopies;
+	GHashTableIter iter;
+	gpointer value;
+	guint i;
+
+	elementCopies = g_array_new(FALSE, FALSE, sizeof(struct trace_element));
+	queueCopies = g_array_new(FALSE, FALSE, sizeof(struct trace_queue_copy));
+	latencyCopy = g_new(struct trace_series, 1);
+
+	g_mutex_lock(&data->lock);
+
+	g_hash_table_iter_init(&iter, data->elements);
+	while (g_hash_table_iter_next(&iter, NULL, &value)) {
+		struct trace_element copy = *(struct trace_element *) value;
+
+		copy.name = g_strdup(copy.name);
+		g_array_append_val(elementCopies, copy);
+	}
+
+	g_hash_table_iter_init(&iter, data->queues);
+	while (g_hash_table_iter_next(&iter, NULL, &value)) {
+		struct trace_queue *queue = value;
+		struct trace_queue_copy copy = {g_strdup(queue->name), queue->dwell};
+
+		g_array_append_val(queueCopies, copy);
+	}
+
+	*latencyCopy = data->latency;
+
+	g_mutex_unlock(&data->lock);
+
+	elements = [NSMutableDictionary dictionaryWithCapacity:elementCopies->len];
+	for (i = 0; i < elementCopies->len; i++) {
+		struct trace_element *element = &g_array_index(elementCopies, struct trace_element, i);
+
+		elements[[NSString stringWithUTF8String:element->name]] = @{
+			@"processing" : series_statistics(&element->processing),
+			@"cpu" : series_statistics(&element->cpu),
+		};
+		g_free(element->name);
+	}
+	g_array_free(elementCopies, TRUE);
+
+	queues = [NSMutableDictionary dictionaryWithCapacity:queueCopies->len];
+	for (i = 0; i < queueCopies->len; i++) {
+		struct trace_queue_copy *queue = &g_array_index(queueCopies, struct trace_queue_copy, i);
+
+		queues[[NSString stringWithUTF8String:queue->name]] = series_statistics(&queue->dwell);
+		g_free(queue->name);
+	}
+	g_array_free(queueCopies, TRUE);
+
+	latency = series_statistics(latencyCopy);
+	g_free(latencyCopy);
+
+	return @{
+		@"window" : @(kVMPTracerWindowSize),
+		@"elements" : elements,
+		@"queues" : queues,
+		@"latency" : latency,
+	};
+}
+
+- (NSDictionary *)statisticsForChannel:(NSString *)channel {
+	_VMPTracedPipeline *traced;
+
+	@synchronized(self) {
+		traced = _channels[channel];
+	}
+	if (!traced) {
+		return nil;
+	}
+
+	return [self _statisticsForTracedPipeline:traced];
+}
+
+- (NSDictionary *)statisticsForMountpointName:(NSString *)name {
+	_VMPTracedPipeline *traced;
+
+	@synchronized(self) {
+		traced = _mountpoints[name];
+	}
+	if (!traced) {
+		return nil;
+	}
+
+	return [self _statisticsForTracedPipeline:traced];
+}
+
+@end
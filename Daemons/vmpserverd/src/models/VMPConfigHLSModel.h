@@ -0,0 +1,61 @@
+/* vmpserverd - A virtual multimedia processor
+ * Copyright (C) 2024 Hugo Melder
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#import <Foundation/Foundation.h>
+
+#import "VMPPropertyListProtocol.h"
+
+/**
+	@brief Configuration of the HLS egress
+
+	Every mountpoint is additionally segmented into an HLS playlist, and
+	segments, which are written to a subdirectory of the target directory.
+
+	Example:
+	<dict>
+		<key>directory</key>
+		<string>/dev/shm/vmpserverd/hls</string>
+		<key>segmentDuration</key>
+		<integer>2</integer>
+		<key>playlistLength</key>
+		<integer>6</integer>
+	</dict>
+*/
+@interface VMPConfigHLSModel : NSObject <VMPPropertyListProtocol>
+
+/**
+	@brief Target directory for playlists and segments
+
+	A tmpfs (e.g. /dev/shm) is recommended, as segments are rewritten continuously.
+*/
+@property (nonatomic, strong) NSString *directory;
+
+/**
+	@brief Target duration of a segment in seconds (optional, defaults to 2)
+*/
+@property (nonatomic, strong) NSNumber *segmentDuration;
+
+/**
+	@brief Number of segments in the playlist (optional, defaults to 6)
+*/
+@property (nonatomic, strong) NSNumber *playlistLength;
+
+/**
+	@brief Serve playlists and segments at /hls/ with the HTTP server (optional, defaults
+	to YES)
+*/
+@property (nonatomic, strong) NSNumber *serve;
+
+/**
+	@brief Names of the segmented mountpoints (optional, defaults to all mountpoints)
+*/
+@property (nonatomic, strong) NSArray<NSString *> *mountpoints;
+
+- (id)initWithPropertyList:(id)propertyList error:(NSError **)error;
+
+- (id)propertyList;
+
+@end
@@ -0,0 +1,57 @@
+/* vmpserverd - A virtual multimedia processor
+ * Copyright (C) 2024 Hugo Melder
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#import "VMPConfigHLSModel.h"
+#import "VMPErrors.h"
+#import "VMPJournal.h"
+#import "VMPModelCommon.h"
+
+@implementation VMPConfigHLSModel
+
+- (id)initWithPropertyList:(id)propertyList error:(NSError **)error {
+	VMP_ASSERT([propertyList isKindOfClass:[NSDictionary class]],
+			   @"propertyList is not a dictionary");
+
+	self = [super init];
+	if (self) {
+		SET_PROPERTY(_directory, @"directory");
+
+		// Optional properties
+		_segmentDuration = propertyList[@"segmentDuration"] ?: @2;
+		_playlistLength = propertyList[@"playlistLength"] ?: @6;
+		_serve = propertyList[@"serve"] ?: @YES;
+		_mountpoints = propertyList[@"mountpoints"];
+
+		if ([_segmentDuration unsignedIntegerValue] == 0 ||
+			[_playlistLength unsignedIntegerValue] == 0) {
+			VMP_FAST_ERROR(error, VMPErrorCodePropertyListError,
+						   @"'segmentDuration', and 'playlistLength' must be positive");
+			return nil;
+		}
+	}
+
+	return self;
+}
+
+- (id)propertyList {
+	NSMutableDictionary *plist;
+
+	VMP_ASSERT(_directory, @"directory is nil");
+
+	plist = [NSMutableDictionary dictionaryWithDictionary:@{
+		@"directory" : _directory,
+		@"segmentDuration" : _segmentDuration,
+		@"playlistLength" : _playlistLength,
+		@"serve" : _serve,
+	}];
+	if (_mountpoints) {
+		plist[@"mountpoints"] = _mountpoints;
+	}
+
+	return plist;
+}
+
+@end
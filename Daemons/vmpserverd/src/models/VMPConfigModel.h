@@ -7,9 +7,22 @@
 #import <Foundation/Foundation.h>
 
 #import "VMPConfigChannelModel.h"
+#import "VMPConfigHLSModel.h"
 #import "VMPConfigMountpointModel.h"
 #import "VMPPropertyListProtocol.h"
 
+/// Connect channels and consumers with intervideosink, and intervideosrc
+extern NSString *const VMPConfigChannelBusInterVideo;
+/// Connect channels and consumers with the in-process channel bus (appsink, and appsrc)
+extern NSString *const VMPConfigChannelBusNative;
+
+/// Run all HTTP handlers on a single thread
+extern NSString *const VMPConfigHTTPThreadingInternal;
+/// Run HTTP handlers on a fixed number of threads
+extern NSString *const VMPConfigHTTPThreadingPool;
+/// Run the HTTP handlers of every connection on its own thread
+extern NSString *const VMPConfigHTTPThreadingPerConnection;
+
 @interface VMPConfigModel : NSObject <VMPPropertyListProtocol>
 
 @property (nonatomic, strong) NSString *name;
@@ -34,10 +47,144 @@
 
 @property (nonatomic, strong) NSString *gstDebug;
 
+/**
+	@brief Start channel pipelines only when they are consumed (optional, defaults to NO)
+
+	Channels are then started when the first RTSP media or recording using the channel
+	is created, and stopped after channelIdleTimeout seconds without consumers.
+*/
+@property (nonatomic, strong) NSNumber *onDemandChannels;
+
+/**
+	@brief Grace period in seconds before stopping an unused on-demand channel (optional,
+	defaults to 30)
+*/
+@property (nonatomic, strong) NSNumber *channelIdleTimeout;
+
+/**
+	@brief Transport between video channels and their consumers (optional, defaults to
+	"intervideo")
+
+	"native" hands out buffers of a channel to all consumers without copying them.
+	Unlike intervideosrc, consumers do not receive black frames while the channel is
+	stopped.
+*/
+@property (nonatomic, strong) NSString *channelBus;
+
+/**
+	@brief Number of buffers queued per consumer on the native channel bus, and shared
+	encoders before buffers are dropped (optional, defaults to 4)
+*/
+@property (nonatomic, strong) NSNumber *channelBusQueueSize;
+
+/**
+	@brief Number of buffers queued per consumer of shared audio before buffers are
+	dropped (optional, defaults to 64)
+*/
+@property (nonatomic, strong) NSNumber *audioBusQueueSize;
+
+/**
+	@brief Seconds without a buffer reaching the sink of a channel, shared encoder,
+	or HLS pipeline after which the pipeline is restarted (optional, defaults to 0
+	for disabled)
+*/
+@property (nonatomic, strong) NSNumber *channelStallTimeout;
+
+/**
+	@brief Number of threads handling RTSP clients (optional, defaults to 1)
+
+	A value of -1 allows an unlimited number of threads.
+*/
+@property (nonatomic, strong) NSNumber *rtspThreadPoolSize;
+
+/**
+	@brief Maximum number of RTSP sessions of the server (optional, defaults to 0 for
+	unlimited)
+*/
+@property (nonatomic, strong) NSNumber *rtspMaxSessions;
+
+/**
+	@brief Maximum number of RTSP sessions per mountpoint (optional, defaults to 0 for
+	unlimited)
+
+	Can be overridden with the "maxClients" property of a mountpoint.
+*/
+@property (nonatomic, strong) NSNumber *rtspMaxClientsPerMountpoint;
+
+/**
+	@brief Seconds without keep-alive after which an RTSP session is removed (optional,
+	defaults to 60)
+*/
+@property (nonatomic, strong) NSNumber *rtspSessionTimeout;
+
+/**
+	@brief Trace the processing time, and latency of elements in channel, and mountpoint
+	pipelines (optional, defaults to false)
+*/
+@property (nonatomic, strong) NSNumber *tracing;
+
+/**
+	@brief Seconds between two samples of the fill level of queues in pipelines
+	(optional, defaults to 1, 0 disables sampling)
+*/
+@property (nonatomic, strong) NSNumber *queueSampleInterval;
+
+/**
+	@brief Seconds a queue must be saturated before a warning is logged (optional,
+	defaults to 10)
+*/
+@property (nonatomic, strong) NSNumber *queueSaturationTimeout;
+
+/**
+	@brief Seconds after which the main run loop, the GLib main context, or an HTTP
+	handler is considered stalled (optional, defaults to 0.5, 0 disables the watchdog)
+*/
+@property (nonatomic, strong) NSNumber *loopStallThreshold;
+
+/**
+	@brief Threads running the HTTP handlers: "internal", "pool", or "perConnection"
+	(optional, defaults to "internal")
+*/
+@property (nonatomic, strong) NSString *httpThreadingModel;
+
+/**
+	@brief Number of threads of the "pool" threading model (optional, defaults to 4)
+*/
+@property (nonatomic, strong) NSNumber *httpThreadPoolSize;
+
+/**
+	@brief Syscall used by the HTTP server to poll connections: "auto", "poll", or
+	"epoll" (optional, defaults to "auto")
+*/
+@property (nonatomic, strong) NSString *httpPollingMode;
+
+/**
+	@brief Maximum number of HTTP connections (optional, defaults to 0 for the
+	default of libmicrohttpd)
+*/
+@property (nonatomic, strong) NSNumber *httpConnectionLimit;
+
+/**
+	@brief Maximum number of HTTP connections per IP address (optional, defaults to
+	0 for unlimited)
+*/
+@property (nonatomic, strong) NSNumber *httpPerIPConnectionLimit;
+
+/**
+	@brief Seconds after which an idle HTTP connection is closed (optional, defaults
+	to 0 for no timeout)
+*/
+@property (nonatomic, strong) NSNumber *httpConnectionTimeout;
+
 @property (nonatomic, strong) NSArray<id> *locations;
 
 @property (nonatomic, strong) NSArray<VMPConfigMountpointModel *> *mountpoints;
 
+/**
+	@brief HLS egress for mountpoints (optional, nil if HLS is disabled)
+*/
+@property (nonatomic, strong) VMPConfigHLSModel *hls;
+
 @property (nonatomic, strong) NSArray<VMPConfigChannelModel *> *channels;
 
 - (NSArray *)propertyListMountpoints;
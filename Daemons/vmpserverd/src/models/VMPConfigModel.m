@@ -8,6 +8,13 @@
 #import "VMPJournal.h"
 #import "VMPModelCommon.h"
 
+NSString *const VMPConfigChannelBusInterVideo = @"intervideo";
+NSString *const VMPConfigChannelBusNative = @"native";
+
+NSString *const VMPConfigHTTPThreadingInternal = @"internal";
+NSString *const VMPConfigHTTPThreadingPool = @"pool";
+NSString *const VMPConfigHTTPThreadingPerConnection = @"perConnection";
+
 @implementation VMPConfigModel
 
 - (id)initWithPropertyList:(id)propertyList error:(NSError **)error {
@@ -18,6 +25,7 @@
 	if (self) {
 		NSMutableArray *mountpoints, *channels;
 		NSArray *plistMountpoints, *plistChannels;
+		NSDictionary *plistHLS;
 
 		SET_PROPERTY(_name, @"name");
 		SET_PROPERTY(_profileDirectory, @"profileDirectory");
@@ -32,6 +40,48 @@
 		SET_PROPERTY(_gstDebug, @"gstDebug");
 		SET_PROPERTY(_locations, @"locations");
 
+		// Optional properties
+		_onDemandChannels = propertyList[@"onDemandChannels"] ?: @NO;
+		_channelIdleTimeout = propertyList[@"channelIdleTimeout"] ?: @30;
+		_channelBus = propertyList[@"channelBus"] ?: VMPConfigChannelBusInterVideo;
+		_channelBusQueueSize = propertyList[@"channelBusQueueSize"] ?: @4;
+		_audioBusQueueSize = propertyList[@"audioBusQueueSize"] ?: @64;
+		_channelStallTimeout = propertyList[@"channelStallTimeout"] ?: @0;
+		_rtspThreadPoolSize = propertyList[@"rtspThreadPoolSize"] ?: @1;
+		_rtspMaxSessions = propertyList[@"rtspMaxSessions"] ?: @0;
+		_rtspMaxClientsPerMountpoint = propertyList[@"rtspMaxClientsPerMountpoint"] ?: @0;
+		_rtspSessionTimeout = propertyList[@"rtspSessionTimeout"] ?: @60;
+		_tracing = propertyList[@"tracing"] ?: @NO;
+		_queueSampleInterval = propertyList[@"queueSampleInterval"] ?: @1;
+		_queueSaturationTimeout = propertyList[@"queueSaturationTimeout"] ?: @10;
+		_loopStallThreshold = propertyList[@"loopStallThreshold"] ?: @0.5;
+		_httpThreadingModel = propertyList[@"httpThreadingModel"] ?: VMPConfigHTTPThreadingInternal;
+		_httpThreadPoolSize = propertyList[@"httpThreadPoolSize"] ?: @4;
+		_httpPollingMode = propertyList[@"httpPollingMode"] ?: @"auto";
+		_httpConnectionLimit = propertyList[@"httpConnectionLimit"] ?: @0;
+		_httpPerIPConnectionLimit = propertyList[@"httpPerIPConnectionLimit"] ?: @0;
+		_httpConnectionTimeout = propertyList[@"httpConnectionTimeout"] ?: @0;
+
+		if (![_channelBus isEqualToString:VMPConfigChannelBusInterVideo] &&
+			![_channelBus isEqualToString:VMPConfigChannelBusNative]) {
+			VMP_FAST_ERROR(error, VMPErrorCodePropertyListError,
+						   @"'channelBus' must be either 'intervideo' or 'native'");
+			return nil;
+		}
+
+		if (![_httpThreadingModel isEqualToString:VMPConfigHTTPThreadingInternal] &&
+			![_httpThreadingModel isEqualToString:VMPConfigHTTPThreadingPool] &&
+			![_httpThreadingModel isEqualToString:VMPConfigHTTPThreadingPerConnection]) {
+			VMP_FAST_ERROR(error, VMPErrorCodePropertyListError,
+						   @"'httpThreadingModel' must be 'internal', 'pool', or 'perConnection'");
+			return nil;
+		}
+		if (![@[ @"auto", @"poll", @"epoll" ] containsObject:_httpPollingMode]) {
+			VMP_FAST_ERROR(error, VMPErrorCodePropertyListError,
+						   @"'httpPollingMode' must be 'auto', 'poll', or 'epoll'");
+			return nil;
+		}
+
 		SET_PROPERTY(plistMountpoints, @"mountpoints");
 		SET_PROPERTY(plistChannels, @"channels");
 
@@ -57,6 +107,14 @@
 
 		_mountpoints = [mountpoints copy];
 		_channels = [channels copy];
+
+		plistHLS = propertyList[@"hls"];
+		if (plistHLS) {
+			_hls = [[VMPConfigHLSModel alloc] initWithPropertyList:plistHLS error:error];
+			if (!_hls) {
+				return nil;
+			}
+		}
 	}
 
 	return self;
@@ -99,7 +157,7 @@
 	VMP_ASSERT(_mountpoints, @"mountpoints is nil");
 	VMP_ASSERT(_channels, @"channels is nil");
 
-	return @{
+	NSMutableDictionary *plist = [NSMutableDictionary dictionaryWithDictionary:@{
 		@"name" : _name,
 		@"icalURL" : _icalURL,
 		@"rtspAddress" : _rtspAddress,
@@ -108,9 +166,34 @@
 		@"httpUsername" : _httpUsername,
 		@"httpPassword" : _httpPassword,
 		@"gstDebug" : _gstDebug,
+		@"onDemandChannels" : _onDemandChannels,
+		@"channelIdleTimeout" : _channelIdleTimeout,
+		@"channelBus" : _channelBus,
+		@"channelBusQueueSize" : _channelBusQueueSize,
+		@"audioBusQueueSize" : _audioBusQueueSize,
+		@"channelStallTimeout" : _channelStallTimeout,
+		@"rtspThreadPoolSize" : _rtspThreadPoolSize,
+		@"rtspMaxSessions" : _rtspMaxSessions,
+		@"rtspMaxClientsPerMountpoint" : _rtspMaxClientsPerMountpoint,
+		@"rtspSessionTimeout" : _rtspSessionTimeout,
+		@"tracing" : _tracing,
+		@"queueSampleInterval" : _queueSampleInterval,
+		@"queueSaturationTimeout" : _queueSaturationTimeout,
+		@"loopStallThreshold" : _loopStallThreshold,
+		@"httpThreadingModel" : _httpThreadingModel,
+		@"httpThreadPoolSize" : _httpThreadPoolSize,
+		@"httpPollingMode" : _httpPollingMode,
+		@"httpConnectionLimit" : _httpConnectionLimit,
+		@"httpPerIPConnectionLimit" : _httpPerIPConnectionLimit,
+		@"httpConnectionTimeout" : _httpConnectionTimeout,
 		@"mountpoints" : [self propertyListMountpoints],
 		@"channels" : [self propertyListChannels],
-	};
+	}];
+	if (_hls) {
+		plist[@"hls"] = [_hls propertyList];
+	}
+
+	return plist;
 }
 
 @end
\ No newline at end of file
@@ -10,6 +10,7 @@
 
 #include <gst/gstelement.h>
 
+#import "VMPPadModel.h"
 #import "VMPPropertyListProtocol.h"
 
 @interface VMPElementModel : NSObject <VMPPropertyListProtocol>
@@ -18,8 +19,19 @@
 
 @property (nonatomic, strong) NSString *className;
 
+/**
+	@brief Name of the element factory, e.g. "x264enc", or nil if the element
+	was not created by a factory
+*/
+@property (nonatomic, strong) NSString *factoryName;
+
 @property (nonatomic, strong) NSString *state;
 
+/**
+	@brief Pads of the element, including request, and ghost pads
+*/
+@property (nonatomic, strong) NSArray<VMPPadModel *> *pads;
+
 @property (nonatomic, strong) NSArray<VMPElementModel *> *children;
 
 + (instancetype)modelWithGstElement:(GstElement *)element;
@@ -12,6 +12,18 @@
 #include "gst/gstelement.h"
 #include "gst/gstutils.h"
 
+// Copy a list of GstObjects while holding the lock of their parent.
+// Transfer: FULL. Free with g_list_free_full(list, gst_object_unref).
+static GList *copy_object_list(GstObject *parent, GList *list) {
+	GList *copy;
+
+	GST_OBJECT_LOCK(parent);
+	copy = g_list_copy_deep(list, (GCopyFunc) gst_object_ref, NULL);
+	GST_OBJECT_UNLOCK(parent);
+
+	return copy;
+}
+
 @implementation VMPElementModel
 
 + (instancetype)modelWithGstElement:(GstElement *)element {
@@ -26,17 +38,34 @@
 		gchar *name;
 		const gchar *className;
 		const gchar *state;
+		GstElementFactory *factory;
+		NSMutableArray *padsArray;
+		GList *pads;
 
 		// Transfer: FULL
 		name = gst_element_get_name(element);
 		// Transfer: NONE
-		state = gst_element_state_get_name(element->current_state);
+		state = gst_element_state_get_name(GST_STATE(element));
 		// Transfer: NONE
 		className = G_OBJECT_TYPE_NAME(element);
+		// Transfer: NONE
+		factory = gst_element_get_factory(element);
 
 		_name = [NSString stringWithUTF8String:name];
 		_state = [NSString stringWithUTF8String:state];
 		_className = [NSString stringWithUTF8String:className];
+		if (factory) {
+			_factoryName = [NSString stringWithUTF8String:GST_OBJECT_NAME(factory)];
+		}
+
+		// Pads are copied, as they can be added, or removed from a streaming thread
+		pads = copy_object_list(GST_OBJECT(element), element->pads);
+		padsArray = [NSMutableArray arrayWithCapacity:g_list_length(pads)];
+		for (GList *l = pads; l != NULL; l = l->next) {
+			[padsArray addObject:[VMPPadModel modelWithGstPad:GST_PAD(l->data)]];
+		}
+		g_list_free_full(pads, gst_object_unref);
+		_pads = [padsArray copy];
 
 		// Object is a bin and has children
 		if (GST_IS_BIN(element)) {
@@ -46,7 +75,7 @@
 			GList *children;
 
 			bin = GST_BIN(element);
-			children = bin->children;
+			children = copy_object_list(GST_OBJECT(bin), bin->children);
 			numberOfChildren = (NSUInteger) g_list_length(children);
 			childrenArray = [NSMutableArray arrayWithCapacity:numberOfChildren];
 
@@ -61,6 +90,7 @@
 
 				[childrenArray addObject:child];
 			}
+			g_list_free_full(children, gst_object_unref);
 
 			_children = [childrenArray copy];
 		} else {
@@ -74,9 +104,36 @@
 - (id)initWithPropertyList:(id)propertyList error:(NSError **)error {
 	self = [super init];
 	if (self) {
+		NSArray *pads;
+		NSArray *children;
+
 		SET_PROPERTY(_name, @"name");
 		SET_PROPERTY(_className, @"className");
 		SET_PROPERTY(_state, @"state");
+		SET_PROPERTY(pads, @"pads");
+		SET_PROPERTY(children, @"children");
+		_factoryName = propertyList[@"factoryName"];
+
+		NSMutableArray *padsArray = [NSMutableArray arrayWithCapacity:[pads count]];
+		for (id pad in pads) {
+			VMPPadModel *model = [[VMPPadModel alloc] initWithPropertyList:pad error:error];
+			if (!model) {
+				return nil;
+			}
+			[padsArray addObject:model];
+		}
+		_pads = [padsArray copy];
+
+		NSMutableArray *childrenArray = [NSMutableArray arrayWithCapacity:[children count]];
+		for (id child in children) {
+			VMPElementModel *model = [[VMPElementModel alloc] initWithPropertyList:child
+																			 error:error];
+			if (!model) {
+				return nil;
+			}
+			[childrenArray addObject:model];
+		}
+		_children = [childrenArray copy];
 	}
 	return self;
 }
@@ -85,8 +142,28 @@
 	VMP_ASSERT(_className, @"className must not be nil");
 	VMP_ASSERT(_state, @"state must not be nil");
 
-	return
-		@{@"name" : _name, @"className" : _className, @"state" : _state, @"children" : _children};
+	NSMutableArray *pads = [NSMutableArray arrayWithCapacity:[_pads count]];
+	for (VMPPadModel *pad in _pads) {
+		[pads addObject:[pad propertyList]];
+	}
+
+	NSMutableArray *children = [NSMutableArray arrayWithCapacity:[_children count]];
+	for (VMPElementModel *child in _children) {
+		[children addObject:[child propertyList]];
+	}
+
+	NSMutableDictionary *dict = [NSMutableDictionary dictionaryWithDictionary:@{
+		@"name" : _name,
+		@"className" : _className,
+		@"state" : _state,
+		@"pads" : pads,
+		@"children" : children
+	}];
+	if (_factoryName) {
+		dict[@"factoryName"] = _factoryName;
+	}
+
+	return dict;
 }
 
 @end
\ No newline at end of file
@@ -9,9 +9,9 @@
 
 #include <gst/gstpad.h>
 
-extern NSString *VMPPadDirectionSrc;
-extern NSString *VMPPadDirectionSink;
-extern NSString *VMPPadDirectionUnknown;
+extern NSString *const VMPPadDirectionSrc;
+extern NSString *const VMPPadDirectionSink;
+extern NSString *const VMPPadDirectionUnknown;
 
 @interface VMPPadModel : NSObject <VMPPropertyListProtocol>
 
@@ -22,13 +22,24 @@ extern NSString *VMPPadDirectionUnknown;
 @property (nonatomic, assign) BOOL linked;
 
 /**
-	@brief The name of the element that this pad is linked to
+	@brief The name of the element that this pad is linked to, or nil if unlinked
 
-	@note You can assume that this element is in the same bin
-	as the element that this pad belongs to
+	@note The element is usually in the same bin as the element that this pad
+	belongs to. If the pad is linked to the inside of a ghost pad, this is
+	the bin owning the ghost pad.
 */
 @property (nonatomic, strong) NSString *linkedElement;
 
+/**
+	@brief The name of the peer pad, or nil if unlinked
+*/
+@property (nonatomic, strong) NSString *linkedPad;
+
+/**
+	@brief The negotiated caps of the pad, or nil if no caps were negotiated yet
+*/
+@property (nonatomic, strong) NSString *caps;
+
 + (instancetype)modelWithGstPad:(GstPad *)pad;
 
 - (instancetype)initWithGstPad:(GstPad *)pad;
@@ -9,9 +9,9 @@
 #include "VMPModelCommon.h"
 #include "gst/gstpad.h"
 
-const NSString *VMPPadDirectionSrc = @"src";
-const NSString *VMPPadDirectionSink = @"sink";
-const NSString *VMPPadDirectionUnknown = @"unknown";
+NSString *const VMPPadDirectionSrc = @"src";
+NSString *const VMPPadDirectionSink = @"sink";
+NSString *const VMPPadDirectionUnknown = @"unknown";
 
 @implementation VMPPadModel
 
@@ -25,12 +25,50 @@ const NSString *VMPPadDirectionUnknown = @"unknown";
 	self = [super init];
 	if (self) {
 		gchar *name;
+		GstCaps *caps;
+		GstPad *peer;
 
 		// Transfer: FULL
 		name = gst_pad_get_name(pad);
 
 		_name = [NSString stringWithUTF8String:name];
 
+		// Transfer: FULL
+		caps = gst_pad_get_current_caps(pad);
+		if (caps) {
+			gchar *capsStr = gst_caps_to_string(caps);
+
+			_caps = [NSString stringWithUTF8String:capsStr];
+			g_free(capsStr);
+			gst_caps_unref(caps);
+		}
+
+		// Transfer: FULL
+		peer = gst_pad_get_peer(pad);
+		if (peer) {
+			GstObject *parent;
+
+			_linked = YES;
+			_linkedPad = [NSString stringWithUTF8String:GST_OBJECT_NAME(peer)];
+
+			// Transfer: FULL
+			parent = gst_object_get_parent(GST_OBJECT(peer));
+			// The peer is the internal pad of a ghost pad. Report the bin instead.
+			if (parent && GST_IS_PAD(parent)) {
+				GstObject *ghostParent = gst_object_get_parent(parent);
+
+				_linkedPad = [NSString stringWithUTF8String:GST_OBJECT_NAME(parent)];
+				gst_object_unref(parent);
+				parent = ghostParent;
+			}
+			if (parent) {
+				_linkedElement = [NSString stringWithUTF8String:GST_OBJECT_NAME(parent)];
+				gst_object_unref(parent);
+			}
+
+			gst_object_unref(peer);
+		}
+
 		switch (GST_PAD_DIRECTION(pad)) {
 		case GST_PAD_SRC:
 			_direction = VMPPadDirectionSrc;
@@ -58,9 +96,11 @@ const NSString *VMPPadDirectionUnknown = @"unknown";
 		SET_PROPERTY(_name, @"name");
 		SET_PROPERTY(_direction, @"direction");
 		SET_PROPERTY(linked, @"linked");
-		SET_PROPERTY(_linkedElement, @"linkedElement");
 
 		_linked = [linked boolValue];
+		_linkedElement = propertyList[@"linkedElement"];
+		_linkedPad = propertyList[@"linkedPad"];
+		_caps = propertyList[@"caps"];
 	}
 
 	return self;
@@ -68,14 +108,23 @@ const NSString *VMPPadDirectionUnknown = @"unknown";
 - (id)propertyList {
 	VMP_ASSERT(_name, @"name must not be nil");
 	VMP_ASSERT(_direction, @"direction must not be nil");
-	VMP_ASSERT(_linkedElement, @"linkedElement must not be nil");
 
-	return @{
+	NSMutableDictionary *dict = [NSMutableDictionary dictionaryWithDictionary:@{
 		@"name" : _name,
 		@"direction" : _direction,
 		@"linked" : @(_linked),
-		@"linkedElement" : _linkedElement
-	};
+	}];
+	if (_linkedElement) {
+		dict[@"linkedElement"] = _linkedElement;
+	}
+	if (_linkedPad) {
+		dict[@"linkedPad"] = _linkedPad;
+	}
+	if (_caps) {
+		dict[@"caps"] = _caps;
+	}
+
+	return dict;
 }
 
 @end
\ No newline at end of file
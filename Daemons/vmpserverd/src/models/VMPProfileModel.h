@@ -70,6 +70,34 @@ extern NSString *const VMPProfilePlatformVAAPI;
 
 @property (nonatomic, strong) NSDictionary<NSString *, NSString *> *recordings;
 
+/**
+	@brief Pipeline templates for sharing an encoded video stream (optional, may be nil)
+
+	If present, video channels are encoded once per encoding configuration, and
+	single mountpoints and recordings consume the encoded stream.
+
+	- "video" - Encodes the video channel {VIDEOCHANNEL} to {WIDTH}x{HEIGHT} with
+	  {BITRATE} kbps. A key frame must be produced on a force-key-unit event.
+	- "combined" - Composites, and encodes the channels {VIDEOSRC.0}, and {VIDEOSRC.1} of a
+	  combined mountpoint (optional). The encoded stream must be the last chain.
+	- "mountpoint" - Payloads the encoded stream for a single, or combined mountpoint
+	- "recording" - Prepares the encoded stream for muxing in a recording
+*/
+@property (nonatomic, strong) NSDictionary<NSString *, NSString *> *sharedEncoders;
+
+/**
+	@brief Pipeline templates for sharing an audio capture (optional, may be nil)
+
+	If present, every audio channel is captured once, and the raw audio is
+	shared between all mountpoints and recordings consuming the channel.
+
+	- "pulse" - Captures the PulseAudio device {PULSEDEV}
+	- "audioTest" - Produces a test signal
+	- "mountpoint" - Encodes, and payloads the shared audio for a mountpoint
+	- "recording" - Encodes the shared audio with {BITRATE} bps for a recording
+*/
+@property (nonatomic, strong) NSDictionary<NSString *, NSString *> *sharedAudio;
+
 /**
 	@brief Load a profile from a propertyList representation.
 
@@ -132,4 +160,30 @@ extern NSString *const VMPProfilePlatformVAAPI;
 							  variables:(NSDictionary *)variables
 								  error:(NSError **)error;
 
+/**
+	@brief Process a pipeline template for a shared encoder
+
+	@param type The key in the sharedEncoders dictionary
+	@param variables A dictionary of variables to replace in the template
+	@param error Error pointer
+
+	@return A GStreamer pipeline description
+*/
+- (NSString *)pipelineForSharedEncoderType:(NSString *)type
+								 variables:(NSDictionary *)variables
+									 error:(NSError **)error;
+
+/**
+	@brief Process a pipeline template for a shared audio capture
+
+	@param type The key in the sharedAudio dictionary
+	@param variables A dictionary of variables to replace in the template
+	@param error Error pointer
+
+	@return A GStreamer pipeline description
+*/
+- (NSString *)pipelineForSharedAudioType:(NSString *)type
+							   variables:(NSDictionary *)variables
+								   error:(NSError **)error;
+
 @end
@@ -31,6 +31,10 @@ NSString *const VMPProfilePlatformVAAPI = @"vaapi";
 		SET_PROPERTY(_audioProviders, @"audioProviders");
 		SET_PROPERTY(_channels, @"channels");
 		SET_PROPERTY(_recordings, @"recordings");
+
+		// Optional properties
+		_sharedEncoders = propertyList[@"sharedEncoders"];
+		_sharedAudio = propertyList[@"sharedAudio"];
 	}
 
 	return self;
@@ -47,7 +51,7 @@ NSString *const VMPProfilePlatformVAAPI = @"vaapi";
 	VMP_ASSERT(_channels, @"channels is nil");
 	VMP_ASSERT(_recordings, @"recordings is nil");
 
-	return @{
+	NSMutableDictionary *plist = [NSMutableDictionary dictionaryWithDictionary:@{
 		@"name" : _name,
 		@"identifier" : _identifier,
 		@"version" : _version,
@@ -57,7 +61,15 @@ NSString *const VMPProfilePlatformVAAPI = @"vaapi";
 		@"audioProviders" : _audioProviders,
 		@"channels" : _channels,
 		@"recordings" : _recordings
-	};
+	}];
+	if (_sharedEncoders) {
+		plist[@"sharedEncoders"] = _sharedEncoders;
+	}
+	if (_sharedAudio) {
+		plist[@"sharedAudio"] = _sharedAudio;
+	}
+
+	return plist;
 }
 
 - (NSInteger)compatiblityScoreForPlatform:(NSString *)platform {
@@ -120,6 +132,24 @@ NSString *const VMPProfilePlatformVAAPI = @"vaapi";
 							error:error];
 }
 
+- (NSString *)pipelineForSharedEncoderType:(NSString *)type
+								 variables:(NSDictionary *)variables
+									 error:(NSError **)error {
+	return [self _pipelineForType:type
+			   templateDictionary:_sharedEncoders
+						variables:variables
+							error:error];
+}
+
+- (NSString *)pipelineForSharedAudioType:(NSString *)type
+							   variables:(NSDictionary *)variables
+								   error:(NSError **)error {
+	return [self _pipelineForType:type
+			   templateDictionary:_sharedAudio
+						variables:variables
+							error:error];
+}
+
 - (NSString *)pipelineForMountpointType:(NSString *)type
 							  variables:(NSDictionary *)variables
 								  error:(NSError **)error {
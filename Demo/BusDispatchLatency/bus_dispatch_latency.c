@@ -0,0 +1,175 @@
+/* bus_dispatch_latency - Measure GStreamer bus message dispatch latency
+ * Copyright (C) 2024 Hugo Melder
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib.h>
+#include <gst/gst.h>
+
+#define DEFAULT_MESSAGES 200
+#define DEFAULT_INTERVAL_MS 25
+#define POLL_INTERVAL_US G_USEC_PER_SEC
+
+/* Compares the bus-message-to-callback latency of two ways to dispatch the GLib
+ * default main context:
+ *
+ *  poll:   Iterate the context once per second without blocking. This is what
+ *          vmpserverd did with an NSTimer firing g_main_context_iteration(NULL, FALSE).
+ *  thread: Run a GMainLoop on a dedicated thread, which wakes up as soon as a
+ *          message is queued on the bus.
+ */
+
+struct Benchmark
+{
+    GstBus *bus;
+    guint total;
+    guint received;
+    guint intervalMs;
+    gint64 *latencies;
+    gboolean done;
+};
+
+static gint compare_latency(gconstpointer a, gconstpointer b)
+{
+    gint64 x = *(const gint64 *)a;
+    gint64 y = *(const gint64 *)b;
+
+    return (x > y) - (x < y);
+}
+
+static gboolean bus_callback(GstBus *bus, GstMessage *message, gpointer userdata)
+{
+    struct Benchmark *bench = (struct Benchmark *)userdata;
+    const GstStructure *s;
+    gint64 postedAt;
+
+    if (GST_MESSAGE_TYPE(message) != GST_MESSAGE_APPLICATION)
+        return TRUE;
+
+    s = gst_message_get_structure(message);
+    if (!gst_structure_get_int64(s, "posted-at", &postedAt))
+        return TRUE;
+
+    bench->latencies[bench->received++] = g_get_monotonic_time() - postedAt;
+    if (bench->received == bench->total)
+        g_atomic_int_set(&bench->done, TRUE);
+
+    return TRUE;
+}
+
+// Posts messages from a separate thread, like a GStreamer streaming thread would
+static gpointer producer_thread(gpointer userdata)
+{
+    struct Benchmark *bench = (struct Benchmark *)userdata;
+    guint i;
+
+    for (i = 0; i < bench->total; i++)
+    {
+        GstStructure *s;
+
+        s = gst_structure_new("vmp-benchmark", "posted-at", G_TYPE_INT64, g_get_monotonic_time(),
+                              NULL);
+        gst_bus_post(bench->bus, gst_message_new_application(NULL, s));
+        g_usleep(bench->intervalMs * 1000);
+    }
+
+    return NULL;
+}
+
+static gpointer dispatch_thread(gpointer userdata)
+{
+    g_main_loop_run((GMainLoop *)userdata);
+    return NULL;
+}
+
+static void print_results(const gchar *mode, struct Benchmark *bench)
+{
+    gint64 sum = 0;
+    guint i;
+
+    qsort(bench->latencies, bench->received, sizeof(gint64), compare_latency);
+    for (i = 0; i < bench->received; i++)
+        sum += bench->latencies[i];
+
+    g_print("%-6s messages=%u avg=%" G_GINT64_FORMAT "us p50=%" G_GINT64_FORMAT
+            "us p99=%" G_GINT64_FORMAT "us max=%" G_GINT64_FORMAT "us\n",
+            mode, bench->received, sum / bench->received, bench->latencies[bench->received / 2],
+            bench->latencies[(bench->received * 99) / 100], bench->latencies[bench->received - 1]);
+}
+
+static void run_benchmark(const gchar *mode, guint total, guint intervalMs)
+{
+    struct Benchmark bench = {0};
+    GThread *producer;
+    guint watch;
+
+    bench.bus = gst_bus_new();
+    bench.total = total;
+    bench.intervalMs = intervalMs;
+    bench.latencies = g_new0(gint64, total);
+
+    watch = gst_bus_add_watch(bench.bus, bus_callback, &bench);
+    producer = g_thread_new("producer", producer_thread, &bench);
+
+    if (g_strcmp0(mode, "poll") == 0)
+    {
+        while (!g_atomic_int_get(&bench.done))
+        {
+            g_usleep(POLL_INTERVAL_US);
+            /* A single non-blocking iteration per tick, like the timer did. The bus
+             * watch dispatches one message per iteration, so bursts queue up.
+             */
+            g_main_context_iteration(NULL, FALSE);
+        }
+    }
+    else
+    {
+        GMainLoop *loop;
+        GThread *dispatcher;
+
+        loop = g_main_loop_new(NULL, FALSE);
+        dispatcher = g_thread_new("dispatch", dispatch_thread, loop);
+
+        while (!g_atomic_int_get(&bench.done))
+            g_usleep(10 * 1000);
+
+        g_main_loop_quit(loop);
+        g_thread_join(dispatcher);
+        g_main_loop_unref(loop);
+    }
+
+    g_thread_join(producer);
+    print_results(mode, &bench);
+
+    g_source_remove(watch);
+    gst_object_unref(bench.bus);
+    g_free(bench.latencies);
+}
+
+int main(int argc, char *argv[])
+{
+    guint total = DEFAULT_MESSAGES;
+    guint intervalMs = DEFAULT_INTERVAL_MS;
+
+    gst_init(&argc, &argv);
+
+    if (argc > 1)
+        total = (guint)atoi(argv[1]);
+    if (argc > 2)
+        intervalMs = (guint)atoi(argv[2]);
+    if (total == 0)
+    {
+        g_printerr("Usage: %s [MESSAGES] [INTERVAL_MS]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    g_print("Posting %u messages every %u ms\n", total, intervalMs);
+    run_benchmark("poll", total, intervalMs);
+    run_benchmark("thread", total, intervalMs);
+
+    return EXIT_SUCCESS;
+}
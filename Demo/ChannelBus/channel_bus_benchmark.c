@@ -0,0 +1,304 @@
+/* channel_bus_benchmark - Compare intervideo with an appsink/appsrc channel bus
+ * Copyright (C) 2024 Hugo Melder
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+
+#include <glib.h>
+#include <gst/app/app.h>
+#include <gst/gst.h>
+
+#define DEFAULT_CONSUMERS 3
+#define DEFAULT_SECONDS 10
+#define QUEUE_SIZE 4
+#define RECENT_MEMORIES 64
+
+#define CAPS "video/x-raw,format=NV12,width=1920,height=1080,framerate=30/1"
+// NV12 is 12 bits per pixel
+#define FRAME_SIZE (1920 * 1080 * 3 / 2)
+
+/* Moves a 1080p NV12 stream from one producer pipeline to several consumer pipelines:
+ *
+ *  intervideo: intervideosink, and one intervideosrc per consumer. This is how
+ *              vmpserverd connects channels and mountpoints by default.
+ *  native:     appsink, and one appsrc per consumer. Buffers are pushed to every
+ *              consumer with only the metadata copied, like the VMPStreamPublisher in
+ *              vmpserverd does.
+ *
+ * The producer attaches the monotonic time to every buffer as a reference timestamp
+ * meta. Each consumer computes the latency when the buffer reaches its sink, and checks
+ * whether the buffer still references the memory allocated by the producer.
+ */
+
+struct Consumer
+{
+    GstElement *pipeline;
+    GstElement *appsrc;
+    guint64 frames;
+    guint64 copies;
+    guint64 dropped;
+    gint64 latencySum;
+    gint64 latencyMax;
+    guint64 latencySamples;
+};
+
+struct Benchmark
+{
+    GstElement *producer;
+    struct Consumer *consumers;
+    guint numConsumers;
+    GstCaps *metaCaps;
+    GMutex lock;
+    // Memory blocks recently allocated by the producer
+    GstMemory *recent[RECENT_MEMORIES];
+    guint recentIndex;
+};
+
+static gboolean is_producer_memory(struct Benchmark *bench, GstMemory *memory)
+{
+    gboolean found = FALSE;
+    guint i;
+
+    g_mutex_lock(&bench->lock);
+    for (i = 0; i < RECENT_MEMORIES && !found; i++)
+        found = bench->recent[i] == memory;
+    g_mutex_unlock(&bench->lock);
+
+    return found;
+}
+
+static GstPadProbeReturn producer_probe(GstPad *pad, GstPadProbeInfo *info, gpointer userdata)
+{
+    struct Benchmark *bench = (struct Benchmark *)userdata;
+    GstBuffer *buffer;
+
+    buffer = gst_pad_probe_info_get_buffer(info);
+    buffer = gst_buffer_make_writable(buffer);
+    gst_buffer_add_reference_timestamp_meta(buffer, bench->metaCaps,
+                                            g_get_monotonic_time() * GST_USECOND,
+                                            GST_CLOCK_TIME_NONE);
+    GST_PAD_PROBE_INFO_DATA(info) = buffer;
+
+    // Pointers are only compared, never dereferenced
+    g_mutex_lock(&bench->lock);
+    bench->recent[bench->recentIndex] = gst_buffer_peek_memory(buffer, 0);
+    bench->recentIndex = (bench->recentIndex + 1) % RECENT_MEMORIES;
+    g_mutex_unlock(&bench->lock);
+
+    return GST_PAD_PROBE_OK;
+}
+
+struct ConsumerProbe
+{
+    struct Benchmark *bench;
+    struct Consumer *consumer;
+};
+
+static GstPadProbeReturn consumer_probe(GstPad *pad, GstPadProbeInfo *info, gpointer userdata)
+{
+    struct ConsumerProbe *probe = (struct ConsumerProbe *)userdata;
+    struct Consumer *consumer = probe->consumer;
+    GstReferenceTimestampMeta *meta;
+    GstBuffer *buffer;
+
+    buffer = gst_pad_probe_info_get_buffer(info);
+    consumer->frames++;
+
+    if (!is_producer_memory(probe->bench, gst_buffer_peek_memory(buffer, 0)))
+        consumer->copies++;
+
+    meta = gst_buffer_get_reference_timestamp_meta(buffer, probe->bench->metaCaps);
+    if (meta != NULL)
+    {
+        gint64 latency = g_get_monotonic_time() - (gint64)(meta->timestamp / GST_USECOND);
+
+        consumer->latencySum += latency;
+        consumer->latencyMax = MAX(consumer->latencyMax, latency);
+        consumer->latencySamples++;
+    }
+
+    return GST_PAD_PROBE_OK;
+}
+
+// Fan-out from the appsink to all appsrc elements
+static GstFlowReturn new_sample(GstAppSink *appsink, gpointer userdata)
+{
+    struct Benchmark *bench = (struct Benchmark *)userdata;
+    GstSample *sample;
+    GstBuffer *buffer;
+    guint i;
+
+    sample = gst_app_sink_pull_sample(appsink);
+    if (sample == NULL)
+        return GST_FLOW_EOS;
+
+    buffer = gst_sample_get_buffer(sample);
+    for (i = 0; i < bench->numConsumers; i++)
+    {
+        struct Consumer *consumer = &bench->consumers[i];
+        GstAppSrc *src = GST_APP_SRC(consumer->appsrc);
+
+        if (gst_app_src_get_current_level_buffers(src) >= QUEUE_SIZE)
+        {
+            consumer->dropped++;
+            continue;
+        }
+
+        gst_app_src_set_caps(src, gst_sample_get_caps(sample));
+        // Only metadata is copied. Timestamps are replaced by do-timestamp.
+        gst_app_src_push_buffer(src, gst_buffer_copy(buffer));
+    }
+    gst_sample_unref(sample);
+
+    return GST_FLOW_OK;
+}
+
+static gdouble cpu_seconds(void)
+{
+    struct rusage usage;
+
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+           (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+static void add_probe(GstElement *pipeline, const gchar *element, GstPadProbeCallback callback,
+                      gpointer userdata, GDestroyNotify destroy)
+{
+    GstElement *e;
+    GstPad *pad;
+
+    e = gst_bin_get_by_name(GST_BIN(pipeline), element);
+    pad = gst_element_get_static_pad(e, "sink");
+    gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER, callback, userdata, destroy);
+    gst_object_unref(pad);
+    gst_object_unref(e);
+}
+
+static void run_benchmark(const gchar *mode, guint numConsumers, guint seconds)
+{
+    struct Benchmark bench = {0};
+    gboolean native = g_strcmp0(mode, "native") == 0;
+    gchar *desc;
+    gdouble cpuBefore, cpuAfter;
+    guint64 frames = 0, copies = 0, dropped = 0, samples = 0;
+    gint64 latencySum = 0, latencyMax = 0;
+    guint i;
+
+    g_mutex_init(&bench.lock);
+    bench.metaCaps = gst_caps_new_empty_simple("timestamp/x-vmp-benchmark");
+    bench.numConsumers = numConsumers;
+    bench.consumers = g_new0(struct Consumer, numConsumers);
+
+    desc = g_strdup_printf("videotestsrc is-live=1 ! " CAPS " ! identity name=stamp ! %s",
+                           native ? "appsink name=sink sync=false"
+                                  : "intervideosink channel=bench");
+    bench.producer = gst_parse_launch(desc, NULL);
+    g_free(desc);
+
+    add_probe(bench.producer, "stamp", producer_probe, &bench, NULL);
+
+    for (i = 0; i < numConsumers; i++)
+    {
+        struct Consumer *consumer = &bench.consumers[i];
+        struct ConsumerProbe *probe;
+
+        desc = g_strdup_printf("%s ! fakesink name=sink sync=false",
+                               native ? "appsrc name=src is-live=true format=time do-timestamp=true"
+                                      : "intervideosrc channel=bench");
+        consumer->pipeline = gst_parse_launch(desc, NULL);
+        g_free(desc);
+
+        if (native)
+            consumer->appsrc = gst_bin_get_by_name(GST_BIN(consumer->pipeline), "src");
+
+        probe = g_new0(struct ConsumerProbe, 1);
+        probe->bench = &bench;
+        probe->consumer = consumer;
+        add_probe(consumer->pipeline, "sink", consumer_probe, probe, g_free);
+    }
+
+    if (native)
+    {
+        GstAppSinkCallbacks callbacks = {NULL};
+        GstElement *sink;
+
+        callbacks.new_sample = new_sample;
+        sink = gst_bin_get_by_name(GST_BIN(bench.producer), "sink");
+        gst_app_sink_set_callbacks(GST_APP_SINK(sink), &callbacks, &bench, NULL);
+        gst_object_unref(sink);
+    }
+
+    cpuBefore = cpu_seconds();
+
+    for (i = 0; i < numConsumers; i++)
+        gst_element_set_state(bench.consumers[i].pipeline, GST_STATE_PLAYING);
+    gst_element_set_state(bench.producer, GST_STATE_PLAYING);
+
+    g_usleep(seconds * G_USEC_PER_SEC);
+
+    gst_element_set_state(bench.producer, GST_STATE_NULL);
+    for (i = 0; i < numConsumers; i++)
+        gst_element_set_state(bench.consumers[i].pipeline, GST_STATE_NULL);
+
+    cpuAfter = cpu_seconds();
+
+    for (i = 0; i < numConsumers; i++)
+    {
+        struct Consumer *consumer = &bench.consumers[i];
+
+        frames += consumer->frames;
+        copies += consumer->copies;
+        dropped += consumer->dropped;
+        samples += consumer->latencySamples;
+        latencySum += consumer->latencySum;
+        latencyMax = MAX(latencyMax, consumer->latencyMax);
+
+        if (consumer->appsrc != NULL)
+            gst_object_unref(consumer->appsrc);
+        gst_object_unref(consumer->pipeline);
+    }
+
+    g_print("%-10s frames=%" G_GUINT64_FORMAT " dropped=%" G_GUINT64_FORMAT
+            " copied=%.1fMB/s cpu=%.1f%%",
+            mode, frames, dropped, (gdouble)copies * FRAME_SIZE / (1024 * 1024) / seconds,
+            (cpuAfter - cpuBefore) * 100.0 / seconds);
+    if (samples > 0)
+        g_print(" latency avg=%" G_GINT64_FORMAT "us max=%" G_GINT64_FORMAT "us\n",
+                latencySum / (gint64)samples, latencyMax);
+    else
+        g_print(" latency n/a (meta not preserved)\n");
+
+    gst_object_unref(bench.producer);
+    gst_caps_unref(bench.metaCaps);
+    g_free(bench.consumers);
+    g_mutex_clear(&bench.lock);
+}
+
+int main(int argc, char *argv[])
+{
+    guint consumers = DEFAULT_CONSUMERS;
+    guint seconds = DEFAULT_SECONDS;
+
+    gst_init(&argc, &argv);
+
+    if (argc > 1)
+        consumers = (guint)atoi(argv[1]);
+    if (argc > 2)
+        seconds = (guint)atoi(argv[2]);
+    if (consumers == 0 || seconds == 0)
+    {
+        g_printerr("Usage: %s [CONSUMERS] [SECONDS]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    g_print("Moving 1080p30 NV12 to %u consumers for %u seconds\n", consumers, seconds);
+    run_benchmark("intervideo", consumers, seconds);
+    run_benchmark("native", consumers, seconds);
+
+    return EXIT_SUCCESS;
+}
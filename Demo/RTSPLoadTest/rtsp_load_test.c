@@ -0,0 +1,254 @@
+/* rtsp_load_test - Open concurrent RTSP clients against a mountpoint
+ * Copyright (C) 2024 Hugo Melder
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <glib.h>
+#include <gst/gst.h>
+
+#define DEFAULT_SECONDS 30
+
+/* Opens CLIENTS rtspsrc pipelines at once, and receives all streams of the mountpoint
+ * without decoding. For each client, the setup latency is the time between setting the
+ * pipeline to PLAYING, and the first buffer leaving rtspsrc. Clients posting an error
+ * before receiving a buffer (e.g. 503 Service Unavailable when a client limit of
+ * vmpserverd is reached) count as failed.
+ *
+ * If the pid of the server is given, the CPU time of the server is read from
+ * /proc/<pid>/stat before, and after the test.
+ */
+
+struct Client
+{
+    struct LoadTest *test;
+    GstElement *pipeline;
+    gint64 started;
+    gint64 setupLatency;
+    guint64 buffers;
+    gboolean failed;
+};
+
+struct LoadTest
+{
+    struct Client *clients;
+    guint numClients;
+    GMainLoop *loop;
+    GMutex lock;
+};
+
+static gdouble cpu_seconds(void)
+{
+    struct rusage usage;
+
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+           (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+// User, and system time of another process. Returns a negative value on failure.
+static gdouble process_cpu_seconds(gint pid)
+{
+    unsigned long utime, stime;
+    gchar *path, *contents, *fields;
+    gdouble seconds = -1;
+
+    path = g_strdup_printf("/proc/%d/stat", pid);
+    if (g_file_get_contents(path, &contents, NULL, NULL))
+    {
+        // The command name may contain spaces. Fields after it start with the state.
+        fields = strrchr(contents, ')');
+        if (fields != NULL &&
+            sscanf(fields + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu", &utime,
+                   &stime) == 2)
+            seconds = (gdouble)(utime + stime) / sysconf(_SC_CLK_TCK);
+        g_free(contents);
+    }
+    g_free(path);
+
+    return seconds;
+}
+
+static GstPadProbeReturn buffer_probe(GstPad *pad, GstPadProbeInfo *info, gpointer userdata)
+{
+    struct Client *client = (struct Client *)userdata;
+
+    g_mutex_lock(&client->test->lock);
+    if (client->buffers++ == 0)
+        client->setupLatency = g_get_monotonic_time() - client->started;
+    g_mutex_unlock(&client->test->lock);
+
+    return GST_PAD_PROBE_OK;
+}
+
+// Every stream of the mountpoint gets its own fakesink
+static void pad_added(GstElement *src, GstPad *pad, gpointer userdata)
+{
+    struct Client *client = (struct Client *)userdata;
+    GstElement *sink;
+    GstPad *sinkpad;
+
+    sink = gst_element_factory_make("fakesink", NULL);
+    g_object_set(sink, "sync", FALSE, NULL);
+    gst_bin_add(GST_BIN(client->pipeline), sink);
+    gst_element_sync_state_with_parent(sink);
+
+    sinkpad = gst_element_get_static_pad(sink, "sink");
+    gst_pad_link(pad, sinkpad);
+    gst_object_unref(sinkpad);
+
+    gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER, buffer_probe, client, NULL);
+}
+
+static gboolean bus_watch(GstBus *bus, GstMessage *message, gpointer userdata)
+{
+    struct Client *client = (struct Client *)userdata;
+    GError *err;
+
+    if (GST_MESSAGE_TYPE(message) == GST_MESSAGE_ERROR)
+    {
+        gst_message_parse_error(message, &err, NULL);
+        g_printerr("client %ld: %s\n", (long)(client - client->test->clients), err->message);
+        g_error_free(err);
+
+        g_mutex_lock(&client->test->lock);
+        client->failed = client->buffers == 0;
+        g_mutex_unlock(&client->test->lock);
+    }
+
+    return G_SOURCE_CONTINUE;
+}
+
+static gboolean stop_test(gpointer userdata)
+{
+    g_main_loop_quit((GMainLoop *)userdata);
+    return G_SOURCE_REMOVE;
+}
+
+static int compare_latency(const void *a, const void *b)
+{
+    gint64 x = *(const gint64 *)a, y = *(const gint64 *)b;
+
+    return (x > y) - (x < y);
+}
+
+int main(int argc, char *argv[])
+{
+    struct LoadTest test = {0};
+    guint seconds = DEFAULT_SECONDS, connected = 0, failed = 0, i;
+    gint serverPid = 0;
+    gdouble cpuBefore, cpuAfter, serverBefore = -1, serverAfter = -1;
+    gint64 *latencies;
+    guint64 buffers = 0;
+
+    gst_init(&argc, &argv);
+
+    if (argc > 2)
+        test.numClients = (guint)atoi(argv[2]);
+    if (argc > 3)
+        seconds = (guint)atoi(argv[3]);
+    if (argc > 4)
+        serverPid = atoi(argv[4]);
+    if (test.numClients == 0 || seconds == 0)
+    {
+        g_printerr("Usage: %s URL CLIENTS [SECONDS] [SERVER_PID]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    g_mutex_init(&test.lock);
+    test.loop = g_main_loop_new(NULL, FALSE);
+    test.clients = g_new0(struct Client, test.numClients);
+
+    for (i = 0; i < test.numClients; i++)
+    {
+        struct Client *client = &test.clients[i];
+        GstElement *src;
+        GstBus *bus;
+
+        client->test = &test;
+        client->pipeline = gst_pipeline_new(NULL);
+        src = gst_element_factory_make("rtspsrc", NULL);
+        g_object_set(src, "location", argv[1], "latency", 0, NULL);
+        g_signal_connect(src, "pad-added", G_CALLBACK(pad_added), client);
+        gst_bin_add(GST_BIN(client->pipeline), src);
+
+        bus = gst_pipeline_get_bus(GST_PIPELINE(client->pipeline));
+        gst_bus_add_watch(bus, bus_watch, client);
+        gst_object_unref(bus);
+    }
+
+    g_print("Opening %u clients to %s for %u seconds\n", test.numClients, argv[1], seconds);
+
+    cpuBefore = cpu_seconds();
+    if (serverPid > 0)
+        serverBefore = process_cpu_seconds(serverPid);
+
+    for (i = 0; i < test.numClients; i++)
+    {
+        test.clients[i].started = g_get_monotonic_time();
+        gst_element_set_state(test.clients[i].pipeline, GST_STATE_PLAYING);
+    }
+
+    g_timeout_add_seconds(seconds, stop_test, test.loop);
+    g_main_loop_run(test.loop);
+
+    cpuAfter = cpu_seconds();
+    if (serverPid > 0)
+        serverAfter = process_cpu_seconds(serverPid);
+
+    for (i = 0; i < test.numClients; i++)
+        gst_element_set_state(test.clients[i].pipeline, GST_STATE_NULL);
+
+    latencies = g_new0(gint64, test.numClients);
+    for (i = 0; i < test.numClients; i++)
+    {
+        struct Client *client = &test.clients[i];
+
+        buffers += client->buffers;
+        if (client->buffers > 0)
+            latencies[connected++] = client->setupLatency;
+        else if (client->failed)
+            failed++;
+
+        gst_object_unref(client->pipeline);
+    }
+
+    g_print("clients=%u connected=%u failed=%u buffers=%" G_GUINT64_FORMAT "\n",
+            test.numClients, connected, failed, buffers);
+
+    if (connected > 0)
+    {
+        qsort(latencies, connected, sizeof(gint64), compare_latency);
+        g_print("setup latency min=%" G_GINT64_FORMAT "ms median=%" G_GINT64_FORMAT
+                "ms max=%" G_GINT64_FORMAT "ms\n",
+                latencies[0] / 1000, latencies[connected / 2] / 1000,
+                latencies[connected - 1] / 1000);
+    }
+
+    g_print("client cpu=%.1f%% (%.2f%% per client)\n", (cpuAfter - cpuBefore) * 100.0 / seconds,
+            (cpuAfter - cpuBefore) * 100.0 / seconds / test.numClients);
+    if (serverBefore >= 0 && serverAfter >= 0)
+    {
+        gdouble serverCpu = (serverAfter - serverBefore) * 100.0 / seconds;
+
+        g_print("server cpu=%.1f%%", serverCpu);
+        if (connected > 0)
+            g_print(" (%.2f%% per connected client)", serverCpu / connected);
+        g_print("\n");
+    }
+    else if (serverPid > 0)
+        g_printerr("Could not read the CPU time of process %d\n", serverPid);
+
+    g_free(latencies);
+    g_free(test.clients);
+    g_main_loop_unref(test.loop);
+    g_mutex_clear(&test.lock);
+
+    return connected > 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
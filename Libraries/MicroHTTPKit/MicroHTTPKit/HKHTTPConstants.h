@@ -14,4 +14,6 @@ extern NSString *const HKHTTPMethodPUT;
 
 extern NSString *const HKHTTPHeaderContentType;
 extern NSString *const HKHTTPHeaderAuthorization;
+extern NSString *const HKHTTPHeaderRange;
+extern NSString *const HKHTTPHeaderIfRange;
 extern NSString *const HKHTTPHeaderContentApplicationJSON;
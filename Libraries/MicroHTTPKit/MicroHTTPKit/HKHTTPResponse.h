@@ -6,6 +6,8 @@
 
 #import <Foundation/Foundation.h>
 
+#import <MicroHTTPKit/HKHTTPRequest.h>
+
 NS_ASSUME_NONNULL_BEGIN
 
 @interface HKHTTPResponse : NSObject
@@ -14,6 +16,20 @@ NS_ASSUME_NONNULL_BEGIN
 @property (assign) NSUInteger status;
 @property (strong) NSDictionary<NSString *, NSString *> *headers;
 
+/**
+ * @brief Whether the response is reused for multiple requests without changes
+ *
+ * The body of a response is passed to libmicrohttpd without copying it, and
+ * the data object is kept alive until the request completed. An immutable
+ * response is additionally turned into a libmicrohttpd response only once,
+ * which is then queued for every request returning this object.
+ *
+ * Set this for precomputed responses that a handler returns repeatedly. The
+ * data, headers, and status must not be changed after the response was
+ * returned from a handler for the first time. Defaults to NO.
+ */
+@property (assign, getter=isImmutable) BOOL immutable;
+
 + (instancetype)responseWithStatus:(NSUInteger)status;
 + (instancetype)responseWithData:(NSData *)data status:(NSUInteger)status;
 
@@ -42,4 +58,182 @@ NS_ASSUME_NONNULL_BEGIN
 
 @end
 
+/**
+ * @brief Value of contentLength if the length of the body is not known in advance
+ */
+extern const uint64_t HKHTTPStreamingResponseUnknownLength;
+
+/**
+ * @brief Returned by a HKStreamProducerBlock at the end of the body
+ */
+extern const NSInteger HKHTTPStreamingResponseEndOfStream;
+
+/**
+ * @brief Returned by a HKStreamProducerBlock if the body cannot be completed
+ *
+ * The connection is closed without sending the rest of the body.
+ */
+extern const NSInteger HKHTTPStreamingResponseError;
+
+/**
+ * @brief Produces the next part of a streamed body
+ *
+ * Writes at most length bytes into buffer, and returns the number of bytes
+ * written, HKHTTPStreamingResponseEndOfStream, or HKHTTPStreamingResponseError.
+ * offset is the position of buffer in the body.
+ *
+ * The producer is called on a thread of the server, and must not block, e.g.
+ * while waiting for data that is not available yet. In the default threading
+ * mode, a blocked producer stalls all other connections. Returning 0 is
+ * treated like HKHTTPStreamingResponseError, as the server would otherwise
+ * poll the producer in a busy loop. Produce data that is available
+ * immediately, like the contents of a local file, or a generated body.
+ */
+typedef NSInteger (^HKStreamProducerBlock)(uint8_t *buffer, NSUInteger length, uint64_t offset);
+
+/**
+ * @brief A response with a body that is produced while it is sent
+ *
+ * The body is never materialized in memory. The producer is only called on the
+ * server thread when the socket of the client can take more data, so a slow
+ * client throttles the producer, and at most blockSize bytes are buffered per
+ * request.
+ *
+ * If contentLength is HKHTTPStreamingResponseUnknownLength, the body is sent with
+ * chunked transfer encoding to HTTP/1.1 clients. HTTP/1.0 clients receive the body
+ * until the connection is closed.
+ *
+ * A streaming response can only be sent once, and is never reused, even when
+ * marked as immutable.
+ *
+ * @code
+ * __block NSUInteger remaining = 10;
+ * response = [HKHTTPStreamingResponse
+ *     responseWithProducer:^NSInteger(uint8_t *buffer, NSUInteger length, uint64_t offset) {
+ *         if (remaining == 0) {
+ *             return HKHTTPStreamingResponseEndOfStream;
+ *         }
+ *         remaining--;
+ *         return snprintf((char *) buffer, length, "event %lu\n", remaining);
+ *     }
+ *                   status:200];
+ * @endcode
+ */
+@interface HKHTTPStreamingResponse : HKHTTPResponse
+
+@property (readonly) HKStreamProducerBlock producer;
+
+/**
+ * @brief Length of the body in bytes
+ *
+ * Defaults to HKHTTPStreamingResponseUnknownLength.
+ */
+@property (assign) uint64_t contentLength;
+
+/**
+ * @brief Maximum number of bytes requested from the producer at once
+ *
+ * Defaults to 32 KiB.
+ */
+@property (assign) NSUInteger blockSize;
+
+/**
+ * @brief Called once the response is no longer used
+ *
+ * Invoked on the server thread after the body was sent completely, or the client
+ * disconnected. Use it to release resources held by the producer.
+ */
+@property (copy, nullable) void (^terminationHandler)(void);
+
++ (instancetype)responseWithProducer:(HKStreamProducerBlock)producer status:(NSUInteger)status;
+
+/**
+ * @brief Stream the contents of an input stream
+ *
+ * The stream is opened on the first read, read with blocking reads, and
+ * closed when the response terminates.
+ */
++ (instancetype)responseWithInputStream:(NSInputStream *)stream status:(NSUInteger)status;
+
+- (instancetype)initWithProducer:(HKStreamProducerBlock)producer
+						 headers:(NSDictionary<NSString *, NSString *> *)headers
+						  status:(NSUInteger)status;
+
+- (instancetype)initWithInputStream:(NSInputStream *)stream
+							headers:(NSDictionary<NSString *, NSString *> *)headers
+							 status:(NSUInteger)status;
+
+@end
+
+/**
+ * @brief A response with the contents of a file as its body
+ *
+ * The file is opened when the response is created, and handed to libmicrohttpd,
+ * which sends it with sendfile(2) where available. The contents are never read
+ * into user space, so files of any size can be served with constant memory.
+ *
+ * A single byte range of the "Range" header of the request is honoured with a
+ * 206 (Partial Content) response. A range outside of the file results in a 416
+ * (Range Not Satisfiable) response. Multiple ranges are not supported, and the
+ * whole file is sent instead. If the request has an "If-Range" header that does
+ * not match the "ETag", or "Last-Modified" header of the file, the range is
+ * ignored as well.
+ *
+ * The response includes the "Content-Length", "Last-Modified", "ETag", and
+ * "Accept-Ranges" headers. The "Content-Type" defaults to
+ * "application/octet-stream" unless set in the additional headers.
+ *
+ * A file response can only be sent once, and is never reused, even when marked
+ * as immutable.
+ *
+ * @code
+ * return [HKHTTPFileResponse responseWithPath:@"/srv/recording.mkv"
+ *                                     request:request
+ *                                     headers:@{@"Content-Type" : @"video/x-matroska"}
+ *                                       error:&error];
+ * @endcode
+ */
+@interface HKHTTPFileResponse : HKHTTPResponse
+
+@property (readonly) NSString *path;
+
+/**
+ * @brief Size of the file when it was opened
+ */
+@property (readonly) uint64_t fileSize;
+
+/**
+ * @brief Position of the first byte of the body in the file
+ */
+@property (readonly) uint64_t offset;
+
+/**
+ * @brief Number of bytes in the body
+ */
+@property (readonly) uint64_t length;
+
++ (nullable instancetype)responseWithPath:(NSString *)path
+								  request:(HKHTTPRequest *)request
+								  headers:(NSDictionary<NSString *, NSString *> *)headers
+									error:(NSError **)error;
+
+/**
+ * @brief Create a response for a regular file
+ *
+ * @param path Path of the file
+ * @param request The request to answer. Its "Range", and "If-Range" headers
+ * determine the status, and the part of the file that is sent.
+ * @param headers Additional headers of the response
+ * @param error NSPOSIXErrorDomain error if the file cannot be opened, or is
+ * not a regular file
+ *
+ * @returns the response, or nil on error
+ */
+- (nullable instancetype)initWithPath:(NSString *)path
+							  request:(HKHTTPRequest *)request
+							  headers:(NSDictionary<NSString *, NSString *> *)headers
+								error:(NSError **)error;
+
+@end
+
 NS_ASSUME_NONNULL_END
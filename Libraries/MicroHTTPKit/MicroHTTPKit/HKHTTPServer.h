@@ -16,15 +16,113 @@ typedef void (^HKConnectionLogger)(HKHTTPRequest *req);
 // The default logger can be overwritten, by changing this global variable.
 extern HKConnectionLogger HKDefaultConnectionLogger;
 
+/**
+ * @brief Threads running the request handlers of a server
+ */
+typedef NS_ENUM(NSInteger, HKHTTPServerThreadingModel) {
+	/// A single thread polls all connections, and runs all handlers one after another
+	HKHTTPServerThreadingModelInternalThread = 0,
+	/// A fixed number of threads share the connections, each polling its own subset
+	HKHTTPServerThreadingModelThreadPool,
+	/// Every connection is handled by its own thread
+	HKHTTPServerThreadingModelThreadPerConnection,
+};
+
+/**
+ * @brief Syscall used to wait for activity on the connections
+ */
+typedef NS_ENUM(NSInteger, HKHTTPServerPollingMode) {
+	/// The best mechanism available on this platform
+	HKHTTPServerPollingModeAuto = 0,
+	HKHTTPServerPollingModePoll,
+	/// Linux only, and not available with HKHTTPServerThreadingModelThreadPerConnection
+	HKHTTPServerPollingModeEpoll,
+};
+
+/**
+ * @brief Configuration of the threads, and connection limits of a HKHTTPServer
+ *
+ * The default configuration runs all handlers on a single thread, and does not
+ * limit connections beyond the defaults of libmicrohttpd.
+ *
+ * With multiple threads, handlers run concurrently, and must be MT-Safe. Routes
+ * must be registered before the server is started.
+ */
+@interface HKHTTPServerConfiguration : NSObject <NSCopying>
+
+/**
+ * @brief Defaults to HKHTTPServerThreadingModelInternalThread
+ */
+@property (nonatomic, assign) HKHTTPServerThreadingModel threadingModel;
+
+/**
+ * @brief Number of threads with HKHTTPServerThreadingModelThreadPool
+ *
+ * Defaults to 4.
+ */
+@property (nonatomic, assign) NSUInteger threadPoolSize;
+
+/**
+ * @brief Defaults to HKHTTPServerPollingModeAuto
+ */
+@property (nonatomic, assign) HKHTTPServerPollingMode pollingMode;
+
+/**
+ * @brief Maximum number of concurrent connections, 0 for the default of libmicrohttpd
+ *
+ * Further connections are closed immediately. Defaults to 0.
+ */
+@property (nonatomic, assign) NSUInteger connectionLimit;
+
+/**
+ * @brief Maximum number of concurrent connections from one IP address, 0 for unlimited
+ *
+ * Defaults to 0.
+ */
+@property (nonatomic, assign) NSUInteger perIPConnectionLimit;
+
+/**
+ * @brief Seconds after which an idle connection is closed, 0 for no timeout
+ *
+ * Defaults to 0.
+ */
+@property (nonatomic, assign) NSUInteger connectionTimeout;
+
++ (instancetype)defaultConfiguration;
+
+@end
+
 @interface HKHTTPServer : NSObject
 
 @property (nonatomic, readonly) NSUInteger port;
 @property (readonly) HKRouter *router;
+@property (readonly, copy) HKHTTPServerConfiguration *configuration;
+
+/**
+ * Number of requests handled by the notFoundHandler of the router
+ */
+@property (readonly) NSUInteger numberOfNotFoundRequests;
 
 + (instancetype)serverWithPort:(NSUInteger)port;
++ (instancetype)serverWithPort:(NSUInteger)port
+				 configuration:(HKHTTPServerConfiguration *)configuration;
 
 - (instancetype)initWithPort:(NSUInteger)port;
 
+/**
+ * @brief Create a server
+ *
+ * The configuration is copied, and applied when the server is started.
+ */
+- (instancetype)initWithPort:(NSUInteger)port
+			   configuration:(HKHTTPServerConfiguration *)configuration;
+
+/**
+ * @brief Start listening on the port
+ *
+ * @param error NSPOSIXErrorDomain error with EINVAL if the configuration is not
+ * supported, or the error of libmicrohttpd
+ */
 - (BOOL)startWithError:(NSError **)error;
 - (void)stop;
 
@@ -14,15 +14,76 @@ NS_ASSUME_NONNULL_BEGIN
 
 typedef HKHTTPResponse *_Nonnull (^HKHandlerBlock)(HKHTTPRequest *request);
 
+/**
+ * Passes the response of an asynchronous handler to the server. Must be called exactly
+ * once, and can be called from any thread.
+ */
+typedef void (^HKResponseHandler)(HKHTTPResponse *response);
+
+/**
+ * A handler that returns before its response is ready, and passes the response to
+ * the completion handler later on, e.g. from a dispatch queue.
+ */
+typedef void (^HKAsyncHandlerBlock)(HKHTTPRequest *request, HKResponseHandler completion);
+
 extern NSString *const HKResponseDataKey;
 extern NSString *const HKResponseStatusKey;
 
+/// Key for the number of handled requests in the route statistics
+extern NSString *const HKRouteStatisticsRequestsKey;
+/// Key for the number of responses by status class ("1xx" to "5xx")
+extern NSString *const HKRouteStatisticsResponsesKey;
+/// Key for the cumulative number of requests per bucket of HKRouteDurationBuckets
+extern NSString *const HKRouteStatisticsDurationBucketsKey;
+/// Key for the total duration of all handled requests in seconds
+extern NSString *const HKRouteStatisticsDurationSumKey;
+
+/// Number of buckets in the request duration histogram of a route
+#define HK_ROUTE_DURATION_BUCKET_COUNT 10
+
+/// Upper bounds of the request duration histogram buckets in seconds
+extern const NSTimeInterval HKRouteDurationBuckets[HK_ROUTE_DURATION_BUCKET_COUNT];
+
 @interface HKRoute : NSObject
 
+/**
+ * The path of the route. A path ending in "/*" is a prefix route, and matches all
+ * paths below the prefix (e.g. "/files/*" matches "/files/a/b.txt"). Routes with an
+ * exact path are matched first.
+ */
 @property (readonly, copy) NSString *path;
+/**
+ * The handler of the route. For a route with an asynchronous handler, this block calls
+ * the asynchronous handler, and blocks until the response is ready.
+ */
 @property (readonly, copy) HKHandlerBlock handler;
+
+/**
+ * The asynchronous handler of the route, or nil for a synchronous route
+ *
+ * The server suspends the connection while the handler runs, so other requests are
+ * handled in the meantime, and resumes it once the completion handler is called.
+ * With HKHTTPServerThreadingModelThreadPerConnection, the thread of the connection
+ * waits for the response instead.
+ */
+@property (readonly, copy, nullable) HKAsyncHandlerBlock asyncHandler;
 @property (readonly, copy) NSString *method;
 
+/**
+ * Request statistics of the route
+ *
+ * The duration of a request is the time spent in the middleware, and the handler,
+ * until the response is queued. Counters are updated atomically when a request
+ * was handled, and this property returns a snapshot.
+ *
+ * @li HKRouteStatisticsRequestsKey - Number of handled requests
+ * @li HKRouteStatisticsResponsesKey - Dictionary with the number of responses by status class
+ * @li HKRouteStatisticsDurationBucketsKey - Array with the number of requests taking at most
+ * the duration of the corresponding HKRouteDurationBuckets element
+ * @li HKRouteStatisticsDurationSumKey - Total duration of all requests in seconds
+ */
+@property (readonly) NSDictionary *statistics;
+
 + (instancetype)routeWithPath:(NSString *)path
 					   method:(NSString *)method
 					  handler:(HKHandlerBlock)handler;
@@ -31,6 +92,27 @@ extern NSString *const HKResponseStatusKey;
 					  method:(NSString *)method
 					 handler:(HKHandlerBlock)handler;
 
++ (instancetype)routeWithPath:(NSString *)path
+					   method:(NSString *)method
+				 asyncHandler:(HKAsyncHandlerBlock)asyncHandler;
+
+/**
+ * @brief Create a route with an asynchronous handler
+ *
+ * @code
+ * route = [HKRoute routeWithPath:@"/slow"
+ *                         method:HKHTTPMethodGET
+ *                   asyncHandler:^(HKHTTPRequest *request, HKResponseHandler completion) {
+ *                       dispatch_async(queue, ^{
+ *                           completion([HKHTTPResponse responseWithStatus:200]);
+ *                       });
+ *                   }];
+ * @endcode
+ */
+- (instancetype)initWithPath:(NSString *)path
+					  method:(NSString *)method
+				asyncHandler:(HKAsyncHandlerBlock)asyncHandler;
+
 @end
 
 @interface HKRouter : NSObject
@@ -49,6 +131,11 @@ extern NSString *const HKResponseStatusKey;
 
 - (nullable HKHandlerBlock)handlerForRequest:(HKHTTPRequest *)request;
 
+/**
+ * The route handling the request, or nil if no route matches
+ */
+- (nullable HKRoute *)routeForRequest:(HKHTTPRequest *)request;
+
 + (instancetype)routerWithRoutes:(NSArray<HKRoute *> *)routes
 				 notFoundHandler:(HKHandlerBlock)notFoundHandler;
 
@@ -14,4 +14,6 @@ NSString *const HKHTTPMethodPUT = @"PUT";
 
 NSString *const HKHTTPHeaderContentType = @"content-type";
 NSString *const HKHTTPHeaderAuthorization = @"authorization";
+NSString *const HKHTTPHeaderRange = @"range";
+NSString *const HKHTTPHeaderIfRange = @"if-range";
 NSString *const HKHTTPHeaderContentApplicationJSON = @"application/json";
@@ -6,6 +6,15 @@
 
 #import <MicroHTTPKit/HKHTTPRequest.h>
 
+@interface HKHTTPRequest ()
+
+/* State of an asynchronous handler while the connection is suspended. Owned by the
+ * server.
+ */
+@property (strong) id asyncContext;
+
+@end
+
 @interface HKHTTPRequest (Private)
 
 - (void)appendBytesToHTTPBody:(const void *)bytes length:(NSUInteger)length;
@@ -6,6 +6,8 @@
 
 #import <MicroHTTPKit/HKHTTPRequest.h>
 
+#import "HKHTTPRequest+Private.h"
+
 const NSString *HKConnectionClientIPKey = @"HKConnectionClientIPKey";
 const NSString *HKConnectionClientIPVerKey = @"HKConnectionClientIPVerKey";
 
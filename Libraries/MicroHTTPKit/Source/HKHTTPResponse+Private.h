@@ -0,0 +1,39 @@
+/* MicroHTTPKit - A small libmicrohttpd wrapper
+ * Copyright (C) 2024 Hugo Melder
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#import <MicroHTTPKit/HKHTTPResponse.h>
+
+struct MHD_Response;
+
+@interface HKHTTPResponse (Private)
+
+/* The libmicrohttpd response created for the first request of an immutable
+ * response, and reused for all following requests. The response object owns
+ * the reference, and destroys the libmicrohttpd response on deallocation.
+ */
+- (struct MHD_Response *)persistentResponse;
+- (void)setPersistentResponse:(struct MHD_Response *)response;
+
+@end
+
+@interface HKHTTPStreamingResponse (Private)
+
+/* Called by the server when libmicrohttpd destroyed the response. Closes the
+ * input stream, and invokes the termination handler.
+ */
+- (void)streamDidTerminate;
+
+@end
+
+@interface HKHTTPFileResponse (Private)
+
+/* Returns the file descriptor of the body, and transfers its ownership to the
+ * caller. Returns -1 if the response has no body, or the descriptor was taken
+ * before.
+ */
+- (int)takeFileDescriptor;
+
+@end
@@ -7,7 +7,19 @@
 #import <MicroHTTPKit/HKHTTPConstants.h>
 #import <MicroHTTPKit/HKHTTPResponse.h>
 
-@implementation HKHTTPResponse
+#import "HKHTTPResponse+Private.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <microhttpd.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+@implementation HKHTTPResponse {
+	struct MHD_Response *_persistentResponse;
+}
 
 + (instancetype)responseWithStatus:(NSUInteger)status {
 	return [[self alloc] initWithStatus:status];
@@ -43,6 +55,24 @@
 	return self;
 }
 
+- (struct MHD_Response *)persistentResponse {
+	return _persistentResponse;
+}
+
+- (void)setPersistentResponse:(struct MHD_Response *)response {
+	if (_persistentResponse) {
+		MHD_destroy_response(_persistentResponse);
+	}
+	_persistentResponse = response;
+}
+
+- (void)dealloc {
+	// libmicrohttpd keeps its own reference while the response is queued
+	if (_persistentResponse) {
+		MHD_destroy_response(_persistentResponse);
+	}
+}
+
 @end
 
 @implementation HKHTTPJSONResponse
@@ -76,3 +106,297 @@
 }
 
 @end
+
+const uint64_t HKHTTPStreamingResponseUnknownLength = UINT64_MAX;
+const NSInteger HKHTTPStreamingResponseEndOfStream = -1;
+const NSInteger HKHTTPStreamingResponseError = -2;
+
+#define HK_STREAMING_DEFAULT_BLOCK_SIZE (32 * 1024)
+
+@implementation HKHTTPStreamingResponse {
+	NSInputStream *_inputStream;
+}
+
++ (instancetype)responseWithProducer:(HKStreamProducerBlock)producer status:(NSUInteger)status {
+	return [[self alloc] initWithProducer:producer headers:@{} status:status];
+}
+
++ (instancetype)responseWithInputStream:(NSInputStream *)stream status:(NSUInteger)status {
+	return [[self alloc] initWithInputStream:stream headers:@{} status:status];
+}
+
+- (instancetype)initWithProducer:(HKStreamProducerBlock)producer
+						 headers:(NSDictionary<NSString *, NSString *> *)headers
+						  status:(NSUInteger)status {
+	self = [super initWithStatus:status];
+	if (self) {
+		[self setHeaders:headers];
+		_producer = [producer copy];
+		_contentLength = HKHTTPStreamingResponseUnknownLength;
+		_blockSize = HK_STREAMING_DEFAULT_BLOCK_SIZE;
+	}
+	return self;
+}
+
+- (instancetype)initWithInputStream:(NSInputStream *)stream
+							headers:(NSDictionary<NSString *, NSString *> *)headers
+							 status:(NSUInteger)status {
+	HKStreamProducerBlock producer;
+
+	// The block only captures the stream, which is closed in streamDidTerminate
+	producer = ^NSInteger(uint8_t *buffer, NSUInteger length,
+						  __attribute__((unused)) uint64_t offset) {
+		NSInteger bytesRead;
+
+		if ([stream streamStatus] == NSStreamStatusNotOpen) {
+			[stream open];
+		}
+
+		bytesRead = [stream read:buffer maxLength:length];
+		if (bytesRead == 0) {
+			return HKHTTPStreamingResponseEndOfStream;
+		} else if (bytesRead < 0) {
+			NSLog(@"Failed to read from input stream: %@", [stream streamError]);
+			return HKHTTPStreamingResponseError;
+		}
+		return bytesRead;
+	};
+
+	self = [self initWithProducer:producer headers:headers status:status];
+	if (self) {
+		_inputStream = stream;
+	}
+	return self;
+}
+
+- (BOOL)isImmutable {
+	return NO;
+}
+
+- (void)streamDidTerminate {
+	void (^handler)(void);
+
+	[_inputStream close];
+
+	handler = [self terminationHandler];
+	if (handler) {
+		handler();
+	}
+}
+
+@end
+
+// Result of parsing the "Range" header of a request
+typedef NS_ENUM(NSInteger, HKByteRangeResult) {
+	// No range, an invalid range, or multiple ranges. The whole file is sent.
+	HKByteRangeNone,
+	HKByteRangeSatisfiable,
+	HKByteRangeUnsatisfiable,
+};
+
+// Parse a non-empty string of decimal digits
+static BOOL parseByteOffset(NSString *string, uint64_t *value) {
+	const char *digits;
+	char *end;
+
+	digits = [string UTF8String];
+	if (*digits < '0' || *digits > '9') {
+		return NO;
+	}
+
+	errno = 0;
+	*value = strtoull(digits, &end, 10);
+	return errno == 0 && *end == '\0';
+}
+
+/* Parse a single byte range as described in RFC 9110, Section 14.1.2:
+ * "bytes=first-last", "bytes=first-", or "bytes=-suffixLength".
+ */
+static HKByteRangeResult parseByteRange(NSString *header, uint64_t size, uint64_t *offset,
+										uint64_t *length) {
+	NSString *spec;
+	NSArray<NSString *> *parts;
+	NSString *first, *last;
+	uint64_t firstByte, lastByte;
+
+	if (![header hasPrefix:@"bytes="]) {
+		return HKByteRangeNone;
+	}
+	spec = [[header substringFromIndex:[@"bytes=" length]]
+		stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceCharacterSet]];
+	if ([spec containsString:@","]) {
+		return HKByteRangeNone;
+	}
+
+	parts = [spec componentsSeparatedByString:@"-"];
+	if ([parts count] != 2) {
+		return HKByteRangeNone;
+	}
+	first = parts[0];
+	last = parts[1];
+
+	if ([first length] == 0) {
+		// The last suffixLength bytes of the file
+		if (!parseByteOffset(last, &lastByte)) {
+			return HKByteRangeNone;
+		}
+		if (lastByte == 0 || size == 0) {
+			return HKByteRangeUnsatisfiable;
+		}
+		*offset = size > lastByte ? size - lastByte : 0;
+		*length = size - *offset;
+		return HKByteRangeSatisfiable;
+	}
+
+	if (!parseByteOffset(first, &firstByte)) {
+		return HKByteRangeNone;
+	}
+	if ([last length] == 0) {
+		lastByte = UINT64_MAX;
+	} else if (!parseByteOffset(last, &lastByte) || lastByte < firstByte) {
+		return HKByteRangeNone;
+	}
+
+	if (firstByte >= size) {
+		return HKByteRangeUnsatisfiable;
+	}
+	if (lastByte >= size) {
+		lastByte = size - 1;
+	}
+	*offset = firstByte;
+	*length = lastByte - firstByte + 1;
+	return HKByteRangeSatisfiable;
+}
+
+// Format a timestamp as an IMF-fixdate, independent of the locale
+static NSString *HTTPDate(time_t timestamp) {
+	static const char *days[] = {"Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat"};
+	static const char *months[] = {"Jan", "Feb", "Mar", "Apr", "May", "Jun",
+								   "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"};
+	struct tm tm;
+
+	gmtime_r(&timestamp, &tm);
+	return [NSString stringWithFormat:@"%s, %02d %s %04d %02d:%02d:%02d GMT", days[tm.tm_wday],
+									  tm.tm_mday, months[tm.tm_mon], tm.tm_year + 1900,
+									  tm.tm_hour, tm.tm_min, tm.tm_sec];
+}
+
+@implementation HKHTTPFileResponse {
+	int _fd;
+}
+
++ (instancetype)responseWithPath:(NSString *)path
+						 request:(HKHTTPRequest *)request
+						 headers:(NSDictionary<NSString *, NSString *> *)headers
+						   error:(NSError **)error {
+	return [[self alloc] initWithPath:path request:request headers:headers error:error];
+}
+
+- (instancetype)initWithPath:(NSString *)path
+					 request:(HKHTTPRequest *)request
+					 headers:(NSDictionary<NSString *, NSString *> *)headers
+					   error:(NSError **)error {
+	self = [super initWithStatus:200];
+	if (self) {
+		NSMutableDictionary<NSString *, NSString *> *responseHeaders;
+		NSString *lastModified, *ETag, *rangeHeader, *ifRange;
+		HKByteRangeResult range;
+		struct stat st;
+
+		_fd = open([path fileSystemRepresentation], O_RDONLY | O_CLOEXEC);
+		if (_fd < 0) {
+			if (error) {
+				*error = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:nil];
+			}
+			return nil;
+		}
+		if (fstat(_fd, &st) != 0) {
+			if (error) {
+				*error = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:nil];
+			}
+			return nil;
+		}
+		if (!S_ISREG(st.st_mode)) {
+			if (error) {
+				*error = [NSError errorWithDomain:NSPOSIXErrorDomain code:EISDIR userInfo:nil];
+			}
+			return nil;
+		}
+
+		_path = [path copy];
+		_fileSize = (uint64_t) st.st_size;
+		_offset = 0;
+		_length = _fileSize;
+
+		lastModified = HTTPDate(st.st_mtime);
+		ETag = [NSString stringWithFormat:@"\"%llx-%llx\"", (unsigned long long) st.st_size,
+										  (unsigned long long) st.st_mtime];
+
+		responseHeaders = [NSMutableDictionary dictionaryWithDictionary:@{
+			@"Content-Type" : @"application/octet-stream",
+			@"Accept-Ranges" : @"bytes",
+			@"Last-Modified" : lastModified,
+			@"ETag" : ETag,
+		}];
+
+		rangeHeader = [request headers][HKHTTPHeaderRange];
+		ifRange = [request headers][HKHTTPHeaderIfRange];
+		// A range is only applied to the representation the client already has
+		if (rangeHeader && (!ifRange || [ifRange isEqualToString:ETag] ||
+							[ifRange isEqualToString:lastModified])) {
+			uint64_t offset = 0;
+			uint64_t length = 0;
+
+			range = parseByteRange(rangeHeader, _fileSize, &offset, &length);
+			if (range == HKByteRangeSatisfiable) {
+				_offset = offset;
+				_length = length;
+				[self setStatus:206];
+				responseHeaders[@"Content-Range"] = [NSString
+					stringWithFormat:@"bytes %llu-%llu/%llu", (unsigned long long) offset,
+									 (unsigned long long) (offset + length - 1),
+									 (unsigned long long) _fileSize];
+			} else if (range == HKByteRangeUnsatisfiable) {
+				// The response has no body
+				close(_fd);
+				_fd = -1;
+				_length = 0;
+				[self setStatus:416];
+				responseHeaders[@"Content-Range"] =
+					[NSString stringWithFormat:@"bytes */%llu", (unsigned long long) _fileSize];
+			}
+		}
+
+		// Additional headers replace the defaults regardless of their case
+		for (NSString *key in headers) {
+			for (NSString *existing in [responseHeaders allKeys]) {
+				if ([existing caseInsensitiveCompare:key] == NSOrderedSame) {
+					[responseHeaders removeObjectForKey:existing];
+				}
+			}
+			responseHeaders[key] = headers[key];
+		}
+		[self setHeaders:responseHeaders];
+	}
+	return self;
+}
+
+- (BOOL)isImmutable {
+	return NO;
+}
+
+- (int)takeFileDescriptor {
+	int fd = _fd;
+
+	_fd = -1;
+	return fd;
+}
+
+- (void)dealloc {
+	// The response was never sent
+	if (_fd >= 0) {
+		close(_fd);
+	}
+}
+
+@end
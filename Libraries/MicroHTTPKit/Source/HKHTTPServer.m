@@ -9,10 +9,16 @@
 
 // Private headers
 #import "HKHTTPRequest+Private.h"
+#import "HKHTTPResponse+Private.h"
+#import "HKRouter+Private.h"
 
 #include <arpa/inet.h>
+#include <errno.h>
 #include <microhttpd.h>
 #include <netinet/in.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <unistd.h>
 
 HKConnectionLogger HKDefaultConnectionLogger = ^(HKHTTPRequest *r) {
 	NSLog(@"%@ %@ Headers: %@ Query Params: %@", [r method], [r URL], [r headers],
@@ -194,32 +200,388 @@ static void requestCompletedCallback(__attribute__((unused)) void *cls,
 	}
 }
 
+#if MHD_VERSION >= 0x00097300
+// A MHD_ContentReaderFreeCallback releasing the data object of a response body
+static void releaseResponseData(void *cls) {
+	@autoreleasepool {
+		(void) (__bridge_transfer NSData *) cls;
+	}
+}
+#endif
+
+static void addResponseHeaders(struct MHD_Response *mhd_response, HKHTTPResponse *response) {
+	NSDictionary<NSString *, NSString *> *headers;
+
+	headers = [response headers];
+	for (NSString *key in headers) {
+		MHD_add_response_header(mhd_response, [key UTF8String], [headers[key] UTF8String]);
+	}
+}
+
+/* A MHD_ContentReaderCallback asking the producer of a streaming response for
+ * the next part of the body. libmicrohttpd only calls it when the socket can
+ * take more data.
+ *
+ * A reader returning 0 is called again immediately by the internal polling
+ * thread, which spins until the producer has data. Producers thus have to
+ * return data, or the end of the stream, and 0 ends the body with an error.
+ */
+static ssize_t readStreamingResponse(void *cls, uint64_t pos, char *buf, size_t max) {
+	@autoreleasepool {
+		HKHTTPStreamingResponse *response;
+		NSInteger result;
+
+		response = (__bridge HKHTTPStreamingResponse *) cls;
+		result = [response producer]((uint8_t *) buf, max, pos);
+
+		if (result == HKHTTPStreamingResponseEndOfStream) {
+			return MHD_CONTENT_READER_END_OF_STREAM;
+		} else if (result <= 0 || (size_t) result > max) {
+			return MHD_CONTENT_READER_END_WITH_ERROR;
+		}
+		return (ssize_t) result;
+	}
+}
+
+// A MHD_ContentReaderFreeCallback releasing a streaming response
+static void releaseStreamingResponse(void *cls) {
+	@autoreleasepool {
+		HKHTTPStreamingResponse *response;
+
+		response = (__bridge_transfer HKHTTPStreamingResponse *) cls;
+		[response streamDidTerminate];
+	}
+}
+
+/* Create a libmicrohttpd response from a HKHTTPStreamingResponse. The response
+ * object is retained until libmicrohttpd destroys the response.
+ */
+static struct MHD_Response *createMHDStreamingResponse(HKHTTPStreamingResponse *response) {
+	struct MHD_Response *mhd_response;
+	uint64_t size;
+	void *cls;
+
+	size = [response contentLength];
+	if (size == HKHTTPStreamingResponseUnknownLength) {
+		size = MHD_SIZE_UNKNOWN;
+	}
+
+	cls = (__bridge_retained void *) response;
+	mhd_response = MHD_create_response_from_callback(size, [response blockSize],
+													 readStreamingResponse, cls,
+													 releaseStreamingResponse);
+	if (!mhd_response) {
+		releaseStreamingResponse(cls);
+		return NULL;
+	}
+
+	addResponseHeaders(mhd_response, response);
+	return mhd_response;
+}
+
+/* Create a libmicrohttpd response from a HKHTTPFileResponse. libmicrohttpd
+ * takes ownership of the file descriptor, and sends the file with sendfile(2)
+ * where possible. Responses without a body fall back to an empty buffer.
+ */
+static struct MHD_Response *createMHDFileResponse(HKHTTPFileResponse *response) {
+	struct MHD_Response *mhd_response;
+	int fd;
+
+	fd = [response takeFileDescriptor];
+	if (fd < 0) {
+		mhd_response = MHD_create_response_from_buffer(0, "", MHD_RESPMEM_PERSISTENT);
+	} else {
+		mhd_response =
+			MHD_create_response_from_fd_at_offset64([response length], fd, [response offset]);
+		if (!mhd_response) {
+			close(fd);
+		}
+	}
+	if (!mhd_response) {
+		return NULL;
+	}
+
+	addResponseHeaders(mhd_response, response);
+	return mhd_response;
+}
+
+/* Create a libmicrohttpd response from a HKHTTPResponse.
+ *
+ * The body is not copied. The data object is retained until libmicrohttpd
+ * destroys the response instead. Copying an immutable NSData only retains it,
+ * while mutable data is copied, as the handler might still change it.
+ */
+static struct MHD_Response *createMHDResponse(HKHTTPResponse *response) {
+	struct MHD_Response *mhd_response;
+	NSData *data;
+
+	if ([response isKindOfClass:[HKHTTPStreamingResponse class]]) {
+		return createMHDStreamingResponse((HKHTTPStreamingResponse *) response);
+	}
+	if ([response isKindOfClass:[HKHTTPFileResponse class]]) {
+		return createMHDFileResponse((HKHTTPFileResponse *) response);
+	}
+
+	data = [[response data] copy];
+	if ([data length] > 0) {
+#if MHD_VERSION >= 0x00097300
+		void *cls = (__bridge_retained void *) data;
+
+		mhd_response = MHD_create_response_from_buffer_with_free_callback_cls(
+			[data length], (void *) [data bytes], releaseResponseData, cls);
+		if (!mhd_response) {
+			releaseResponseData(cls);
+			return NULL;
+		}
+#else
+		// Older versions of libmicrohttpd cannot pass a context to the free callback
+		mhd_response = MHD_create_response_from_buffer([data length], (void *) [data bytes],
+													   MHD_RESPMEM_MUST_COPY);
+		if (!mhd_response) {
+			return NULL;
+		}
+#endif
+	} else {
+		mhd_response = MHD_create_response_from_buffer(0, "", MHD_RESPMEM_PERSISTENT);
+		if (!mhd_response) {
+			return NULL;
+		}
+	}
+
+	addResponseHeaders(mhd_response, response);
+	return mhd_response;
+}
+
+static NSTimeInterval monotonicTime(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* The response of an asynchronous handler. The connection is suspended until the
+ * response is set, or the thread of the connection waits for it with a thread per
+ * connection.
+ */
+@interface _HKPendingResponse : NSObject
+@property (nonatomic, assign) struct MHD_Connection *connection;
+@property (nonatomic, strong) HKRoute *route;
+@property (nonatomic, assign) NSTimeInterval start;
+@property (nonatomic, assign) BOOL suspended;
+
+// Set the response, and resume the connection, or wake the waiting thread
+- (void)completeWithResponse:(HKHTTPResponse *)response;
+- (HKHTTPResponse *)waitForResponse;
+- (HKHTTPResponse *)response;
+@end
+
+@implementation _HKPendingResponse {
+	NSCondition *_condition;
+	HKHTTPResponse *_response;
+}
+
+- (instancetype)init {
+	self = [super init];
+	if (self) {
+		_condition = [NSCondition new];
+	}
+	return self;
+}
+
+- (void)completeWithResponse:(HKHTTPResponse *)response {
+	[_condition lock];
+	_response = response;
+	[_condition signal];
+	[_condition unlock];
+
+	if (_suspended) {
+		// libmicrohttpd calls the access handler again, which queues the response
+		MHD_resume_connection(_connection);
+	}
+}
+
+- (HKHTTPResponse *)waitForResponse {
+	HKHTTPResponse *response;
+
+	[_condition lock];
+	while (_response == nil) {
+		[_condition wait];
+	}
+	response = _response;
+	[_condition unlock];
+
+	return response;
+}
+
+- (HKHTTPResponse *)response {
+	HKHTTPResponse *response;
+
+	[_condition lock];
+	response = _response;
+	[_condition unlock];
+
+	return response;
+}
+
+@end
+
+@implementation HKHTTPServerConfiguration
+
++ (instancetype)defaultConfiguration {
+	return [[self alloc] init];
+}
+
+- (instancetype)init {
+	self = [super init];
+	if (self) {
+		_threadingModel = HKHTTPServerThreadingModelInternalThread;
+		_threadPoolSize = 4;
+		_pollingMode = HKHTTPServerPollingModeAuto;
+		_connectionLimit = 0;
+		_perIPConnectionLimit = 0;
+		_connectionTimeout = 0;
+	}
+	return self;
+}
+
+- (id)copyWithZone:(NSZone *)zone {
+	HKHTTPServerConfiguration *copy = [[[self class] allocWithZone:zone] init];
+
+	[copy setThreadingModel:_threadingModel];
+	[copy setThreadPoolSize:_threadPoolSize];
+	[copy setPollingMode:_pollingMode];
+	[copy setConnectionLimit:_connectionLimit];
+	[copy setPerIPConnectionLimit:_perIPConnectionLimit];
+	[copy setConnectionTimeout:_connectionTimeout];
+	return copy;
+}
+
+- (NSString *)description {
+	return [NSString stringWithFormat:@"<%@: threadingModel=%ld threadPoolSize=%lu "
+									  @"pollingMode=%ld connectionLimit=%lu "
+									  @"perIPConnectionLimit=%lu connectionTimeout=%lu>",
+									  [self class], (long) _threadingModel,
+									  (unsigned long) _threadPoolSize, (long) _pollingMode,
+									  (unsigned long) _connectionLimit,
+									  (unsigned long) _perIPConnectionLimit,
+									  (unsigned long) _connectionTimeout];
+}
+
+@end
+
 @implementation HKHTTPServer {
 	struct MHD_Daemon *_daemon;
+	atomic_ullong _notFoundRequests;
+	// Asynchronous handlers that did not complete yet. Protected by @synchronized.
+	NSMutableSet<_HKPendingResponse *> *_pendingResponses;
 }
 
 + (instancetype)serverWithPort:(NSUInteger)port {
 	return [[self alloc] initWithPort:port];
 }
 
++ (instancetype)serverWithPort:(NSUInteger)port
+				 configuration:(HKHTTPServerConfiguration *)configuration {
+	return [[self alloc] initWithPort:port configuration:configuration];
+}
+
 - (instancetype)initWithPort:(NSUInteger)port {
+	return [self initWithPort:port configuration:[HKHTTPServerConfiguration defaultConfiguration]];
+}
+
+- (instancetype)initWithPort:(NSUInteger)port
+			   configuration:(HKHTTPServerConfiguration *)configuration {
 	self = [super init];
 	if (self) {
+		HKHTTPResponse *notFound;
+
+		// The same response is queued for all unknown routes
+		notFound = [HKHTTPResponse responseWithStatus:404];
+		[notFound setImmutable:YES];
+
 		_port = port;
+		_configuration = [configuration copy];
+		_pendingResponses = [NSMutableSet set];
 		_router = [HKRouter
 			routerWithRoutes:@[]
 			 notFoundHandler:^HKHTTPResponse *(__attribute__((unused)) HKHTTPRequest *request) {
-				 return [HKHTTPResponse responseWithStatus:404];
+				 return notFound;
 			 }];
 	}
 	return self;
 }
 
 - (BOOL)startWithError:(NSError **)error {
-	_daemon = MHD_start_daemon(MHD_USE_AUTO_INTERNAL_THREAD | MHD_USE_DUAL_STACK,
-							   (unsigned short) _port, NULL, NULL, &accessHandler,
+	struct MHD_OptionItem options[5];
+	unsigned int flags;
+	NSUInteger count = 0;
+
+	flags = MHD_USE_INTERNAL_POLLING_THREAD | MHD_USE_DUAL_STACK;
+
+	switch ([_configuration pollingMode]) {
+	case HKHTTPServerPollingModePoll:
+		flags |= MHD_USE_POLL;
+		break;
+	case HKHTTPServerPollingModeEpoll:
+		flags |= MHD_USE_EPOLL;
+		break;
+	default:
+		flags |= MHD_USE_AUTO;
+		break;
+	}
+
+	switch ([_configuration threadingModel]) {
+	case HKHTTPServerThreadingModelThreadPool:
+		if ([_configuration threadPoolSize] == 0) {
+			NSLog(@"Invalid thread pool size of 0");
+			if (error) {
+				*error = [NSError errorWithDomain:NSPOSIXErrorDomain code:EINVAL userInfo:nil];
+			}
+			return NO;
+		}
+		options[count++] = (struct MHD_OptionItem){
+			MHD_OPTION_THREAD_POOL_SIZE, (intptr_t) [_configuration threadPoolSize], NULL};
+		break;
+	case HKHTTPServerThreadingModelThreadPerConnection:
+		// libmicrohttpd cannot use epoll with a thread per connection
+		if ([_configuration pollingMode] == HKHTTPServerPollingModeEpoll) {
+			NSLog(@"epoll is not supported with a thread per connection");
+			if (error) {
+				*error = [NSError errorWithDomain:NSPOSIXErrorDomain code:EINVAL userInfo:nil];
+			}
+			return NO;
+		}
+		flags |= MHD_USE_THREAD_PER_CONNECTION;
+		break;
+	default:
+		break;
+	}
+
+	// Connections are suspended while an asynchronous handler runs. With a thread per
+	// connection, the thread waits for the response instead.
+	if ([_configuration threadingModel] != HKHTTPServerThreadingModelThreadPerConnection) {
+		flags |= MHD_ALLOW_SUSPEND_RESUME;
+	}
+
+	if ([_configuration connectionLimit] > 0) {
+		options[count++] = (struct MHD_OptionItem){
+			MHD_OPTION_CONNECTION_LIMIT, (intptr_t) [_configuration connectionLimit], NULL};
+	}
+	if ([_configuration perIPConnectionLimit] > 0) {
+		options[count++] = (struct MHD_OptionItem){
+			MHD_OPTION_PER_IP_CONNECTION_LIMIT, (intptr_t) [_configuration perIPConnectionLimit],
+			NULL};
+	}
+	if ([_configuration connectionTimeout] > 0) {
+		options[count++] = (struct MHD_OptionItem){
+			MHD_OPTION_CONNECTION_TIMEOUT, (intptr_t) [_configuration connectionTimeout], NULL};
+	}
+	options[count] = (struct MHD_OptionItem){MHD_OPTION_END, 0, NULL};
+
+	_daemon = MHD_start_daemon(flags, (unsigned short) _port, NULL, NULL, &accessHandler,
 							   (__bridge void *) (self), MHD_OPTION_NOTIFY_COMPLETED,
-							   requestCompletedCallback, NULL, MHD_OPTION_END);
+							   requestCompletedCallback, NULL, MHD_OPTION_ARRAY, options,
+							   MHD_OPTION_END);
 	if (!_daemon) {
 		if (error) {
 			*error = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:nil];
@@ -229,13 +591,110 @@ static void requestCompletedCallback(__attribute__((unused)) void *cls,
 	return YES;
 }
 
+- (NSUInteger)numberOfNotFoundRequests {
+	return (NSUInteger) atomic_load_explicit(&_notFoundRequests, memory_order_relaxed);
+}
+
 - (void)stop {
 	if (_daemon) {
+		// libmicrohttpd cannot stop with suspended connections
+		@synchronized(_pendingResponses) {
+			for (_HKPendingResponse *pending in _pendingResponses) {
+				[pending completeWithResponse:[HKHTTPResponse responseWithStatus:503]];
+			}
+			[_pendingResponses removeAllObjects];
+		}
+
 		MHD_stop_daemon(_daemon);
 		_daemon = NULL;
 	}
 }
 
+// Queue the response, and record it in the statistics of the route
+- (enum MHD_Result)_queueResponse:(HKHTTPResponse *)response
+							route:(HKRoute *)route
+					   connection:(struct MHD_Connection *)conn
+							start:(NSTimeInterval)start {
+	struct MHD_Response *mhd_response;
+	int returnCode;
+
+	if ([response isImmutable]) {
+		// Reuse the libmicrohttpd response of an earlier request
+		@synchronized(response) {
+			mhd_response = [response persistentResponse];
+			if (!mhd_response) {
+				mhd_response = createMHDResponse(response);
+				[response setPersistentResponse:mhd_response];
+			}
+		}
+		if (!mhd_response) {
+			return MHD_NO;
+		}
+
+		returnCode = MHD_queue_response(conn, (unsigned int) [response status], mhd_response);
+	} else {
+		mhd_response = createMHDResponse(response);
+		if (!mhd_response) {
+			return MHD_NO;
+		}
+
+		returnCode = MHD_queue_response(conn, (unsigned int) [response status], mhd_response);
+		MHD_destroy_response(mhd_response);
+	}
+
+	[route recordResponseWithStatus:[response status] duration:monotonicTime() - start];
+
+	return returnCode;
+}
+
+/* Run the asynchronous handler of a route. The connection is suspended, and the
+ * response is queued when libmicrohttpd calls the access handler after the
+ * connection was resumed. With a thread per connection, we block until the
+ * response is ready instead.
+ */
+- (enum MHD_Result)_runAsyncHandlerForRequest:(HKHTTPRequest *)request
+										route:(HKRoute *)route
+								   connection:(struct MHD_Connection *)conn
+										start:(NSTimeInterval)start {
+	NSMutableSet<_HKPendingResponse *> *pendingResponses = _pendingResponses;
+	_HKPendingResponse *pending;
+	BOOL suspend;
+
+	suspend = [_configuration threadingModel] != HKHTTPServerThreadingModelThreadPerConnection;
+
+	pending = [_HKPendingResponse new];
+	[pending setConnection:conn];
+	[pending setRoute:route];
+	[pending setStart:start];
+	[pending setSuspended:suspend];
+
+	@synchronized(pendingResponses) {
+		[pendingResponses addObject:pending];
+	}
+	if (suspend) {
+		[request setAsyncContext:pending];
+		MHD_suspend_connection(conn);
+	}
+
+	[route asyncHandler](request, ^(HKHTTPResponse *response) {
+		// Resume while holding the lock, so the server cannot be stopped in the meantime
+		@synchronized(pendingResponses) {
+			// Ignore repeated calls, and calls after the server was stopped
+			if (![pendingResponses containsObject:pending]) {
+				return;
+			}
+			[pendingResponses removeObject:pending];
+			[pending completeWithResponse:response ?: [HKHTTPResponse responseWithStatus:500]];
+		}
+	});
+
+	if (suspend) {
+		return MHD_YES;
+	}
+
+	return [self _queueResponse:[pending waitForResponse] route:route connection:conn start:start];
+}
+
 /*
 	Get connection information, and search for a registered handler in the router.
 	If a handler is found, execute it and return the result, otherwise execute
@@ -247,18 +706,32 @@ static void requestCompletedCallback(__attribute__((unused)) void *cls,
 								connection:(struct MHD_Connection *)conn
 									   URL:(NSURL *)URL
 									method:(NSString *)method {
-	struct MHD_Response *mhd_response;
-	int returnCode;
+	NSTimeInterval start;
 
 	HKHTTPResponse *response = nil;
+	HKHandlerBlock handler = nil;
 	HKHandlerBlock middlewareHandler = nil;
-	NSData *responseData = nil;
-	NSDictionary<NSString *, NSString *> *responseHeaders = nil;
-	HKHandlerBlock handler = [[self router] handlerForRequest:request];
+	HKRoute *route;
+	_HKPendingResponse *pending;
+
+	// The connection was resumed after the asynchronous handler completed
+	pending = [request asyncContext];
+	if (pending) {
+		[request setAsyncContext:nil];
+		return [self _queueResponse:[pending response]
+							  route:[pending route]
+						 connection:conn
+							  start:[pending start]];
+	}
+
+	start = monotonicTime();
+	route = [[self router] routeForRequest:request];
+	handler = [route handler];
 	middlewareHandler = [[self router] middleware];
 
 	if (!handler) {
 		NSLog(@"Could not find handler!");
+		atomic_fetch_add_explicit(&_notFoundRequests, 1, memory_order_relaxed);
 		handler = [[self router] notFoundHandler];
 		response = handler(request);
 	} else if (middlewareHandler) {
@@ -266,37 +739,14 @@ static void requestCompletedCallback(__attribute__((unused)) void *cls,
 	}
 
 	// If middleware set a response, use it. Otherwise, use the response from the router.
-	if (response == nil) {
+	if (response == nil && [route asyncHandler]) {
+		return [self _runAsyncHandlerForRequest:request route:route connection:conn start:start];
+	} else if (response == nil) {
 		// Execute the installed handler block
 		response = handler(request);
 	}
 
-	responseData = [response data];
-	responseHeaders = [response headers];
-
-	// If we have response data, create a response from it. Otherwise, create an empty response.
-	if (responseData) {
-		// We need to copy the response data, as we do not have direct control over the lifetime
-		// of the NSData object.
-		mhd_response = MHD_create_response_from_buffer(
-			[responseData length], (void *) [responseData bytes], MHD_RESPMEM_MUST_COPY);
-		if (!mhd_response) {
-			return MHD_NO;
-		}
-	} else {
-		mhd_response = MHD_create_response_from_buffer(0, "", MHD_RESPMEM_PERSISTENT);
-	}
-
-	if (responseHeaders) {
-		for (NSString *key in [responseHeaders allKeys]) {
-			NSString *value = [responseHeaders objectForKey:key];
-			MHD_add_response_header(mhd_response, [key UTF8String], [value UTF8String]);
-		}
-	}
-
-	returnCode = MHD_queue_response(conn, (unsigned int) [response status], mhd_response);
-	MHD_destroy_response(mhd_response);
-	return returnCode;
+	return [self _queueResponse:response route:route connection:conn start:start];
 }
 
 @end
@@ -0,0 +1,13 @@
+/* MicroHTTPKit - A small libmicrohttpd wrapper
+ * Copyright (C) 2023 Hugo Melder
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#import <MicroHTTPKit/HKRouter.h>
+
+@interface HKRoute (Private)
+
+- (void)recordResponseWithStatus:(NSUInteger)status duration:(NSTimeInterval)duration;
+
+@end
@@ -7,11 +7,33 @@
 #import <MicroHTTPKit/HKHTTPConstants.h>
 #import <MicroHTTPKit/HKRouter.h>
 
+// Private headers
+#import "HKRouter+Private.h"
+
+#include <stdatomic.h>
+
+NSString *const HKRouteStatisticsRequestsKey = @"requests";
+NSString *const HKRouteStatisticsResponsesKey = @"responses";
+NSString *const HKRouteStatisticsDurationBucketsKey = @"durationBuckets";
+NSString *const HKRouteStatisticsDurationSumKey = @"durationSum";
+
+const NSTimeInterval HKRouteDurationBuckets[HK_ROUTE_DURATION_BUCKET_COUNT] = {
+	0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.5, 1.0,
+};
+
 @interface HKRouter ()
 @property (nonatomic, readwrite) NSArray<HKRoute *> *routes;
 @end
 
-@implementation HKRoute
+@implementation HKRoute {
+	atomic_ullong _requests;
+	// Responses by status class, starting with 1xx
+	atomic_ullong _responses[5];
+	// Requests per duration bucket (not cumulative)
+	atomic_ullong _durationBuckets[HK_ROUTE_DURATION_BUCKET_COUNT];
+	// Total duration in microseconds
+	atomic_ullong _durationSum;
+}
 
 + (instancetype)routeWithPath:(NSString *)path
 					   method:(NSString *)method
@@ -33,6 +55,96 @@
 	return self;
 }
 
++ (instancetype)routeWithPath:(NSString *)path
+					   method:(NSString *)method
+				 asyncHandler:(HKAsyncHandlerBlock)asyncHandler {
+	return [[self alloc] initWithPath:path method:method asyncHandler:asyncHandler];
+}
+
+- (instancetype)initWithPath:(NSString *)path
+					  method:(NSString *)method
+				asyncHandler:(HKAsyncHandlerBlock)asyncHandler {
+	HKHandlerBlock handler;
+
+	asyncHandler = [asyncHandler copy];
+	// Blocking variant for callers of -handler
+	handler = ^HKHTTPResponse *(HKHTTPRequest *request) {
+		NSCondition *condition = [NSCondition new];
+		__block HKHTTPResponse *response = nil;
+
+		asyncHandler(request, ^(HKHTTPResponse *asyncResponse) {
+			[condition lock];
+			response = asyncResponse;
+			[condition signal];
+			[condition unlock];
+		});
+
+		[condition lock];
+		while (response == nil) {
+			[condition wait];
+		}
+		[condition unlock];
+
+		return response;
+	};
+
+	self = [self initWithPath:path method:method handler:handler];
+	if (self) {
+		_asyncHandler = asyncHandler;
+	}
+
+	return self;
+}
+
+- (void)recordResponseWithStatus:(NSUInteger)status duration:(NSTimeInterval)duration {
+	NSUInteger statusClass;
+
+	atomic_fetch_add_explicit(&_requests, 1, memory_order_relaxed);
+
+	statusClass = status / 100;
+	if (statusClass >= 1 && statusClass <= 5) {
+		atomic_fetch_add_explicit(&_responses[statusClass - 1], 1, memory_order_relaxed);
+	}
+
+	// Requests slower than the last bucket are only counted in the total
+	for (NSUInteger i = 0; i < HK_ROUTE_DURATION_BUCKET_COUNT; i++) {
+		if (duration <= HKRouteDurationBuckets[i]) {
+			atomic_fetch_add_explicit(&_durationBuckets[i], 1, memory_order_relaxed);
+			break;
+		}
+	}
+
+	atomic_fetch_add_explicit(&_durationSum, (unsigned long long) (duration * 1e6),
+							  memory_order_relaxed);
+}
+
+- (NSDictionary *)statistics {
+	NSMutableDictionary *responses;
+	NSMutableArray *buckets;
+	unsigned long long cumulative = 0;
+
+	responses = [NSMutableDictionary dictionaryWithCapacity:5];
+	for (NSUInteger i = 0; i < 5; i++) {
+		NSString *statusClass = [NSString stringWithFormat:@"%lux", (unsigned long) i + 1];
+		responses[statusClass] =
+			@(atomic_load_explicit(&_responses[i], memory_order_relaxed));
+	}
+
+	buckets = [NSMutableArray arrayWithCapacity:HK_ROUTE_DURATION_BUCKET_COUNT];
+	for (NSUInteger i = 0; i < HK_ROUTE_DURATION_BUCKET_COUNT; i++) {
+		cumulative += atomic_load_explicit(&_durationBuckets[i], memory_order_relaxed);
+		[buckets addObject:@(cumulative)];
+	}
+
+	return @{
+		HKRouteStatisticsRequestsKey : @(atomic_load_explicit(&_requests, memory_order_relaxed)),
+		HKRouteStatisticsResponsesKey : responses,
+		HKRouteStatisticsDurationBucketsKey : buckets,
+		HKRouteStatisticsDurationSumKey :
+			@(atomic_load_explicit(&_durationSum, memory_order_relaxed) / 1e6),
+	};
+}
+
 @end
 
 @implementation HKRouter {
@@ -56,20 +168,43 @@
 	return self;
 }
 
-// TODO: We can probably store all registered routes in a dictionary instead
-// with the key being the HKRoute and the value the handler block.
 - (nullable HKHandlerBlock)handlerForRequest:(HKHTTPRequest *)request {
+	return [[self routeForRequest:request] handler];
+}
+
+// TODO: We can probably store all registered routes in a dictionary instead
+// with the key being the path.
+- (nullable HKRoute *)routeForRequest:(HKHTTPRequest *)request {
 	NSString *requestPath;
+	HKRoute *prefixRoute = nil;
+	NSUInteger prefixLength = 0;
 	requestPath = [[request URL] path];
 
 	for (HKRoute *route in [self routes]) {
-		if ([requestPath isEqualToString:[route path]] &&
-			[[request method] isEqualToString:[route method]]) {
-			return [route handler];
+		NSString *path;
+
+		if (![[request method] isEqualToString:[route method]]) {
+			continue;
+		}
+
+		path = [route path];
+		if ([requestPath isEqualToString:path]) {
+			return route;
+		}
+
+		// Prefix routes keep the trailing slash, so "/files/*" does not match "/filesystem"
+		if ([path hasSuffix:@"/*"]) {
+			NSString *prefix = [path substringToIndex:[path length] - 1];
+
+			// The longest matching prefix wins
+			if ([requestPath hasPrefix:prefix] && [prefix length] > prefixLength) {
+				prefixRoute = route;
+				prefixLength = [prefix length];
+			}
 		}
 	}
 
-	return nil;
+	return prefixRoute;
 }
 
 - (void)registerRoute:(HKRoute *)route withCORSHandler:(HKHandlerBlock)handler {
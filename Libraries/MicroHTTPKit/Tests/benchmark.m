@@ -0,0 +1,128 @@
+/* MicroHTTPKit - A small libmicrohttpd wrapper
+ * Copyright (C) 2024 Hugo Melder
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#import <MicroHTTPKit/MicroHTTPKit.h>
+#import <XCTest/XCTest.h>
+
+#include <sys/resource.h>
+#include <time.h>
+
+#import "main.h"
+
+// Size of the response body
+#define BODY_SIZE (4 * 1024 * 1024)
+// Number of requests per benchmark
+#define ITERATIONS 100
+
+static NSTimeInterval monotonicTime(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Maximum resident set size of the process in KiB
+static long maxResidentSetSize(void) {
+	struct rusage usage;
+
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_maxrss;
+}
+
+@interface Benchmark : XCTestCase
+@end
+
+@implementation Benchmark
+
+/* Request a large body ITERATIONS times, and log the throughput, and the growth of
+ * the resident set size. The handler returns the response built by the block.
+ */
+- (void)_benchmark:(NSString *)name
+			  port:(NSUInteger)port
+		  response:(HKHTTPResponse * (^)(void))makeResponse {
+	HKHTTPServer *server;
+	HKRoute *route;
+	NSError *error = nil;
+	NSURLRequest *request;
+	NSTimeInterval start, duration;
+	long rssBefore;
+	NSUInteger received = 0;
+
+	server = [[HKHTTPServer alloc] initWithPort:port];
+	route = [HKRoute routeWithPath:@"/body"
+							method:HKHTTPMethodGET
+						   handler:^(HKHTTPRequest *request) {
+							   return makeResponse();
+						   }];
+	[[server router] registerRoute:route];
+	XCTAssertTrue([server startWithError:&error], @"Server started successfully");
+
+	request = [NSURLRequest
+		requestWithURL:[NSURL URLWithString:[NSString
+												stringWithFormat:@"http://localhost:%lu/body",
+																 (unsigned long) port]]];
+
+	rssBefore = maxResidentSetSize();
+	start = monotonicTime();
+	for (NSUInteger i = 0; i < ITERATIONS; i++) {
+		NSHTTPURLResponse *response = nil;
+		NSData *data;
+
+		data = [NSURLConnection sendSynchronousRequest:request
+									 returningResponse:&response
+												 error:&error];
+		XCTAssertNotNil(data, @"Response data is valid");
+		XCTAssertEqual([response statusCode], 200, @"HTTP status code is 200");
+		received += [data length];
+	}
+	duration = monotonicTime() - start;
+
+	XCTAssertEqual(received, (NSUInteger) BODY_SIZE * ITERATIONS, @"Received all bodies");
+	NSLog(@"%@: %d requests in %.3f s (%.1f requests/s, %.1f MiB/s), max RSS grew by %ld KiB",
+		  name, ITERATIONS, duration, ITERATIONS / duration,
+		  received / duration / (1024 * 1024), maxResidentSetSize() - rssBefore);
+
+	[server stop];
+}
+
+// A new mutable body per request, which the server has to copy
+- (void)testMutableBody {
+	NSMutableData *body = [NSMutableData dataWithLength:BODY_SIZE];
+
+	[self _benchmark:@"Mutable body"
+				port:8090
+			response:^HKHTTPResponse * {
+				return [HKHTTPResponse responseWithData:[body mutableCopy] status:200];
+			}];
+}
+
+// A new immutable body per request, which is passed to libmicrohttpd without copying
+- (void)testImmutableBody {
+	NSData *body = [NSMutableData dataWithLength:BODY_SIZE];
+
+	[self _benchmark:@"Immutable body"
+				port:8091
+			response:^HKHTTPResponse * {
+				return [HKHTTPResponse responseWithData:[NSData dataWithData:body] status:200];
+			}];
+}
+
+// The same immutable response for all requests, reused as a persistent MHD response
+- (void)testPersistentResponse {
+	HKHTTPResponse *response;
+
+	response = [HKHTTPResponse responseWithData:[NSMutableData dataWithLength:BODY_SIZE]
+										 status:200];
+	[response setImmutable:YES];
+
+	[self _benchmark:@"Persistent response"
+				port:8092
+			response:^HKHTTPResponse * {
+				return response;
+			}];
+}
+
+@end
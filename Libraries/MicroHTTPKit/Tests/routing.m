@@ -7,6 +7,8 @@
 #import <MicroHTTPKit/MicroHTTPKit.h>
 #import <XCTest/XCTest.h>
 
+#include <errno.h>
+
 #import "main.h"
 
 static const NSString *REQUEST_BODY_STRING = @"Hello, World!";
@@ -163,6 +165,77 @@ static const NSString *RESPONSE_STRING = @"Received!";
 	XCTAssertEqualObjects(str, RESPONSE_STRING, @"Response data is valid");
 }
 
+- (void)testPrefixRoute {
+	HKHTTPServer *server;
+	HKRoute *prefixRoute, *nestedRoute, *exactRoute;
+	NSError *error = NULL;
+	NSURL *url;
+	NSData *data;
+	NSString *str;
+	NSHTTPURLResponse *responseObj = nil;
+
+	server = [[HKHTTPServer alloc] initWithPort:8082];
+	XCTAssertNotNil(server, @"Server is valid");
+
+	prefixRoute = [HKRoute
+		routeWithPath:@"/files/*"
+			   method:HKHTTPMethodGET
+			  handler:^(HKHTTPRequest *request) {
+				  NSData *path = [[[request URL] path] dataUsingEncoding:NSUTF8StringEncoding];
+				  return [HKHTTPResponse responseWithData:path status:200];
+			  }];
+	nestedRoute = [HKRoute
+		routeWithPath:@"/files/nested/*"
+			   method:HKHTTPMethodGET
+			  handler:^(HKHTTPRequest *request) {
+				  return [HKHTTPResponse
+					  responseWithData:[@"nested" dataUsingEncoding:NSUTF8StringEncoding]
+								status:200];
+			  }];
+	exactRoute = [HKRoute
+		routeWithPath:@"/files/exact"
+			   method:HKHTTPMethodGET
+			  handler:^(HKHTTPRequest *request) {
+				  return [HKHTTPResponse
+					  responseWithData:[@"exact" dataUsingEncoding:NSUTF8StringEncoding]
+								status:200];
+			  }];
+
+	[[server router] registerRoute:prefixRoute];
+	[[server router] registerRoute:nestedRoute];
+	[[server router] registerRoute:exactRoute];
+
+	XCTAssertTrue([server startWithError:&error], @"Server started successfully");
+	XCTAssert(!error, @"Server started without error");
+
+	// Paths below the prefix are handled by the prefix route
+	url = [NSURL URLWithString:@"http://localhost:8082/files/a/b.txt"];
+	data = [Routing _sendRequest:url response:&responseObj error:&error];
+	XCTAssertNotNil(data, @"Response data is valid");
+	XCTAssertEqual([responseObj statusCode], 200, @"HTTP status code is 200");
+	str = [[NSString alloc] initWithData:data encoding:NSUTF8StringEncoding];
+	XCTAssertEqualObjects(str, @"/files/a/b.txt", @"Handler received the full path");
+
+	// The longest prefix wins
+	url = [NSURL URLWithString:@"http://localhost:8082/files/nested/c.txt"];
+	data = [Routing _sendRequest:url response:&responseObj error:&error];
+	str = [[NSString alloc] initWithData:data encoding:NSUTF8StringEncoding];
+	XCTAssertEqualObjects(str, @"nested", @"Nested prefix route is preferred");
+
+	// Exact routes are preferred over prefix routes
+	url = [NSURL URLWithString:@"http://localhost:8082/files/exact"];
+	data = [Routing _sendRequest:url response:&responseObj error:&error];
+	str = [[NSString alloc] initWithData:data encoding:NSUTF8StringEncoding];
+	XCTAssertEqualObjects(str, @"exact", @"Exact route is preferred");
+
+	// A path sharing the prefix without the separator is not matched
+	url = [NSURL URLWithString:@"http://localhost:8082/filesystem"];
+	data = [Routing _sendRequest:url response:&responseObj error:&error];
+	XCTAssertEqual([responseObj statusCode], 404, @"HTTP status code is 404");
+
+	[server stop];
+}
+
 - (void)testMiddleware {
 	HKHTTPServer *server;
 	HKRouter *router;
@@ -265,4 +338,396 @@ static const NSString *RESPONSE_STRING = @"Received!";
 	[server stop];
 }
 
+- (void)testRouteStatistics {
+	HKHTTPServer *server;
+	HKRoute *okRoute, *errorRoute;
+	NSError *error = NULL;
+	NSURL *url;
+	NSDictionary *stats;
+	NSArray *buckets;
+	NSHTTPURLResponse *responseObj = nil;
+
+	server = [[HKHTTPServer alloc] initWithPort:8083];
+	XCTAssertNotNil(server, @"Server is valid");
+
+	okRoute = [HKRoute routeWithPath:@"/ok"
+							  method:HKHTTPMethodGET
+							 handler:^(HKHTTPRequest *request) {
+								 return [HKHTTPResponse responseWithStatus:200];
+							 }];
+	errorRoute = [HKRoute routeWithPath:@"/error"
+								 method:HKHTTPMethodGET
+								handler:^(HKHTTPRequest *request) {
+									return [HKHTTPResponse responseWithStatus:503];
+								}];
+
+	[[server router] registerRoute:okRoute];
+	[[server router] registerRoute:errorRoute];
+
+	stats = [okRoute statistics];
+	XCTAssertEqualObjects(stats[HKRouteStatisticsRequestsKey], @0, @"No requests handled yet");
+
+	XCTAssertTrue([server startWithError:&error], @"Server started successfully");
+	XCTAssert(!error, @"Server started without error");
+
+	url = [NSURL URLWithString:@"http://localhost:8083/ok"];
+	[Routing _sendRequest:url response:&responseObj error:&error];
+	[Routing _sendRequest:url response:&responseObj error:&error];
+	url = [NSURL URLWithString:@"http://localhost:8083/error"];
+	[Routing _sendRequest:url response:&responseObj error:&error];
+	url = [NSURL URLWithString:@"http://localhost:8083/missing"];
+	[Routing _sendRequest:url response:&responseObj error:&error];
+
+	stats = [okRoute statistics];
+	XCTAssertEqualObjects(stats[HKRouteStatisticsRequestsKey], @2, @"Two requests to /ok");
+	XCTAssertEqualObjects(stats[HKRouteStatisticsResponsesKey][@"2xx"], @2, @"Two 2xx responses");
+	XCTAssertEqualObjects(stats[HKRouteStatisticsResponsesKey][@"5xx"], @0, @"No 5xx responses");
+
+	buckets = stats[HKRouteStatisticsDurationBucketsKey];
+	XCTAssertEqual([buckets count], HK_ROUTE_DURATION_BUCKET_COUNT, @"One count per bucket");
+	for (NSUInteger i = 1; i < [buckets count]; i++) {
+		XCTAssertGreaterThanOrEqual([buckets[i] unsignedLongLongValue],
+									[buckets[i - 1] unsignedLongLongValue],
+									@"Bucket counts are cumulative");
+	}
+
+	stats = [errorRoute statistics];
+	XCTAssertEqualObjects(stats[HKRouteStatisticsRequestsKey], @1, @"One request to /error");
+	XCTAssertEqualObjects(stats[HKRouteStatisticsResponsesKey][@"5xx"], @1, @"One 5xx response");
+
+	XCTAssertEqual([server numberOfNotFoundRequests], 1, @"One request was not found");
+
+	[server stop];
+}
+
+- (void)testStreamingResponse {
+	HKHTTPServer *server;
+	HKRoute *producerRoute, *inputStreamRoute;
+	NSError *error = NULL;
+	NSURL *url;
+	NSData *data;
+	NSData *streamData;
+	NSString *str;
+	NSHTTPURLResponse *responseObj = nil;
+	__block BOOL terminated = NO;
+
+	server = [[HKHTTPServer alloc] initWithPort:8084];
+	XCTAssertNotNil(server, @"Server is valid");
+
+	// Ten lines of unknown length, sent with chunked transfer encoding
+	producerRoute = [HKRoute
+		routeWithPath:@"/producer"
+			   method:HKHTTPMethodGET
+			  handler:^(HKHTTPRequest *request) {
+				  __block NSUInteger line = 0;
+				  HKHTTPStreamingResponse *response;
+
+				  response = [HKHTTPStreamingResponse
+					  responseWithProducer:^NSInteger(uint8_t *buffer, NSUInteger length,
+													  uint64_t offset) {
+						  if (line == 10) {
+							  return HKHTTPStreamingResponseEndOfStream;
+						  }
+						  XCTAssertEqual(offset, line * 7, @"Offset matches the bytes sent");
+						  line++;
+						  return snprintf((char *) buffer, length, "line %lu\n",
+										  (unsigned long) line - 1);
+					  }
+									status:200];
+				  [response setTerminationHandler:^{
+					  terminated = YES;
+				  }];
+				  return response;
+			  }];
+
+	// A body with a known length read from an input stream
+	streamData = [NSMutableData dataWithLength:256 * 1024];
+	inputStreamRoute = [HKRoute
+		routeWithPath:@"/stream"
+			   method:HKHTTPMethodGET
+			  handler:^(HKHTTPRequest *request) {
+				  HKHTTPStreamingResponse *response;
+
+				  response = [HKHTTPStreamingResponse
+					  responseWithInputStream:[NSInputStream inputStreamWithData:streamData]
+									   status:200];
+				  [response setContentLength:[streamData length]];
+				  return response;
+			  }];
+
+	[[server router] registerRoute:producerRoute];
+	[[server router] registerRoute:inputStreamRoute];
+
+	XCTAssertTrue([server startWithError:&error], @"Server started successfully");
+	XCTAssert(!error, @"Server started without error");
+
+	url = [NSURL URLWithString:@"http://localhost:8084/producer"];
+	data = [Routing _sendRequest:url response:&responseObj error:&error];
+	XCTAssertNotNil(data, @"Response data is valid");
+	XCTAssertEqual([responseObj statusCode], 200, @"HTTP status code is 200");
+	str = [[NSString alloc] initWithData:data encoding:NSUTF8StringEncoding];
+	XCTAssertTrue([str hasPrefix:@"line 0\nline 1\n"], @"Body starts with the first lines");
+	XCTAssertTrue([str hasSuffix:@"line 9\n"], @"Body ends with the last line");
+	XCTAssertEqual([data length], 70, @"Body contains all lines");
+
+	url = [NSURL URLWithString:@"http://localhost:8084/stream"];
+	data = [Routing _sendRequest:url response:&responseObj error:&error];
+	XCTAssertEqual([responseObj statusCode], 200, @"HTTP status code is 200");
+	XCTAssertEqualObjects([responseObj allHeaderFields][@"Content-Length"], @"262144",
+						  @"Content-Length is set");
+	XCTAssertEqualObjects(data, streamData, @"Body matches the input stream");
+
+	// The first response was released after it was sent
+	XCTAssertTrue(terminated, @"Termination handler was called");
+
+	[server stop];
+}
+
+- (void)testFileResponse {
+	HKHTTPServer *server;
+	HKRoute *route;
+	NSError *error = NULL;
+	NSString *path;
+	NSMutableData *contents;
+	NSURL *url;
+	NSData *data;
+	NSMutableURLRequest *request;
+	NSHTTPURLResponse *responseObj = nil;
+	NSString *ETag;
+
+	// 1 KiB of distinct bytes
+	contents = [NSMutableData dataWithLength:1024];
+	for (NSUInteger i = 0; i < [contents length]; i++) {
+		((uint8_t *) [contents mutableBytes])[i] = (uint8_t) i;
+	}
+	path = [NSTemporaryDirectory() stringByAppendingPathComponent:@"MicroHTTPKitFileResponse"];
+	XCTAssertTrue([contents writeToFile:path atomically:YES], @"Test file written");
+
+	server = [[HKHTTPServer alloc] initWithPort:8085];
+	XCTAssertNotNil(server, @"Server is valid");
+
+	route = [HKRoute routeWithPath:@"/file"
+							method:HKHTTPMethodGET
+						   handler:^(HKHTTPRequest *request) {
+							   return [HKHTTPFileResponse
+								   responseWithPath:path
+											request:request
+											headers:@{@"Content-Type" : @"video/x-matroska"}
+											  error:NULL];
+						   }];
+	[[server router] registerRoute:route];
+
+	XCTAssertTrue([server startWithError:&error], @"Server started successfully");
+	XCTAssert(!error, @"Server started without error");
+
+	url = [NSURL URLWithString:@"http://localhost:8085/file"];
+
+	// The whole file
+	data = [Routing _sendRequest:url response:&responseObj error:&error];
+	XCTAssertEqual([responseObj statusCode], 200, @"HTTP status code is 200");
+	XCTAssertEqualObjects(data, contents, @"Body matches the file");
+	XCTAssertEqualObjects([responseObj allHeaderFields][@"Content-Type"], @"video/x-matroska",
+						  @"Content-Type can be overridden");
+	XCTAssertEqualObjects([responseObj allHeaderFields][@"Accept-Ranges"], @"bytes",
+						  @"Ranges are accepted");
+	XCTAssertNotNil([responseObj allHeaderFields][@"Last-Modified"], @"Last-Modified is set");
+	ETag = [responseObj allHeaderFields][@"ETag"];
+	XCTAssertNotNil(ETag, @"ETag is set");
+
+	// A range in the middle of the file
+	request = [NSMutableURLRequest requestWithURL:url];
+	[request setValue:@"bytes=10-19" forHTTPHeaderField:@"Range"];
+	data = [NSURLConnection sendSynchronousRequest:request
+								 returningResponse:&responseObj
+											 error:&error];
+	XCTAssertEqual([responseObj statusCode], 206, @"HTTP status code is 206");
+	XCTAssertEqualObjects(data, [contents subdataWithRange:NSMakeRange(10, 10)],
+						  @"Body contains the range");
+	XCTAssertEqualObjects([responseObj allHeaderFields][@"Content-Range"], @"bytes 10-19/1024",
+						  @"Content-Range is set");
+
+	// The last bytes of the file, if the file did not change
+	[request setValue:@"bytes=-24" forHTTPHeaderField:@"Range"];
+	[request setValue:ETag forHTTPHeaderField:@"If-Range"];
+	data = [NSURLConnection sendSynchronousRequest:request
+								 returningResponse:&responseObj
+											 error:&error];
+	XCTAssertEqual([responseObj statusCode], 206, @"HTTP status code is 206");
+	XCTAssertEqualObjects(data, [contents subdataWithRange:NSMakeRange(1000, 24)],
+						  @"Body contains the suffix");
+
+	// The whole file, if the file changed
+	[request setValue:@"\"outdated\"" forHTTPHeaderField:@"If-Range"];
+	data = [NSURLConnection sendSynchronousRequest:request
+								 returningResponse:&responseObj
+											 error:&error];
+	XCTAssertEqual([responseObj statusCode], 200, @"HTTP status code is 200");
+	XCTAssertEqualObjects(data, contents, @"Body matches the file");
+
+	// A range after the end of the file
+	request = [NSMutableURLRequest requestWithURL:url];
+	[request setValue:@"bytes=2048-" forHTTPHeaderField:@"Range"];
+	[NSURLConnection sendSynchronousRequest:request returningResponse:&responseObj error:&error];
+	XCTAssertEqual([responseObj statusCode], 416, @"HTTP status code is 416");
+	XCTAssertEqualObjects([responseObj allHeaderFields][@"Content-Range"], @"bytes */1024",
+						  @"Content-Range contains the size");
+
+	[server stop];
+	[[NSFileManager defaultManager] removeItemAtPath:path error:NULL];
+}
+
+- (void)testConfiguration {
+	HKHTTPServer *server;
+	HKHTTPServerConfiguration *configuration;
+	HKRoute *route;
+	NSError *error = NULL;
+	NSURL *url;
+	NSData *data;
+	NSHTTPURLResponse *responseObj = nil;
+	NSOperationQueue *queue;
+	__block NSUInteger completed = 0;
+	NSTimeInterval start;
+
+	// epoll cannot be combined with a thread per connection
+	configuration = [HKHTTPServerConfiguration defaultConfiguration];
+	[configuration setThreadingModel:HKHTTPServerThreadingModelThreadPerConnection];
+	[configuration setPollingMode:HKHTTPServerPollingModeEpoll];
+	server = [HKHTTPServer serverWithPort:8086 configuration:configuration];
+	XCTAssertFalse([server startWithError:&error], @"Server did not start");
+	XCTAssertEqual([error code], EINVAL, @"Configuration is invalid");
+	error = NULL;
+
+	configuration = [HKHTTPServerConfiguration defaultConfiguration];
+	[configuration setThreadingModel:HKHTTPServerThreadingModelThreadPool];
+	[configuration setThreadPoolSize:4];
+	[configuration setConnectionTimeout:10];
+	server = [HKHTTPServer serverWithPort:8086 configuration:configuration];
+
+	// The configuration is copied
+	[configuration setThreadPoolSize:1];
+	XCTAssertEqual([[server configuration] threadPoolSize], 4, @"Configuration was copied");
+
+	route = [HKRoute routeWithPath:@"/slow"
+							method:HKHTTPMethodGET
+						   handler:^(HKHTTPRequest *request) {
+							   [NSThread sleepForTimeInterval:0.5];
+							   return [HKHTTPResponse responseWithStatus:200];
+						   }];
+	[[server router] registerRoute:route];
+
+	XCTAssertTrue([server startWithError:&error], @"Server started successfully");
+	XCTAssert(!error, @"Server started without error");
+
+	url = [NSURL URLWithString:@"http://localhost:8086/slow"];
+	data = [Routing _sendRequest:url response:&responseObj error:&error];
+	XCTAssertNotNil(data, @"Response data is valid");
+	XCTAssertEqual([responseObj statusCode], 200, @"HTTP status code is 200");
+
+	// Slow handlers run concurrently on the threads of the pool
+	queue = [[NSOperationQueue alloc] init];
+	[queue setMaxConcurrentOperationCount:4];
+	start = [NSDate timeIntervalSinceReferenceDate];
+	for (NSUInteger i = 0; i < 4; i++) {
+		[queue addOperationWithBlock:^{
+			NSHTTPURLResponse *response = nil;
+			NSError *requestError = nil;
+
+			[Routing _sendRequest:url response:&response error:&requestError];
+			if ([response statusCode] == 200) {
+				@synchronized(queue) {
+					completed++;
+				}
+			}
+		}];
+	}
+	[queue waitUntilAllOperationsAreFinished];
+	XCTAssertEqual(completed, 4, @"All requests completed");
+	XCTAssertLessThan([NSDate timeIntervalSinceReferenceDate] - start, 1.5,
+					  @"Requests were handled concurrently");
+
+	[server stop];
+}
+
+- (void)testAsyncHandler {
+	HKHTTPServer *server;
+	HKRoute *slowRoute, *fastRoute;
+	NSOperationQueue *workQueue, *clientQueue;
+	NSError *error = NULL;
+	NSURL *url;
+	NSData *data;
+	NSString *str;
+	NSHTTPURLResponse *responseObj = nil;
+	NSTimeInterval start;
+	__block NSData *slowData = nil;
+	__block NSInteger slowStatus = 0;
+
+	// Single thread, so a blocking handler would delay all other requests
+	server = [[HKHTTPServer alloc] initWithPort:8087];
+	XCTAssertNotNil(server, @"Server is valid");
+
+	workQueue = [[NSOperationQueue alloc] init];
+	slowRoute = [HKRoute
+		 routeWithPath:@"/slow"
+				method:HKHTTPMethodGET
+		  asyncHandler:^(HKHTTPRequest *request, HKResponseHandler completion) {
+			  [workQueue addOperationWithBlock:^{
+				  [NSThread sleepForTimeInterval:1.0];
+				  completion([HKHTTPResponse
+					  responseWithData:[@"slow" dataUsingEncoding:NSUTF8StringEncoding]
+								status:200]);
+			  }];
+		  }];
+	fastRoute = [HKRoute
+		routeWithPath:@"/fast"
+			   method:HKHTTPMethodGET
+			  handler:^(HKHTTPRequest *request) {
+				  return [HKHTTPResponse
+					  responseWithData:[@"fast" dataUsingEncoding:NSUTF8StringEncoding]
+								status:200];
+			  }];
+	XCTAssertNotNil([slowRoute asyncHandler], @"Route has an asynchronous handler");
+	XCTAssertNil([fastRoute asyncHandler], @"Route has no asynchronous handler");
+
+	[[server router] registerRoute:slowRoute];
+	[[server router] registerRoute:fastRoute];
+
+	XCTAssertTrue([server startWithError:&error], @"Server started successfully");
+	XCTAssert(!error, @"Server started without error");
+
+	clientQueue = [[NSOperationQueue alloc] init];
+	[clientQueue addOperationWithBlock:^{
+		NSHTTPURLResponse *response = nil;
+		NSError *requestError = nil;
+
+		slowData = [Routing _sendRequest:[NSURL URLWithString:@"http://localhost:8087/slow"]
+								response:&response
+								   error:&requestError];
+		slowStatus = [response statusCode];
+	}];
+	[NSThread sleepForTimeInterval:0.2];
+
+	// The suspended connection does not block the server
+	start = [NSDate timeIntervalSinceReferenceDate];
+	url = [NSURL URLWithString:@"http://localhost:8087/fast"];
+	data = [Routing _sendRequest:url response:&responseObj error:&error];
+	XCTAssertEqual([responseObj statusCode], 200, @"HTTP status code is 200");
+	str = [[NSString alloc] initWithData:data encoding:NSUTF8StringEncoding];
+	XCTAssertEqualObjects(str, @"fast", @"Response data is valid");
+	XCTAssertLessThan([NSDate timeIntervalSinceReferenceDate] - start, 0.5,
+					  @"Request was not blocked by the asynchronous handler");
+
+	[clientQueue waitUntilAllOperationsAreFinished];
+	XCTAssertEqual(slowStatus, 200, @"HTTP status code is 200");
+	str = [[NSString alloc] initWithData:slowData encoding:NSUTF8StringEncoding];
+	XCTAssertEqualObjects(str, @"slow", @"Response of the asynchronous handler is valid");
+
+	// The synchronous variant waits for the completion handler
+	HKHTTPRequest *request = [[HKHTTPRequest alloc] initWithMethod:HKHTTPMethodGET
+															   URL:[NSURL URLWithString:@"/slow"]
+														   headers:@{}];
+	XCTAssertEqual([[slowRoute handler](request) status], 200, @"Handler returned the response");
+
+	[server stop];
+}
+
 @end